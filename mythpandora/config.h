@@ -8,4 +8,7 @@
 
 #define ENABLE_FAAD
 
+/* libavcodec from mythtv, see mythpandora.pro */
+#define ENABLE_AVCODEC
+
 #endif /* _CONFIG_H */
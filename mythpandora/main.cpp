@@ -62,6 +62,8 @@ void setupKeys(void)
   REG_KEY("MythPandora", "VOLUMEUP",    "Volume up",   "],},F11,Volume Up");
   REG_KEY("MythPandora", "PLAY",        "Play",        "p");
   REG_KEY("MythPandora", "PAUSE",       "Pause",        " ");
+  REG_KEY("MythPandora", "LOVE",        "Love this song", "+");
+  REG_KEY("MythPandora", "BAN",         "Ban this song",  "-");
   REG_KEY("MythPandora", "NEXTTRACK",   "Move to the next track", ",,<,Q,Home");
 }
 
@@ -85,11 +87,9 @@ int RunPandora()
   // Setup Piano Service
   MythPianoService *service = GetMythPianoService();
 
-  // try logging in here.  If it works, then don't show the login dialog.
-  if (service->Login() != 0) {
-    showLoginDialog();
-    return 0;
-  }
+  // try logging in here.  The station list shows up once it's done, the
+  // login dialog if it fails.
+  service->Login();
 
   showStationSelectDialog();
   return 0;
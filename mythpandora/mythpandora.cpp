@@ -42,36 +42,152 @@ THE SOFTWARE.
 char tlsFingerprint[20] = { 0xD9, 0x98, 0x0B, 0xA2, 0xCC, 0x0F, 0x97, 0xBB, \
     0x03, 0x82, 0x2C, 0x62, 0x11, 0xEA, 0xEA, 0x4A, 0x06, 0xEE, 0xF4, 0x27 };
 
+static void AppendPlaylist(PianoSong_t** playlist, PianoSong_t* fragment)
+{
+  while (*playlist != NULL)
+    playlist = &(*playlist)->next;
+  *playlist = fragment;
+}
+
+static void AppendStations(PianoStation_t** stations, PianoStation_t* list)
+{
+  while (*stations != NULL)
+    stations = &(*stations)->next;
+  *stations = list;
+}
+
+MythPianoWorker::MythPianoWorker(MythPianoService* service)
+  : m_Service(service),
+    m_Quit(false)
+{
+}
+
+MythPianoWorker::~MythPianoWorker()
+{
+  Stop();
+
+  while (!m_Finished.isEmpty())
+    delete m_Finished.dequeue();
+}
+
+void
+MythPianoWorker::Enqueue(MythPianoRequest* request)
+{
+  QMutexLocker locker(&m_Lock);
+  m_Pending.enqueue(request);
+  m_Wake.wakeOne();
+}
+
+MythPianoRequest*
+MythPianoWorker::TakeFinished()
+{
+  QMutexLocker locker(&m_Lock);
+  return m_Finished.isEmpty() ? NULL : m_Finished.dequeue();
+}
+
+void
+MythPianoWorker::Stop()
+{
+  {
+    QMutexLocker locker(&m_Lock);
+    m_Quit = true;
+    while (!m_Pending.isEmpty())
+      delete m_Pending.dequeue();
+    m_Wake.wakeOne();
+  }
+  wait();
+}
+
+void
+MythPianoWorker::run()
+{
+  m_Lock.lock();
+  while (!m_Quit) {
+    if (m_Pending.isEmpty()) {
+      m_Wake.wait(&m_Lock);
+      continue;
+    }
+
+    MythPianoRequest* request = m_Pending.dequeue();
+    m_Lock.unlock();
+
+    m_Service->RunRequest(request);
+
+    m_Lock.lock();
+    m_Finished.enqueue(request);
+    // queued connection, handled on the UI thread
+    emit RequestFinished();
+  }
+  m_Lock.unlock();
+}
+
 MythPianoService::MythPianoService()
   : m_Piano(NULL),
+    m_Trace(NULL),
     m_PlayerThread(NULL),
     m_AudioOutput(NULL),
     m_Playlist(NULL),
+    m_Retired(NULL),
+    m_Stations(NULL),
+    m_RetiredStations(NULL),
     m_CurrentStation(NULL),
     m_CurrentSong(NULL),
     m_Listener(NULL),
-    m_Timer(NULL)
+    m_Timer(NULL),
+    m_Worker(NULL),
+    m_LoggedIn(false),
+    m_PlaylistRequests(0)
 {
     if (class LCD *lcd = LCD::Get())
     {
         lcd->switchToTime();
         lcd->setFunctionLEDs(FUNC_MUSIC, true);
     }
+
+    memset(&m_Resampler, 0, sizeof(m_Resampler));
+    memset(&m_Cache, 0, sizeof(m_Cache));
+    BarPlayerInit(&m_Player);
+
+    connect(this, SIGNAL(MessageQueued(const QString&)),
+            this, SLOT(messageQueued(const QString&)), Qt::QueuedConnection);
+
+    m_Worker = new MythPianoWorker(this);
+    connect(m_Worker, SIGNAL(RequestFinished()),
+            this, SLOT(requestFinished()), Qt::QueuedConnection);
+    m_Worker->start();
 }
 
 MythPianoService::~MythPianoService()
 {
-    // This really should have already been deleted by StopPlayback()
-    assert(!m_AudioOutput);
-
     if (class LCD *lcd = LCD::Get())
     {
         lcd->switchToTime();
         lcd->setFunctionLEDs(FUNC_MUSIC, false);
     }
 
+    Logout();
+
+    // Drops the queued logout; the session is closed right here instead
+    m_Worker->Stop();
+    while (MythPianoRequest* request = m_Worker->TakeFinished()) {
+      PianoDestroyStations(request->stations);
+      PianoDestroyPlaylist(request->playlist);
+      delete request;
+    }
+    delete m_Worker;
+    m_Worker = NULL;
     if (m_Piano)
-      Logout();
+      ClosePianoSession();
+
+    PianoDestroyPlaylist(m_Retired);
+    m_Retired = NULL;
+    PianoDestroyStations(m_RetiredStations);
+    m_RetiredStations = NULL;
+
+    // The sink is kept open across tracks; Logout() closes it
+    assert(!m_AudioOutput);
+
+    BarPlayerDestroy(&m_Player);
 }
 
 void
@@ -97,99 +213,361 @@ void MythPianoService::BroadcastMessage(const char *format, ...)
 
   //  printf("**** MythPianoService: %s\n", buffer.ascii());
 
+  // listeners are widgets, only touch them on the UI thread
+  if (QThread::currentThread() != thread()) {
+    emit MessageQueued(buffer);
+    return;
+  }
+
   if (m_Listener)
     m_Listener->RecvMessage(buffer.ascii());
 }
 
+void MythPianoService::messageQueued(const QString& message)
+{
+  if (m_Listener)
+    m_Listener->RecvMessage(message.ascii());
+}
+
 void MythPianoService::PauseToggle()
 {
-  if (pthread_mutex_trylock(&m_Player.pauseMutex) == EBUSY) {
-    pthread_mutex_unlock(&m_Player.pauseMutex);
+  BarPlayerTogglePause(&m_Player);
+}
+
+// Keep songs around until logout, queued requests may still use them
+void MythPianoService::RetirePlaylist(PianoSong_t* playlist)
+{
+  AppendPlaylist(&m_Retired, playlist);
+}
+
+// Same for stations, GetPlaylist requests point into the list
+void MythPianoService::RetireStations()
+{
+  AppendStations(&m_RetiredStations, m_Stations);
+  m_Stations = NULL;
+  m_StationsByName.clear();
+}
+
+// The station list screen only knows names; the first station wins if
+// several have the same one, like the list search did
+void MythPianoService::IndexStations()
+{
+  m_StationsByName.clear();
+  for (PianoStation_t* s = m_Stations; s; s = s->next) {
+    QString name(s->name);
+    if (!m_StationsByName.contains(name))
+      m_StationsByName.insert(name, s);
   }
 }
 
+// Swaps in a fresh station list, keeping the current station if it still
+// exists
+void MythPianoService::ReplaceStations(PianoStation_t* stations)
+{
+  PianoStation_t* s = stations;
+
+  if (m_CurrentStation) {
+    while (s && strcmp(s->id, m_CurrentStation->id) != 0)
+      s = s->next;
+    // a deleted station keeps playing from the retired list
+    if (s)
+      m_CurrentStation = s;
+  }
+
+  RetireStations();
+  m_Stations = stations;
+  IndexStations();
+  emit StationsChanged();
+}
+
+void MythPianoService::SetCurrentStation(PianoStation_t* s)
+{
+  if (s == m_CurrentStation)
+    return;
+
+  RetirePlaylist(m_Playlist);
+  m_Playlist = NULL;
+  m_CurrentSong = NULL;
+  m_CurrentStation = s;
+}
+
 void MythPianoService::Logout()
 {
-  PianoDestroy(m_Piano);
-  m_Piano = NULL;
+  m_LoggedIn = false;
 
-  PianoDestroyPlaylist(m_Playlist);
+  RetirePlaylist(m_Playlist);
   m_Playlist = NULL;
   m_CurrentSong = NULL;
 
-  // Leak?
   m_CurrentStation = NULL;
+  RetireStations();
+
+  if (m_AudioOutput) {
+    delete m_AudioOutput;
+    m_AudioOutput = NULL;
+  }
+  BarResamplerDestroy(&m_Resampler);
+  BarCacheDestroy(&m_Cache);
+
+  m_Worker->Enqueue(new MythPianoRequest(MythPianoRequest::Logout));
+}
+
+// Worker thread, or UI thread once the worker is gone
+void MythPianoService::ClosePianoSession()
+{
+  PianoDestroy(m_Piano);
+  free(m_Piano);
+  m_Piano = NULL;
+
+  if (m_Trace) {
+    PianoTraceClose(m_Trace);
+    m_Trace = NULL;
+  }
 
   WaitressFree (&m_Waith);
   gnutls_global_deinit ();
 }
 
-int MythPianoService::Login()
+void MythPianoService::Login()
 {
-  m_Piano = (PianoHandle_t*) malloc(sizeof(PianoHandle_t));
+  // the worker replaces m_Piano, songs go away with it
+  m_LoggedIn = false;
+  SetCurrentStation(NULL);
+  RetireStations();
+
+  // played and prefetched songs are kept on disk, size in MiB
+  int cacheSize = gCoreContext->GetNumSetting("pandora-cache-size", 100);
+  BarCacheDestroy(&m_Cache);
+  if (cacheSize > 0) {
+    QString cacheDir = GetConfDir() + "/pandora-cache";
+    BarCacheInit(&m_Cache, cacheDir.toLocal8Bit().constData(),
+                 (size_t) cacheSize * 1024 * 1024);
+    if (!m_Cache.dir)
+      VERBOSE(VB_IMPORTANT, "MythPandora: cannot use audio cache " + cacheDir);
+  }
 
-  gnutls_global_init();
-  PianoInit (m_Piano);
+  MythPianoRequest* request = new MythPianoRequest(MythPianoRequest::Login);
+  request->username = gCoreContext->GetSetting("pandora-username").toUtf8();
+  request->password = gCoreContext->GetSetting("pandora-password").toUtf8();
+  // auth tokens and stations of the last session, shown right away
+  request->sessionFile = (GetConfDir() + "/pandora-session").toLocal8Bit();
+  // offline sessions for debugging, replay wins
+  QString replay = gCoreContext->GetSetting("pandora-rpc-replay");
+  QString record = gCoreContext->GetSetting("pandora-rpc-record");
+  request->traceReplay = !replay.isEmpty();
+  request->traceFile = (request->traceReplay ? replay : record).toLocal8Bit();
 
-  WaitressInit (&m_Waith);
-  m_Waith.url.host = strdup (PIANO_RPC_HOST);
-  m_Waith.url.tls = true;
-  m_Waith.tlsFingerprint = tlsFingerprint;
+  BroadcastMessage("Login... ");
+  m_Worker->Enqueue(request);
+}
 
-  memset (&m_Player, 0, sizeof (m_Player));
+void MythPianoService::GetPlaylist()
+{
+  if (m_CurrentStation == NULL) {
+    BroadcastMessage("No station selected");
+    return;
+  }
 
+  MythPianoRequest* request = new MythPianoRequest(MythPianoRequest::GetPlaylist);
+  request->station = m_CurrentStation;
 
-  QString username = gCoreContext->GetSetting("pandora-username");
-  QString password = gCoreContext->GetSetting("pandora-password");
+  if (m_CurrentSong == NULL)
+    BroadcastMessage("Receiving new playlist... ");
+  m_PlaylistRequests++;
+  m_Worker->Enqueue(request);
+}
 
-  //wtf really?
-  char* usernameBuff = strndup(username.toUtf8().data(), 1024);
-  char* passwordBuff = strndup(password.toUtf8().data(), 1024);
+void MythPianoService::RateCurrentSong(PianoSongRating_t rating)
+{
+  if (m_CurrentSong == NULL)
+    return;
 
-  PianoRequestDataLogin_t reqData;
-  reqData.user = usernameBuff;
-  reqData.password = passwordBuff;
-  reqData.step = 0;
+  MythPianoRequest* request = new MythPianoRequest(MythPianoRequest::RateSong);
+  request->song = m_CurrentSong;
+  request->rating = rating;
 
-  PianoReturn_t pRet;
-  WaitressReturn_t wRet;
-  BroadcastMessage("Login... ");
-  if (! PianoCall (PIANO_REQUEST_LOGIN, &reqData, &pRet, &wRet)) {
-    return -1;
+  BroadcastMessage(rating == PIANO_RATE_LOVE ? "Loving song... " :
+                   "Banning song... ");
+  m_Worker->Enqueue(request);
+
+  if (rating == PIANO_RATE_BAN)
+    NextSong();
+}
+
+// Worker thread only; hands the station list parsed into m_Piano over to
+// the UI thread and updates the session snapshot
+void MythPianoService::TakeStations(MythPianoRequest* request)
+{
+  if (request->ok) {
+    request->stations = m_Piano->stations;
+    // traced sessions are not snapshotted either
+    if (!m_Trace &&
+        BarSessionSave(m_Piano, m_Piano->stations, m_Username.constData(),
+                       m_SessionFile.constData()) != SESSION_RET_OK)
+      VERBOSE(VB_IMPORTANT, "MythPandora: cannot save session " +
+              QString::fromLocal8Bit(m_SessionFile));
+  } else {
+    PianoDestroyStations(m_Piano->stations);
   }
+  m_Piano->stations = NULL;
+  PianoRebuildStationIndex(m_Piano);
+}
+
+void MythPianoService::RunRequest(MythPianoRequest* request)
+{
+  PianoReturn_t pRet = PIANO_RET_OK;
+  WaitressReturn_t wRet = WAITRESS_RET_OK;
 
-  // wtf
-  free(usernameBuff);
-  free(passwordBuff);
+  switch (request->type) {
+  case MythPianoRequest::Login: {
+    if (m_Piano)
+      ClosePianoSession();
+
+    m_Piano = (PianoHandle_t*) malloc(sizeof(PianoHandle_t));
+
+    gnutls_global_init();
+    PianoInit (m_Piano);
+
+    WaitressInit (&m_Waith);
+    m_Waith.url.host = strdup (PIANO_RPC_HOST);
+    m_Waith.url.tls = true;
+    m_Waith.tlsFingerprint = tlsFingerprint;
+
+    // kept for reauthentication
+    m_Username = request->username;
+    m_Password = request->password;
+    m_SessionFile = request->sessionFile;
+
+    if (!request->traceFile.isEmpty()) {
+      m_Trace = PianoTraceOpen(request->traceFile.constData(),
+                               request->traceReplay ? PIANO_TRACE_REPLAY :
+                               PIANO_TRACE_RECORD);
+      if (m_Trace) {
+        m_Piano->trace = m_Trace;
+        PianoTraceAttach(m_Trace, &m_Waith);
+      } else {
+        VERBOSE(VB_IMPORTANT, "MythPandora: cannot open rpc trace " +
+                QString::fromLocal8Bit(request->traceFile));
+      }
+    }
 
-  if (! PianoCall (PIANO_REQUEST_GET_STATIONS, &reqData, &pRet, &wRet)) {
-    return -1;
+    // no network roundtrip at all; the UI thread asks for a fresh station
+    // list afterwards, PianoCall logs in again if the tokens are stale
+    // not while tracing, the trace starts with a full login
+    if (!m_Trace &&
+        BarSessionLoad(m_Piano, &request->stations, m_Username.constData(),
+                       m_SessionFile.constData()) == SESSION_RET_OK) {
+      request->ok = true;
+      request->cached = true;
+      break;
+    }
+
+    PianoRequestDataLogin_t reqData;
+    reqData.user = m_Username.data();
+    reqData.password = m_Password.data();
+    reqData.step = 0;
+
+    request->ok = PianoCall (PIANO_REQUEST_LOGIN, &reqData, &pRet, &wRet) > 0 &&
+      PianoCall (PIANO_REQUEST_GET_STATIONS, &reqData, &pRet, &wRet) > 0;
+    TakeStations(request);
+    break;
   }
 
-  m_CurrentStation = m_Piano->stations;
-  return 0;
+  case MythPianoRequest::GetStations:
+    request->ok = PianoCall (PIANO_REQUEST_GET_STATIONS, NULL, &pRet, &wRet) > 0;
+    if (m_Piano)
+      TakeStations(request);
+    // pandora refused the snapshot's user (changed password, e.g.), do a
+    // full login next time
+    if (!request->ok && wRet == WAITRESS_RET_OK)
+      BarSessionRemove(m_SessionFile.constData());
+    break;
+
+  case MythPianoRequest::Logout:
+    if (m_Piano)
+      ClosePianoSession();
+    request->ok = true;
+    break;
+
+  case MythPianoRequest::GetPlaylist: {
+    PianoRequestDataGetPlaylist_t reqData;
+    reqData.station = request->station;
+    reqData.format = PIANO_AF_AACPLUS;
+    reqData.retPlaylist = NULL;
+
+    request->ok = PianoCall(PIANO_REQUEST_GET_PLAYLIST, &reqData, &pRet, &wRet) > 0;
+    request->playlist = reqData.retPlaylist;
+    break;
+  }
+
+  case MythPianoRequest::RateSong: {
+    PianoRequestDataRateSong_t reqData;
+    reqData.song = request->song;
+    reqData.rating = request->rating;
+
+    request->ok = PianoCall(PIANO_REQUEST_RATE_SONG, &reqData, &pRet, &wRet) > 0;
+    break;
+  }
+  }
 }
 
-void MythPianoService::GetPlaylist()
+void MythPianoService::requestFinished()
 {
-  PianoReturn_t pRet;
-  WaitressReturn_t wRet;
-  PianoRequestDataGetPlaylist_t reqData;
-  reqData.station = m_CurrentStation;
-  reqData.format = PIANO_AF_AACPLUS;
+  MythPianoRequest* request;
+
+  while ((request = m_Worker->TakeFinished()) != NULL) {
+    switch (request->type) {
+    case MythPianoRequest::Login:
+      m_LoggedIn = request->ok;
+      m_Stations = request->stations;
+      IndexStations();
+      m_CurrentStation = m_Stations;
+      emit LoginFinished(request->ok);
+      // the snapshot may be outdated
+      if (request->ok && request->cached)
+        m_Worker->Enqueue(new MythPianoRequest(MythPianoRequest::GetStations));
+      break;
 
-  BroadcastMessage("Receiving new playlist... ");
-  if (!PianoCall(PIANO_REQUEST_GET_PLAYLIST, &reqData, &pRet, &wRet)) {
-    m_CurrentStation = NULL;
-    m_CurrentSong = NULL;
-  } else {
-    m_Playlist = reqData.retPlaylist; 
-    m_CurrentSong = m_Playlist;
-    if (m_Playlist == NULL) {
-      BroadcastMessage("No tracks left.\n");
-      m_CurrentStation = NULL;
-      m_CurrentSong = NULL;
+    case MythPianoRequest::Logout:
+      PianoDestroyPlaylist(m_Retired);
+      m_Retired = NULL;
+      PianoDestroyStations(m_RetiredStations);
+      m_RetiredStations = NULL;
+      break;
+
+    case MythPianoRequest::GetStations:
+      // dropped if the session ended in the meantime
+      if (request->ok && m_LoggedIn)
+        ReplaceStations(request->stations);
+      else
+        PianoDestroyStations(request->stations);
+      break;
+
+    case MythPianoRequest::GetPlaylist:
+      m_PlaylistRequests--;
+      // compared by id, the station list may have been replaced
+      if (m_CurrentStation == NULL ||
+          strcmp(request->station->id, m_CurrentStation->id) != 0) {
+        // station changed in the meantime
+        RetirePlaylist(request->playlist);
+      } else if (request->playlist != NULL) {
+        // fragments are played in the order they were received
+        AppendPlaylist(&m_Playlist, request->playlist);
+        if (m_CurrentSong == NULL) {
+          m_CurrentSong = request->playlist;
+          StartPlayback();
+        }
+      } else if (m_CurrentSong == NULL) {
+        if (request->ok)
+          BroadcastMessage("No tracks left.\n");
+        m_CurrentStation = NULL;
+      }
+      break;
+
+    case MythPianoRequest::RateSong:
+      break;
     }
+    delete request;
   }
 }
 
@@ -203,33 +581,62 @@ void MythPianoService::StartPlayback()
 {
   BroadcastMessage("Starting playback");
 
-  if (m_Playlist == NULL) {
+  if (m_CurrentSong == NULL) {
     BroadcastMessage("Empty playlist");
     return;
   }
 
-  if (m_Player.mode != audioPlayer::PLAYER_FREED &&
-      m_Player.mode != audioPlayer::PLAYER_FINISHED_PLAYBACK) {
-    BroadcastMessage("So sorry, we think we are already playing.  Try again (%d).", m_Player.mode);
+  BarPlayerStatus_t status;
+  GetStatus(&status);
+  if (status.mode != audioPlayer::PLAYER_FREED &&
+      status.mode != audioPlayer::PLAYER_FINISHED_PLAYBACK) {
+    BroadcastMessage("So sorry, we think we are already playing.  Try again (%d).", status.mode);
     return;
   }
 
 
-  memset (&m_Player, 0, sizeof (m_Player));
+  // reap the previous, already finished, player thread
+  if (m_PlayerThread) {
+    pthread_join(m_PlayerThread, NULL);
+    m_PlayerThread = NULL;
+  }
+
+  BarPlayerReset(&m_Player);
   WaitressInit (&m_Player.waith);
   WaitressSetUrl (&m_Player.waith, m_CurrentSong->audioUrl);
 
   m_Player.gain = m_CurrentSong->fileGain;
   m_Player.audioFormat = m_CurrentSong->audioFormat;
-  m_Player.mode = audioPlayer::PLAYER_STARTING;
   m_Player.writer = &WriteAudioCallback;
   m_Player.writerCtx = (void*) this;
 
+  // faad, mad or avcodec; player falls back to whatever handles the format
+  m_DecoderName = gCoreContext->GetSetting("pandora-decoder").toLatin1();
+  if (!m_DecoderName.isEmpty())
+    m_Player.decoderName = m_DecoderName.constData();
+  if (m_Cache.dir) {
+    m_Player.cache = &m_Cache;
+    BarCacheKey(m_CurrentSong, m_Player.cacheKey, sizeof(m_Player.cacheKey));
+  }
+
+  // mode must not read as FREED once the thread has been started
+  BarPlayerSetStarting(&m_Player);
   pthread_create (&m_PlayerThread,
 		  NULL,
 		  BarPlayerThread,
 		  &m_Player);
 
+  // last song of this fragment, get the next one while it's playing
+  if (m_CurrentSong->next == NULL && m_PlaylistRequests == 0)
+    GetPlaylist();
+
+  // download next song while this one is playing
+  if (m_Player.cache && m_CurrentSong->next) {
+    char key[BAR_CACHE_KEY_LEN];
+    BarCacheKey(m_CurrentSong->next, key, sizeof(key));
+    BarCachePrefetch(&m_Cache, key, m_CurrentSong->next->audioUrl, NULL);
+  }
+
   BroadcastMessage("New Song");
 
   if (class LCD *lcd = LCD::Get())
@@ -249,6 +656,23 @@ void MythPianoService::StartPlayback()
   m_Timer->start(1000);
 }
 
+void
+MythPianoService::ResumePlayback()
+{
+  if (m_CurrentSong == NULL) {
+    // playback starts as soon as the playlist arrives
+    if (m_PlaylistRequests == 0)
+      GetPlaylist();
+    return;
+  }
+
+  BarPlayerStatus_t status;
+  GetStatus(&status);
+  if (status.mode == audioPlayer::PLAYER_FREED ||
+      status.mode == audioPlayer::PLAYER_FINISHED_PLAYBACK)
+    StartPlayback();
+}
+
 void
 MythPianoService::StopPlayback()
 {
@@ -260,18 +684,12 @@ MythPianoService::StopPlayback()
   }
 
   if (m_PlayerThread) {
-    m_Player.doQuit = true;
-    pthread_mutex_unlock(&m_Player.pauseMutex);
+    BarPlayerQuit(&m_Player);
     pthread_join(m_PlayerThread, NULL);
 
     m_PlayerThread = NULL;
   }
 
-  if (m_AudioOutput) {
-    delete m_AudioOutput;
-    m_AudioOutput = NULL;
-  }
-
   if (class LCD *lcd = LCD::Get())
   {
     lcd->switchToTime();
@@ -313,12 +731,15 @@ MythPianoService::NextSong()
 {
     StopPlayback();
 
-    if (m_Playlist != NULL) {
+    if (m_CurrentSong != NULL) {
       m_CurrentSong = m_CurrentSong->next;
     }
 
+    // playback starts once the playlist arrives
     if (m_CurrentSong == NULL) {
-      GetPlaylist();
+      if (m_PlaylistRequests == 0)
+        GetPlaylist();
+      return;
     }
 
     StartPlayback();
@@ -327,21 +748,33 @@ MythPianoService::NextSong()
 void
 MythPianoService::heartbeat(void)
 {
-  if (m_Player.mode >= audioPlayer::PLAYER_FINISHED_PLAYBACK ||
-      m_Player.mode == audioPlayer::PLAYER_FREED) {
+  BarPlayerStatus_t status;
+  GetStatus(&status);
+  if (status.mode >= audioPlayer::PLAYER_FINISHED_PLAYBACK ||
+      status.mode == audioPlayer::PLAYER_FREED) {
 
-    if (m_Playlist != NULL) {
+    if (m_CurrentSong != NULL) {
       m_CurrentSong = m_CurrentSong->next;
     }
 
+    // playback starts once the playlist arrives
     if (m_CurrentSong == NULL) {
-      GetPlaylist();
+      if (m_PlaylistRequests == 0 && m_CurrentStation != NULL)
+        GetPlaylist();
+      return;
     }
 
     StartPlayback();
   }
 }
 
+static WaitressCbReturn_t
+PianoHttpResponseCb(void *data, size_t size, void *extraData) {
+  // parser errors are reported by PianoResponse
+  PianoResponseFeed((PianoRequest_t*) extraData, (const char*) data, size);
+  return WAITRESS_CB_RET_OK;
+}
+
 WaitressReturn_t
 MythPianoService::PianoHttpRequest(WaitressHandle_t *waith,
 				   PianoRequest_t *req) {
@@ -350,6 +783,12 @@ MythPianoService::PianoHttpRequest(WaitressHandle_t *waith,
   waith->method = WAITRESS_METHOD_POST;
   waith->url.path = req->urlPath;
 
+  // playlists and station lists are parsed while they come in
+  if (req->responseStream != NULL) {
+    waith->data = req;
+    waith->callback = PianoHttpResponseCb;
+    return WaitressFetchCall (waith);
+  }
   return WaitressFetchBuf (waith, &req->responseData);
 }
 
@@ -396,15 +835,9 @@ MythPianoService::PianoCall(PianoRequestType_t type,
         WaitressReturn_t authwRet;
         PianoRequestDataLogin_t reqData;
 
-        QString username = gCoreContext->GetSetting("pandora-username");
-        QString password = gCoreContext->GetSetting("pandora-password");
-
-        //wtf really?
-        char* usernameBuff = strndup(username.toUtf8().data(), 1024);
-        char* passwordBuff = strndup(password.toUtf8().data(), 1024);
-
-        reqData.user = usernameBuff;
-        reqData.password = passwordBuff;
+        // stored by the login request, this runs on the worker thread
+        reqData.user = m_Username.data();
+        reqData.password = m_Password.data();
         reqData.step = 0;
 
         BroadcastMessage ("Reauthentication required... ");
@@ -422,10 +855,6 @@ MythPianoService::PianoCall(PianoRequestType_t type,
           BroadcastMessage("Trying again... ");
         }
 
-        // wtf
-        free(usernameBuff);
-        free(passwordBuff);
-
       } else if (*pRet != PIANO_RET_OK) {
 	BroadcastMessage("Error: %s\n", PianoErrorToStr (*pRet));
 	if (req.responseData != NULL) {
@@ -452,10 +881,17 @@ MythPianoService::PianoCall(PianoRequestType_t type,
 void MythPianoService::WriteAudio(char* samples, size_t bytes)
 {
   if (!m_AudioOutput) {
+    // The sink is opened once with a fixed format and stays open for the
+    // whole session; every track is resampled to it.
+    unsigned long rate = gCoreContext->GetNumSetting("pandora-output-rate", 44100);
+    int channels = gCoreContext->GetNumSetting("pandora-output-channels", 2);
 
-    BroadcastMessage("Setting up audio rate(%d), channels(%d)\n",
-                     m_Player.samplerate,
-                     m_Player.channels);
+    BarResamplerDestroy(&m_Resampler);
+    BarResamplerInit(&m_Resampler, rate, channels);
+
+    BroadcastMessage("Setting up audio rate(%lu), channels(%d)\n",
+                     rate,
+                     channels);
 
     QString passthru = gCoreContext->GetNumSetting("PassThruDeviceOverride", false) ? gCoreContext->GetSetting("PassThruOutputDevice") : QString::null;
     QString main = gCoreContext->GetSetting("AudioOutputDevice");
@@ -463,9 +899,9 @@ void MythPianoService::WriteAudio(char* samples, size_t bytes)
 
     m_AudioOutput = AudioOutput::OpenAudio(main, passthru,
 					   FORMAT_S16,
-					   m_Player.channels,
+					   channels,
 					   0,
-					   m_Player.samplerate,
+					   rate,
 					   AUDIOOUTPUT_MUSIC,
 					   true, false);
   }
@@ -478,7 +914,21 @@ void MythPianoService::WriteAudio(char* samples, size_t bytes)
   if (bytes == 0)
     return;
 
-  m_AudioOutput->AddFrames(samples, bytes / 4, -1);
+  if (BarResamplerSetInput(&m_Resampler, m_Player.samplerate,
+                           m_Player.channels) != RESAMPLER_RET_OK) {
+    BroadcastMessage("Cannot convert audio rate(%lu), channels(%d)\n",
+                     m_Player.samplerate,
+                     m_Player.channels);
+    return;
+  }
+
+  short* out;
+  size_t frames = BarResamplerProcess(&m_Resampler, (short*) samples,
+                                      bytes / (2 * m_Player.channels), &out);
+  if (frames == 0)
+    return;
+
+  m_AudioOutput->AddFrames((char*) out, frames, -1);
   m_AudioOutput->Drain();
 }
 
@@ -604,8 +1054,7 @@ bool MythPandora::Create(void)
 
   service->SetMessageListener(this);
 
-  service->GetPlaylist();
-  service->StartPlayback();
+  service->ResumePlayback();
 
   m_Timer = new QTimer(this);
   connect(m_Timer, SIGNAL(timeout()), this, SLOT(heartbeat()));
@@ -660,6 +1109,16 @@ bool MythPandora::keyPressEvent(QKeyEvent *event)
         MythPianoService* service = GetMythPianoService();
         service->NextSong();
     }
+    else if (action == "LOVE")
+    {
+        MythPianoService* service = GetMythPianoService();
+        service->RateCurrentSong(PIANO_RATE_LOVE);
+    }
+    else if (action == "BAN")
+    {
+        MythPianoService* service = GetMythPianoService();
+        service->RateCurrentSong(PIANO_RATE_BAN);
+    }
     else if (action == "PAUSE" || action == "PLAY")
     {
 	  MythPianoService* service = GetMythPianoService();
@@ -786,6 +1245,7 @@ bool MythPandoraConfig::Create()
 
   MythPianoService* service = GetMythPianoService();
   service->SetMessageListener(this);
+  connect(service, SIGNAL(LoginFinished(bool)), this, SLOT(loginFinished(bool)));
 
   return true;
 }
@@ -815,7 +1275,12 @@ void MythPandoraConfig::loginCallback()
   gCoreContext->SaveSetting("pandora-password", m_passwordEdit->GetText());
 
   MythPianoService* service = GetMythPianoService();
-  if (service->Login() == 0) {
+  service->Login();
+}
+
+void MythPandoraConfig::loginFinished(bool ok)
+{
+  if (ok) {
     GetScreenStack()->PopScreen(false, true);
     showStationSelectDialog();
   }
@@ -852,19 +1317,51 @@ MythPandoraStationSelect::Create(void)
 
   BuildFocusList();
 
+  // still logging in when started from the menu
+  MythPianoService* service = GetMythPianoService();
+  if (service->IsLoggedIn())
+    FillStations();
+  else
+    connect(service, SIGNAL(LoginFinished(bool)), this, SLOT(loginFinished(bool)));
+  // the cached list is replaced once pandora answers
+  connect(service, SIGNAL(StationsChanged()), this, SLOT(stationsChanged()));
+
+  connect(m_stations, SIGNAL(itemClicked(MythUIButtonListItem*)),
+	  this, SLOT(stationSelectedCallback(MythUIButtonListItem*)));
+
+  return true;
+}
+
+void
+MythPandoraStationSelect::FillStations()
+{
   MythPianoService* service = GetMythPianoService();
   PianoStation_t* head = service->GetStations();
 
+  m_stations->Reset();
+
   while (head) {
     MythUIButtonListItem* item = new MythUIButtonListItem(m_stations, QString(head->name));
     item->SetData(QString(head->name));
     head = head->next;
   }
+}
 
-  connect(m_stations, SIGNAL(itemClicked(MythUIButtonListItem*)),
-	  this, SLOT(stationSelectedCallback(MythUIButtonListItem*)));
+void
+MythPandoraStationSelect::loginFinished(bool ok)
+{
+  if (ok) {
+    FillStations();
+  } else {
+    GetScreenStack()->PopScreen(false, true);
+    showLoginDialog();
+  }
+}
 
-  return true;
+void
+MythPandoraStationSelect::stationsChanged()
+{
+  FillStations();
 }
 
 bool
@@ -887,17 +1384,10 @@ MythPandoraStationSelect::stationSelectedCallback(MythUIButtonListItem *item)
   MythPianoService* service = GetMythPianoService();
   QString name = item->GetData().toString();
 
-  // find it.  XXX it would be better to save the station in the data.
-  PianoStation_t* head = service->GetStations();
-  while (head) { 
-    if (QString(head->name) == name) {
-      break;
-    }
-    head = head->next;
-  }
+  PianoStation_t* station = service->FindStation(name);
 
-  service->SetCurrentStation(head);
-  if (head == NULL)
+  service->SetCurrentStation(station);
+  if (station == NULL)
     return;
 
   GetScreenStack()->PopScreen(false, true);
@@ -28,6 +28,11 @@ THE SOFTWARE.
 #include <QTimer>
 #include <QHttp>
 #include <QTemporaryFile>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QHash>
 
 
 #include "mythscreentype.h"
@@ -41,7 +46,10 @@ THE SOFTWARE.
 extern "C" {
 #include <piano.h>
 #include <waitress.h>
+#include <trace.h>
 #include <player.h>
+#include "resample.h"
+#include "session.h"
 }
 
 class MythPianoService;
@@ -57,6 +65,72 @@ class MythPianoServiceListener
   virtual void RecvMessage(const char* message) = 0;
 };
 
+// Piano call made by MythPianoWorker; filled in on the worker thread,
+// handled by MythPianoService on the UI thread afterwards
+class MythPianoRequest
+{
+ public:
+  enum Type { Login, Logout, GetStations, GetPlaylist, RateSong };
+
+  MythPianoRequest(Type t)
+    : type(t), ok(false), cached(false), traceReplay(false), station(NULL),
+      song(NULL),
+      rating(PIANO_RATE_NONE), stations(NULL), playlist(NULL) {};
+
+  Type              type;
+  bool              ok;
+
+  // Login
+  QByteArray        username;
+  QByteArray        password;
+  QByteArray        sessionFile;
+  // Login result came from the session snapshot
+  bool              cached;
+  // records rpc requests to traceFile if set, or replays them from it
+  QByteArray        traceFile;
+  bool              traceReplay;
+  // GetPlaylist
+  PianoStation_t*   station;
+  // RateSong
+  PianoSong_t*      song;
+  PianoSongRating_t rating;
+
+  // Login/GetStations result
+  PianoStation_t*   stations;
+  // GetPlaylist result
+  PianoSong_t*      playlist;
+};
+
+// Runs piano calls one after another, so network and xml parsing never
+// block the UI thread
+class MythPianoWorker : public QThread
+{
+ Q_OBJECT
+
+ public:
+  MythPianoWorker(MythPianoService* service);
+  ~MythPianoWorker();
+
+  void Enqueue(MythPianoRequest* request);
+  MythPianoRequest* TakeFinished();
+  // Drops pending requests and waits for the current one
+  void Stop();
+
+ signals:
+  void RequestFinished();
+
+ protected:
+  void run();
+
+ private:
+  MythPianoService*          m_Service;
+  QMutex                     m_Lock;
+  QWaitCondition             m_Wake;
+  QQueue<MythPianoRequest*>  m_Pending;
+  QQueue<MythPianoRequest*>  m_Finished;
+  bool                       m_Quit;
+};
+
 class MythPianoService : public QObject
 {
  Q_OBJECT
@@ -65,13 +139,21 @@ class MythPianoService : public QObject
   MythPianoService();
   ~MythPianoService();
 
-  int  Login();
+  // These only queue the request; LoginFinished is emitted, playback starts
+  // and messages are broadcast once it is done
+  void Login();
   void Logout();
-  void PauseToggle();
   void GetPlaylist();
+  void RateCurrentSong(PianoSongRating_t rating);
+
+  void PauseToggle();
 
   void StartPlayback();
   void StopPlayback();
+  // plays the current song again if the player is idle, e.g. when the
+  // player screen is re-entered on the same station; fetches a playlist
+  // if there is none
+  void ResumePlayback();
   void NextSong();
 
   void VolumeUp();
@@ -92,32 +174,80 @@ class MythPianoService : public QObject
   WaitressReturn_t PianoHttpRequest(WaitressHandle_t *waith,
 				    PianoRequest_t *req);
 
+  // Worker thread only
+  void RunRequest(MythPianoRequest* request);
+
+  bool IsLoggedIn() { return m_LoggedIn; };
   PianoSong_t* GetCurrentSong() { return m_CurrentSong; };
-  PianoStation_t* GetStations() { return m_Piano->stations; };
+  // owned by the UI thread, may be replaced when StationsChanged is emitted
+  PianoStation_t* GetStations() { return m_LoggedIn ? m_Stations : NULL; };
+  PianoStation_t* FindStation(const QString& name) {
+    return m_LoggedIn ? m_StationsByName.value(name) : NULL;
+  };
   PianoStation_t* GetCurrentStation() { return m_CurrentStation; };
-  void SetCurrentStation(PianoStation_t* s) { m_CurrentStation = s; };
+  void SetCurrentStation(PianoStation_t* s);
+  void GetStatus(BarPlayerStatus_t *status) {
+    BarPlayerGetStatus(&m_Player, status);
+  };
   void GetTimes(long *played, long *duration) {
-    *played   = m_Player.songPlayed;
-    *duration = m_Player.songDuration;
+    BarPlayerStatus_t status;
+    GetStatus(&status);
+    *played   = status.songPlayed;
+    *duration = status.songDuration;
   };
 
  private:
   PianoHandle_t*     m_Piano;
   WaitressHandle_t   m_Waith;
+  // rpc session trace, lives as long as m_Piano
+  PianoTrace_t*      m_Trace;
   struct audioPlayer m_Player;
   pthread_t          m_PlayerThread;
   AudioOutput*       m_AudioOutput;
+  BarResampler_t     m_Resampler;
+  BarCache_t         m_Cache;
+  QByteArray         m_DecoderName;
   PianoSong_t*       m_Playlist;
-
+  // songs that may still be referenced by queued requests, freed on logout
+  PianoSong_t*       m_Retired;
+
+  // handed over from m_Piano by login and station list requests
+  PianoStation_t*    m_Stations;
+  QHash<QString, PianoStation_t*> m_StationsByName;
+  // replaced station lists, freed on logout
+  PianoStation_t*    m_RetiredStations;
   PianoStation_t*    m_CurrentStation;
   PianoSong_t*       m_CurrentSong;
 
   MythPianoServiceListener* m_Listener;
 
   QTimer*            m_Timer;
-  
+
+  MythPianoWorker*   m_Worker;
+  bool               m_LoggedIn;
+  // queued playlist requests
+  int                m_PlaylistRequests;
+  // worker thread only
+  QByteArray         m_Username;
+  QByteArray         m_Password;
+  QByteArray         m_SessionFile;
+
+  void ClosePianoSession();
+  void RetirePlaylist(PianoSong_t* playlist);
+  void RetireStations();
+  void ReplaceStations(PianoStation_t* stations);
+  void IndexStations();
+  void TakeStations(MythPianoRequest* request);
+
+ signals:
+  void LoginFinished(bool ok);
+  void StationsChanged();
+  void MessageQueued(const QString& message);
+
   private slots:
     void heartbeat(void);
+    void requestFinished();
+    void messageQueued(const QString& message);
 };
 
 /** \class MythPandora
@@ -181,6 +311,7 @@ class MythPandoraConfig : public MythScreenType, public MythPianoServiceListener
     
   private slots:
     void loginCallback();
+    void loginFinished(bool ok);
 };
 
 
@@ -197,8 +328,12 @@ class MythPandoraStationSelect : public MythScreenType
   private:
     MythUIButtonList *m_stations;    
 
+    void FillStations();
+
    private slots:
     void stationSelectedCallback(MythUIButtonListItem *item);
+    void loginFinished(bool ok);
+    void stationsChanged();
 };
 
 #endif /* MYTHPANDORA_H */
@@ -26,9 +26,15 @@ LIBS += -lgnutls
 
 LIBS += -lmad -lfaad
 
+# libavcodec headers use UINT64_C, which c++ only gets with this
+DEFINES += __STDC_CONSTANT_MACROS
+
 # Input
-HEADERS += config.h mythpandora.h player.h
-SOURCES += main.cpp player.c mythpandora.cpp
+HEADERS += config.h mythpandora.h player.h resample.h session.h
+SOURCES += main.cpp player.c resample.c session.c mythpandora.cpp
+
+SOURCES += ../pianobar/src/cache.c
+HEADERS += ../pianobar/src/cache.h
 
 SOURCES += ../pianobar/src/libezxml/ezxml.c
 HEADERS += ../pianobar/src/libezxml/ezxml.h
@@ -36,7 +42,7 @@ HEADERS += ../pianobar/src/libezxml/ezxml.h
 SOURCES += ../pianobar/src/libwaitress/waitress.c
 HEADERS += ../pianobar/src/libwaitress/waitress.h
 
-SOURCES  += ../pianobar/src/libpiano/crypt.c ../pianobar/src/libpiano/piano.c ../pianobar/src/libpiano/xml.c
-HEADERS  += ../pianobar/src/libpiano/config.h ../pianobar/src/libpiano/crypt_key_output.h ../pianobar/src/libpiano/xml.h ../pianobar/src/libpiano/crypt.h ../pianobar/src/libpiano/piano.h ../pianobar/src/libpiano/crypt_key_input.h ../pianobar/src/libpiano/piano_private.h
+SOURCES  += ../pianobar/src/libpiano/arena.c ../pianobar/src/libpiano/crypt.c ../pianobar/src/libpiano/piano.c ../pianobar/src/libpiano/strbuf.c ../pianobar/src/libpiano/trace.c ../pianobar/src/libpiano/xml.c ../pianobar/src/libpiano/xmlstream.c
+HEADERS  += ../pianobar/src/libpiano/arena.h ../pianobar/src/libpiano/config.h ../pianobar/src/libpiano/crypt_key_output.h ../pianobar/src/libpiano/xml.h ../pianobar/src/libpiano/xmlstream.h ../pianobar/src/libpiano/crypt.h ../pianobar/src/libpiano/piano.h ../pianobar/src/libpiano/strbuf.h ../pianobar/src/libpiano/trace.h ../pianobar/src/libpiano/crypt_key_input.h ../pianobar/src/libpiano/piano_private.h
 
 include ( ../../libs-targetfix.pro )
@@ -36,16 +36,135 @@ THE SOFTWARE.
 
 #define bigToHostEndian32(x) ntohl(x)
 
-/* wait while locked, but don't slow down main thread by keeping
- * locks too long */
+/* a single load if neither paused nor quitting, wait otherwise */
 #define QUIT_PAUSE_CHECK \
-	pthread_mutex_lock (&player->pauseMutex); \
-	pthread_mutex_unlock (&player->pauseMutex); \
-	if (player->doQuit) { \
+	if (player->ctl != PLAYER_CTL_RUN && !BarPlayerWaitCtl (player)) { \
 		/* err => abort playback */ \
 		return WAITRESS_CB_RET_ERR; \
 	}
 
+/*	set up player structure and its control word
+ *	@param player structure
+ */
+void BarPlayerInit (struct audioPlayer *player) {
+	memset (player, 0, sizeof (*player));
+	player->ctl = PLAYER_CTL_RUN;
+	pthread_mutex_init (&player->ctlMutex, NULL);
+	pthread_cond_init (&player->ctlCond, NULL);
+}
+
+/*	free control word resources; player thread must not be running
+ *	@param player structure
+ */
+void BarPlayerDestroy (struct audioPlayer *player) {
+	pthread_cond_destroy (&player->ctlCond);
+	pthread_mutex_destroy (&player->ctlMutex);
+}
+
+/*	prepare player structure for the next song; player thread must not be
+ *	running. A pending pause carries over to the next song, a quit/skip was
+ *	meant for the previous one and clears the control word.
+ *	@param player structure
+ */
+void BarPlayerReset (struct audioPlayer *player) {
+	const sig_atomic_t ctl = player->ctl;
+
+	BarPlayerDestroy (player);
+	BarPlayerInit (player);
+	if (!(ctl & PLAYER_CTL_QUIT)) {
+		player->ctl = ctl;
+	}
+}
+
+/*	pause/unpause player
+ *	@param player structure
+ */
+void BarPlayerTogglePause (struct audioPlayer *player) {
+	pthread_mutex_lock (&player->ctlMutex);
+	player->ctl ^= PLAYER_CTL_PAUSE;
+	pthread_cond_broadcast (&player->ctlCond);
+	pthread_mutex_unlock (&player->ctlMutex);
+}
+
+/*	ask player thread to stop playback, wakes it up if paused
+ *	@param player structure
+ */
+void BarPlayerQuit (struct audioPlayer *player) {
+	pthread_mutex_lock (&player->ctlMutex);
+	player->ctl |= PLAYER_CTL_QUIT;
+	pthread_cond_broadcast (&player->ctlCond);
+	pthread_mutex_unlock (&player->ctlMutex);
+}
+
+/*	slow path of QUIT_PAUSE_CHECK; sleep while paused
+ *	@param player structure
+ *	@return 1 to continue playback, 0 if playback should be aborted
+ */
+static int BarPlayerWaitCtl (struct audioPlayer *player) {
+	int cont;
+
+	pthread_mutex_lock (&player->ctlMutex);
+	while (player->ctl == PLAYER_CTL_PAUSE) {
+		pthread_cond_wait (&player->ctlCond, &player->ctlMutex);
+	}
+	cont = !(player->ctl & PLAYER_CTL_QUIT);
+	pthread_mutex_unlock (&player->ctlMutex);
+
+	return cont;
+}
+
+/*	publish status snapshot; player thread only, or its owner before the
+ *	thread is started
+ *	@param player structure
+ */
+static void BarPlayerPublishStatus (struct audioPlayer *player) {
+	BarPlayerStatus_t * const status = &player->status;
+
+	++player->statusSeq;
+	__sync_synchronize ();
+
+	status->mode = player->mode;
+	status->songDuration = player->songDuration;
+	status->songPlayed = player->songPlayed;
+	status->bufferFilled = player->bufferFilled;
+	/* bits per millisecond = kbit/s */
+	status->bitrate = player->songDuration == 0 ? 0 :
+			(unsigned long long int) player->waith.request.contentLength *
+			8LL / player->songDuration;
+	status->underruns = player->underruns;
+
+	__sync_synchronize ();
+	++player->statusSeq;
+}
+
+/*	get consistent copy of player status without blocking the player
+ *	@param player structure
+ *	@param copy status here
+ */
+void BarPlayerGetStatus (const struct audioPlayer *player,
+		BarPlayerStatus_t *status) {
+	unsigned int seq;
+
+	do {
+		while ((seq = player->statusSeq) & 1) {
+			/* writer active, retry */
+		}
+		__sync_synchronize ();
+		*status = player->status;
+		__sync_synchronize ();
+	} while (seq != player->statusSeq);
+}
+
+/*	mark player as starting, must be called before the player thread is
+ *	created so readers of the status never see PLAYER_FREED for a running
+ *	thread
+ *	@param player structure
+ */
+void BarPlayerSetStarting (struct audioPlayer *player) {
+	player->mode = PLAYER_STARTING;
+	BarPlayerPublishStatus (player);
+}
+
 /* pandora uses float values with 2 digits precision. Scale them by 100 to get
  * a "nice" integer */
 #define RG_SCALE_FACTOR 100
@@ -88,8 +207,8 @@ static inline int BarPlayerBufferFill (struct audioPlayer *player, char *data,
 		size_t dataSize) {
 	/* fill buffer */
 	if (player->bufferFilled + dataSize > sizeof (player->buffer)) {
-	  printf("Buffer overflow!\n");
-	  return 0;
+		printf ("Buffer overflow!\n");
+		return 0;
 	}
 	memcpy (player->buffer+player->bufferFilled, data, dataSize);
 	player->bufferFilled += dataSize;
@@ -110,61 +229,108 @@ static inline void BarPlayerBufferMove (struct audioPlayer *player) {
 	player->bufferFilled -= player->bufferRead;
 }
 
-#ifdef ENABLE_FAAD
-
-/*	play aac stream
- *	@param streamed data
- *	@param received bytes
- *	@param extra data (player data)
- *	@return received bytes or less on error
+/*	open audio device with player's samplerate/channels
+ *	@param player structure
+ *	@return true on success
  */
-static WaitressCbReturn_t BarPlayerAACCb (void *ptr, size_t size, void *stream) {
-	char *data = ptr;
-	struct audioPlayer *player = stream;
+static bool BarPlayerAudioOpen (struct audioPlayer *player) {
+	ao_sample_format format;
+	int audioOutDriver;
+
+	audioOutDriver = ao_default_driver_id();
+	memset (&format, 0, sizeof (format));
+	format.bits = 16;
+	format.channels = player->channels;
+	format.rate = player->samplerate;
+	format.byte_format = AO_FMT_NATIVE;
+	if ((player->audioOutDevice = ao_open_live (audioOutDriver,
+			&format, NULL)) == NULL) {
+		/* we're not interested in the errno */
+		player->aoError = 1;
+		printf ("Cannot open audio device\n");
+		return false;
+	}
+	return true;
+}
 
-	QUIT_PAUSE_CHECK;
+/*	apply replaygain to decoded pcm and pass it to writer or audio device;
+ *	used by all decoders.
+ *	player->samplerate and player->channels must be set up.
+ *	@param player structure
+ *	@param interleaved signed 16 bit samples, modified in place
+ *	@param number of samples (all channels)
+ *	@return WAITRESS_CB_RET_ERR if the audio device cannot be opened
+ */
+static WaitressCbReturn_t BarPlayerOutput (struct audioPlayer *player,
+		short int *pcm, size_t samples) {
+	size_t i;
 
-	if (!BarPlayerBufferFill (player, data, size)) {
+	if (!player->writer && player->audioOutDevice == NULL &&
+			!BarPlayerAudioOpen (player)) {
 		return WAITRESS_CB_RET_ERR;
 	}
 
-	if (player->mode == PLAYER_RECV_DATA) {
-		short int *aacDecoded;
-		NeAACDecFrameInfo frameInfo;
-		size_t i;
+	for (i = 0; i < samples; i++) {
+		pcm[i] = applyReplayGain (pcm[i], player->scale);
+	}
 
-		while ((player->bufferFilled - player->bufferRead) >
-				player->sampleSize[player->sampleSizeCurr]) {
-			/* decode frame */
-			aacDecoded = NeAACDecDecode(player->aacHandle, &frameInfo,
-					player->buffer + player->bufferRead,
-					player->sampleSize[player->sampleSizeCurr]);
-			if (frameInfo.error != 0) {
-			  printf("Decoding error: %s\n",
-				 NeAACDecGetErrorMessage (frameInfo.error));
-				break;
-			}
-			for (i = 0; i < frameInfo.samples; i++) {
-				aacDecoded[i] = applyReplayGain (aacDecoded[i], player->scale);
-			}
+	if (player->writer) {
+		(player->writer) (player->writerCtx, (char *) pcm,
+				samples * sizeof (*pcm));
+	} else {
+		/* ao_play needs bytes: 1 sample = 16 bits = 2 bytes */
+		ao_play (player->audioOutDevice, (char *) pcm,
+				samples * sizeof (*pcm));
+	}
 
-			if (player->writer) {
-			  (player->writer) (player->writerCtx, (char *) aacDecoded, frameInfo.samples * 2);
-			}
-			else {
-			  /* ao_play needs bytes: 1 sample = 16 bits = 2 bytes */
-			  ao_play (player->audioOutDevice, (char *) aacDecoded,
-				   frameInfo.samples * 2);
-			}
+	/* add played frame length to played time, explained below */
+	player->songPlayed += (unsigned long long int) samples *
+			(unsigned long long int) BAR_PLAYER_MS_TO_S_FACTOR /
+			(unsigned long long int) player->samplerate /
+			(unsigned long long int) player->channels;
 
+	return WAITRESS_CB_RET_OK;
+}
+
+#if defined (ENABLE_FAAD) || defined (ENABLE_AVCODEC)
+
+/*	set up song duration (assuming one frame always contains the same
+ *	number of samples)
+ *	calculation: channels * number of frames * samples per frame / samplerate
+ *	@param player structure
+ */
+static void BarPlayerMp4Duration (struct audioPlayer *player) {
+	/* FIXME: Hard-coded number of samples per frame */
+	player->songDuration = (unsigned long long int) player->sampleSizeN *
+			4096LL * (unsigned long long int) BAR_PLAYER_MS_TO_S_FACTOR /
+			(unsigned long long int) player->samplerate /
+			(unsigned long long int) player->channels;
+}
+
+/*	walk mp4 container up to the first aac frame, decode frames afterwards;
+ *	the container part is decoder independent
+ *	@param player structure
+ *	@param initialize decoder with audio specific config
+ *	@param decode one frame (data, size) and output it
+ *	@return WAITRESS_CB_RET_OK or WAITRESS_CB_RET_ERR
+ */
+static WaitressCbReturn_t BarPlayerMp4Decode (struct audioPlayer *player,
+		bool (*init) (struct audioPlayer *, unsigned char *, size_t),
+		WaitressCbReturn_t (*frame) (struct audioPlayer *, unsigned char *,
+		size_t)) {
+	if (player->mode == PLAYER_RECV_DATA) {
+		while (player->sampleSizeCurr < player->sampleSizeN &&
+				(player->bufferFilled - player->bufferRead) >
+				player->sampleSize[player->sampleSizeCurr]) {
+			const size_t frameSize = player->sampleSize[player->sampleSizeCurr];
 
-			/* add played frame length to played time, explained below */
-			player->songPlayed += (unsigned long long int) frameInfo.samples *
-					(unsigned long long int) BAR_PLAYER_MS_TO_S_FACTOR /
-					(unsigned long long int) player->samplerate /
-					(unsigned long long int) player->channels;
-			player->bufferRead += frameInfo.bytesconsumed;
+			if (frame (player, player->buffer + player->bufferRead,
+					frameSize) != WAITRESS_CB_RET_OK) {
+				return WAITRESS_CB_RET_ERR;
+			}
+			player->bufferRead += frameSize;
 			player->sampleSizeCurr++;
+			BarPlayerPublishStatus (player);
 			/* going through this loop can take up to a few seconds =>
 			 * allow earlier thread abort */
 			QUIT_PAUSE_CHECK;
@@ -187,40 +353,13 @@ static WaitressCbReturn_t BarPlayerAACCb (void *ptr, size_t size, void *stream)
 			while (player->bufferRead+1+4+5 < player->bufferFilled) {
 				if (memcmp (player->buffer + player->bufferRead,
 						"\x05\x80\x80\x80", 4) == 0) {
-					ao_sample_format format;
-					int audioOutDriver;
-
 					/* +1+4 needs to be replaced by <something>! */
 					player->bufferRead += 1+4;
-					char err = NeAACDecInit2 (player->aacHandle, player->buffer +
-							player->bufferRead, 5, &player->samplerate,
-							&player->channels);
-					player->bufferRead += 5;
-					if (err != 0) {
-					  printf("Error while "
-						 "initializing audio decoder"
-						 "(%i)\n", err);
+					if (!init (player, player->buffer + player->bufferRead,
+							5)) {
 						return WAITRESS_CB_RET_ERR;
 					}
-
-					if (!player->writer) {
-					audioOutDriver = ao_default_driver_id();
-					printf("audioOutDriver == %d\n", audioOutDriver);
-
-					memset (&format, 0, sizeof (format));
-					format.bits = 16;
-					format.channels = player->channels;
-					format.rate = player->samplerate;
-					format.byte_format = AO_FMT_NATIVE;
-					if ((player->audioOutDevice = ao_open_live (audioOutDriver,
-							&format, NULL)) == NULL) {
-						/* we're not interested in the errno */
-						player->aoError = 1;
-						printf("yyy Cannot open audio device %d\n", errno);
-						return WAITRESS_CB_RET_ERR;
-					}
-					} // !player->writer
-
+					player->bufferRead += 5;
 					player->mode = PLAYER_AUDIO_INITIALIZED;
 					break;
 				}
@@ -253,15 +392,7 @@ static WaitressCbReturn_t BarPlayerAACCb (void *ptr, size_t size, void *stream)
 							sizeof (player->sampleSizeN));
 					player->bufferRead += 4;
 					player->sampleSizeCurr = 0;
-					/* set up song duration (assuming one frame always contains
-					 * the same number of samples)
-					 * calculation: channels * number of frames * samples per
-					 * frame / samplerate */
-					/* FIXME: Hard-coded number of samples per frame */
-					player->songDuration = (unsigned long long int) player->sampleSizeN *
-							4096LL * (unsigned long long int) BAR_PLAYER_MS_TO_S_FACTOR /
-							(unsigned long long int) player->samplerate /
-							(unsigned long long int) player->channels;
+					BarPlayerMp4Duration (player);
 					break;
 				} else {
 					player->sampleSize[player->sampleSizeCurr] =
@@ -292,11 +423,67 @@ static WaitressCbReturn_t BarPlayerAACCb (void *ptr, size_t size, void *stream)
 		}
 	}
 
-	BarPlayerBufferMove (player);
-
 	return WAITRESS_CB_RET_OK;
 }
 
+#endif /* ENABLE_FAAD || ENABLE_AVCODEC */
+
+#ifdef ENABLE_FAAD
+
+/*	aac decoder, libfaad2
+ */
+static bool BarPlayerFaadHandles (PianoAudioFormat_t format) {
+	return format == PIANO_AF_AACPLUS;
+}
+
+static bool BarPlayerFaadOpen (struct audioPlayer *player) {
+	NeAACDecConfigurationPtr conf;
+
+	player->aacHandle = NeAACDecOpen();
+	/* set aac conf */
+	conf = NeAACDecGetCurrentConfiguration(player->aacHandle);
+	conf->outputFormat = FAAD_FMT_16BIT;
+	conf->downMatrix = 1;
+	NeAACDecSetConfiguration(player->aacHandle, conf);
+
+	return true;
+}
+
+static bool BarPlayerFaadInit (struct audioPlayer *player,
+		unsigned char *config, size_t configSize) {
+	char err = NeAACDecInit2 (player->aacHandle, config, configSize,
+			&player->samplerate, &player->channels);
+	if (err != 0) {
+		printf ("Error while initializing audio decoder "
+				"(%i)\n", err);
+		return false;
+	}
+	return true;
+}
+
+static WaitressCbReturn_t BarPlayerFaadFrame (struct audioPlayer *player,
+		unsigned char *data, size_t size) {
+	NeAACDecFrameInfo frameInfo;
+	short int *aacDecoded;
+
+	aacDecoded = NeAACDecDecode (player->aacHandle, &frameInfo, data, size);
+	if (frameInfo.error != 0) {
+		/* skip broken frame */
+		printf ("Decoding error: %s\n",
+				NeAACDecGetErrorMessage (frameInfo.error));
+		return WAITRESS_CB_RET_OK;
+	}
+	return BarPlayerOutput (player, aacDecoded, frameInfo.samples);
+}
+
+static WaitressCbReturn_t BarPlayerFaadDecode (struct audioPlayer *player) {
+	return BarPlayerMp4Decode (player, BarPlayerFaadInit, BarPlayerFaadFrame);
+}
+
+static void BarPlayerFaadClose (struct audioPlayer *player) {
+	NeAACDecClose(player->aacHandle);
+}
+
 #endif /* ENABLE_FAAD */
 
 #ifdef ENABLE_MAD
@@ -317,16 +504,22 @@ static inline signed short int BarPlayerMadToShort (mad_fixed_t fixed) {
 	return (signed short int) (fixed >> (MAD_F_FRACBITS - 15));
 }
 
-static WaitressCbReturn_t BarPlayerMp3Cb (void *ptr, size_t size, void *stream) {
-	char *data = ptr;
-	struct audioPlayer *player = stream;
-	size_t i;
+/*	mp3 decoder, libmad
+ */
+static bool BarPlayerMadHandles (PianoAudioFormat_t format) {
+	return format == PIANO_AF_MP3 || format == PIANO_AF_MP3_HI;
+}
 
-	QUIT_PAUSE_CHECK;
+static bool BarPlayerMadOpen (struct audioPlayer *player) {
+	mad_stream_init (&player->mp3Stream);
+	mad_frame_init (&player->mp3Frame);
+	mad_synth_init (&player->mp3Synth);
 
-	if (!BarPlayerBufferFill (player, data, size)) {
-		return WAITRESS_CB_RET_ERR;
-	}
+	return true;
+}
+
+static WaitressCbReturn_t BarPlayerMadDecode (struct audioPlayer *player) {
+	size_t i;
 
 	/* some "prebuffering" */
 	if (player->mode < PLAYER_RECV_DATA &&
@@ -343,8 +536,8 @@ static WaitressCbReturn_t BarPlayerMp3Cb (void *ptr, size_t size, void *stream)
 
 		if (mad_frame_decode (&player->mp3Frame, &player->mp3Stream) != 0) {
 			if (player->mp3Stream.error != MAD_ERROR_BUFLEN) {
-			  printf("mp3 decoding error: %s\n",
-				 mad_stream_errorstr (&player->mp3Stream));
+				printf ("mp3 decoding error: %s\n",
+						mad_stream_errorstr (&player->mp3Stream));
 				return WAITRESS_CB_RET_ERR;
 			} else {
 				/* rebuffering required => exit loop */
@@ -352,38 +545,10 @@ static WaitressCbReturn_t BarPlayerMp3Cb (void *ptr, size_t size, void *stream)
 			}
 		}
 		mad_synth_frame (&player->mp3Synth, &player->mp3Frame);
-		for (i = 0; i < player->mp3Synth.pcm.length; i++) {
-			/* left channel */
-			*(madPtr++) = applyReplayGain (BarPlayerMadToShort (
-					player->mp3Synth.pcm.samples[0][i]), player->scale);
-
-			/* right channel */
-			*(madPtr++) = applyReplayGain (BarPlayerMadToShort (
-					player->mp3Synth.pcm.samples[1][i]), player->scale);
-		}
 		if (player->mode < PLAYER_AUDIO_INITIALIZED) {
-			ao_sample_format format;
-			int audioOutDriver;
-
 			player->channels = player->mp3Synth.pcm.channels;
 			player->samplerate = player->mp3Synth.pcm.samplerate;
 
-			if (!player->writer) {
-			audioOutDriver = ao_default_driver_id();
-			memset (&format, 0, sizeof (format));
-			format.bits = 16;
-			format.channels = player->channels;
-			format.rate = player->samplerate;
-			format.byte_format = AO_FMT_NATIVE;
-			if ((player->audioOutDevice = ao_open_live (audioOutDriver,
-					&format, NULL)) == NULL) {
-				player->aoError = 1;
-				printf("xxx Cannot open audio device %d x\n", errno);
-				return WAITRESS_CB_RET_ERR;
-			}
-
-			} // !player->writer
-
 			/* calc song length using the framerate of the first decoded frame */
 			player->songDuration = (unsigned long long int) player->waith.request.contentLength /
 					((unsigned long long int) player->mp3Frame.header.bitrate /
@@ -393,132 +558,473 @@ static WaitressCbReturn_t BarPlayerMp3Cb (void *ptr, size_t size, void *stream)
 			 * be visible to user (ugly, but mp3 decoding != aac decoding) */
 			player->mode = PLAYER_RECV_DATA;
 		}
+		for (i = 0; i < player->mp3Synth.pcm.length; i++) {
+			/* left channel */
+			*(madPtr++) = BarPlayerMadToShort (
+					player->mp3Synth.pcm.samples[0][i]);
 
-		if (player->writer) {
-		  *(player->writer) (player->writerCtx, (char *) aacDecoded, player->mp3Synth.pcm.length * 2 * 2);
-		}
-		else {
-		/* samples * length * channels */
-		ao_play (player->audioOutDevice, (char *) madDecoded,
-				player->mp3Synth.pcm.length * 2 * 2);
+			/* right channel */
+			if (player->channels > 1) {
+				*(madPtr++) = BarPlayerMadToShort (
+						player->mp3Synth.pcm.samples[1][i]);
+			}
 		}
 
-		/* avoid division by 0 */
-		if (player->mode == PLAYER_RECV_DATA) {
-			/* same calculation as in aac player; don't need to divide by
-			 * channels, length is number of samples for _one_ channel */
-			player->songPlayed += (unsigned long long int) player->mp3Synth.pcm.length *
-					(unsigned long long int) BAR_PLAYER_MS_TO_S_FACTOR /
-					(unsigned long long int) player->samplerate;
+		if (BarPlayerOutput (player, madDecoded, madPtr - madDecoded) !=
+				WAITRESS_CB_RET_OK) {
+			return WAITRESS_CB_RET_ERR;
 		}
+		BarPlayerPublishStatus (player);
 
 		QUIT_PAUSE_CHECK;
 	} while (player->mp3Stream.error != MAD_ERROR_BUFLEN);
 
 	player->bufferRead += player->mp3Stream.next_frame - player->buffer;
 
-	BarPlayerBufferMove (player);
-
 	return WAITRESS_CB_RET_OK;
 }
+
+static void BarPlayerMadClose (struct audioPlayer *player) {
+	mad_synth_finish (&player->mp3Synth);
+	mad_frame_finish (&player->mp3Frame);
+	mad_stream_finish (&player->mp3Stream);
+}
+
 #endif /* ENABLE_MAD */
 
-/*	player thread; for every song a new thread is started
- *	@param aacPlayer structure
- *	@return NULL NULL NULL ...
+#ifdef ENABLE_AVCODEC
+
+/* avcodec_open/avcodec_close are not thread-safe */
+static pthread_mutex_t avLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t avRegistered = PTHREAD_ONCE_INIT;
+
+static void BarPlayerAvRegister (void) {
+	avcodec_register_all ();
+}
+
+/*	aac and mp3 decoder, libavcodec
  */
-void *BarPlayerThread (void *data) {
-	struct audioPlayer *player = data;
-	char extraHeaders[25];
-	void *ret = PLAYER_RET_OK;
+static bool BarPlayerAvHandles (PianoAudioFormat_t format) {
+	return format == PIANO_AF_AACPLUS || format == PIANO_AF_MP3 ||
+			format == PIANO_AF_MP3_HI;
+}
+
+/*	open codec, context must be set up already
+ *	@param player structure
+ *	@return true on success
+ */
+static bool BarPlayerAvOpenCodec (struct audioPlayer *player) {
+	AVCodec *codec;
+	int err;
+
+	codec = avcodec_find_decoder (player->audioFormat == PIANO_AF_AACPLUS ?
+			CODEC_ID_AAC : CODEC_ID_MP3);
+	if (codec == NULL) {
+		printf ("libavcodec has no decoder for this format\n");
+		return false;
+	}
+	pthread_mutex_lock (&avLock);
+	err = avcodec_open (player->avContext, codec);
+	pthread_mutex_unlock (&avLock);
+	if (err < 0) {
+		printf ("Error while initializing audio decoder (%i)\n", err);
+		return false;
+	}
+	player->samplerate = player->avContext->sample_rate;
+	player->channels = player->avContext->channels;
+
+	return true;
+}
+
+static bool BarPlayerAvOpen (struct audioPlayer *player) {
+	pthread_once (&avRegistered, BarPlayerAvRegister);
+
+	if ((player->avContext = avcodec_alloc_context ()) == NULL ||
+			(player->avSamples = av_malloc (AVCODEC_MAX_AUDIO_FRAME_SIZE)) ==
+			NULL ||
+			(player->avPacket = av_malloc (sizeof (player->buffer) +
+			FF_INPUT_BUFFER_PADDING_SIZE)) == NULL) {
+		return false;
+	}
+	/* ao is set up for stereo at most */
+	player->avContext->request_channels = 2;
+
+	if (player->audioFormat == PIANO_AF_AACPLUS) {
+		/* codec needs the audio specific config from esds atom */
+		return true;
+	}
+
+	if ((player->avParser = av_parser_init (CODEC_ID_MP3)) == NULL) {
+		return false;
+	}
+	return BarPlayerAvOpenCodec (player);
+}
+
+/*	decode one packet and output it
+ *	@param player structure
+ *	@param packet data
+ *	@param packet size
+ *	@return WAITRESS_CB_RET_OK or WAITRESS_CB_RET_ERR
+ */
+static WaitressCbReturn_t BarPlayerAvPacket (struct audioPlayer *player,
+		unsigned char *data, size_t size) {
+	AVCodecContext * const ctx = player->avContext;
+	AVPacket packet;
+
+	if (size > sizeof (player->buffer)) {
+		BarUiMsg (player->settings, MSG_ERR, "Packet too large (%zu)\n",
+				size);
+		return WAITRESS_CB_RET_OK;
+	}
+	/* decoder reads past the end of input, which must be zero padded */
+	memcpy (player->avPacket, data, size);
+	memset (player->avPacket + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+
+	av_init_packet (&packet);
+	packet.data = player->avPacket;
+	packet.size = size;
+
+	while (packet.size > 0) {
+		int decoded = AVCODEC_MAX_AUDIO_FRAME_SIZE, len;
+
+		len = avcodec_decode_audio3 (ctx, player->avSamples, &decoded,
+				&packet);
+		if (len < 0) {
+			/* skip broken packet */
+			printf ("Decoding error (%i)\n",
+					len);
+			break;
+		}
+		packet.data += len;
+		packet.size -= len;
+		if (decoded <= 0) {
+			continue;
+		}
+		if (ctx->sample_fmt != SAMPLE_FMT_S16) {
+			printf ("Unsupported sample format\n");
+			return WAITRESS_CB_RET_ERR;
+		}
+
+		/* sbr doubles aac's samplerate, which is not known until the first
+		 * frame is decoded */
+		if (player->audioOutDevice == NULL &&
+				((unsigned long) ctx->sample_rate != player->samplerate ||
+				ctx->channels != player->channels)) {
+			player->samplerate = ctx->sample_rate;
+			player->channels = ctx->channels;
+			if (player->sampleSizeN > 0) {
+				BarPlayerMp4Duration (player);
+			}
+		}
+
+		if (BarPlayerOutput (player, player->avSamples,
+				decoded / sizeof (*player->avSamples)) != WAITRESS_CB_RET_OK) {
+			return WAITRESS_CB_RET_ERR;
+		}
+	}
+
+	return WAITRESS_CB_RET_OK;
+}
+
+static bool BarPlayerAvAacInit (struct audioPlayer *player,
+		unsigned char *config, size_t configSize) {
+	AVCodecContext * const ctx = player->avContext;
+
+	if ((ctx->extradata = av_mallocz (configSize +
+			FF_INPUT_BUFFER_PADDING_SIZE)) == NULL) {
+		return false;
+	}
+	memcpy (ctx->extradata, config, configSize);
+	ctx->extradata_size = configSize;
+
+	return BarPlayerAvOpenCodec (player);
+}
+
+static WaitressCbReturn_t BarPlayerAvDecode (struct audioPlayer *player) {
+	if (player->audioFormat == PIANO_AF_AACPLUS) {
+		return BarPlayerMp4Decode (player, BarPlayerAvAacInit,
+				BarPlayerAvPacket);
+	}
+
+	/* mp3: the parser splits the stream into frames, it keeps incomplete
+	 * frames internally */
+	while (player->bufferRead < player->bufferFilled) {
+		uint8_t *frame;
+		int frameSize, len;
+
+		len = av_parser_parse2 (player->avParser, player->avContext, &frame,
+				&frameSize, player->buffer + player->bufferRead,
+				player->bufferFilled - player->bufferRead, AV_NOPTS_VALUE,
+				AV_NOPTS_VALUE, 0);
+		player->bufferRead += len;
+		if (frameSize <= 0) {
+			if (len <= 0) {
+				break;
+			}
+			continue;
+		}
+
+		if (BarPlayerAvPacket (player, frame, frameSize) !=
+				WAITRESS_CB_RET_OK) {
+			return WAITRESS_CB_RET_ERR;
+		}
+		if (player->mode < PLAYER_RECV_DATA && player->avContext->bit_rate > 0) {
+			/* calc song length using the bitrate of the first decoded frame */
+			player->songDuration = (unsigned long long int) player->waith.request.contentLength /
+					((unsigned long long int) player->avContext->bit_rate /
+					(unsigned long long int) BAR_PLAYER_MS_TO_S_FACTOR / 8LL);
+			player->mode = PLAYER_RECV_DATA;
+		}
+		BarPlayerPublishStatus (player);
+
+		QUIT_PAUSE_CHECK;
+	}
+
+	return WAITRESS_CB_RET_OK;
+}
+
+static void BarPlayerAvClose (struct audioPlayer *player) {
+	if (player->avParser != NULL) {
+		av_parser_close (player->avParser);
+	}
+	if (player->avContext != NULL) {
+		pthread_mutex_lock (&avLock);
+		avcodec_close (player->avContext);
+		pthread_mutex_unlock (&avLock);
+		av_free (player->avContext->extradata);
+		av_free (player->avContext);
+	}
+	av_free (player->avSamples);
+	av_free (player->avPacket);
+}
+
+#endif /* ENABLE_AVCODEC */
+
+/* available decoders, preferred first */
+static const BarPlayerDecoder_t decoders[] = {
 	#ifdef ENABLE_FAAD
-	NeAACDecConfigurationPtr conf;
+	{"faad", BarPlayerFaadHandles, BarPlayerFaadOpen, BarPlayerFaadDecode,
+			BarPlayerFaadClose},
+	#endif
+	#ifdef ENABLE_MAD
+	{"mad", BarPlayerMadHandles, BarPlayerMadOpen, BarPlayerMadDecode,
+			BarPlayerMadClose},
 	#endif
-	WaitressReturn_t wRet = WAITRESS_RET_ERR;
+	#ifdef ENABLE_AVCODEC
+	{"avcodec", BarPlayerAvHandles, BarPlayerAvOpen, BarPlayerAvDecode,
+			BarPlayerAvClose},
+	#endif
+	{NULL, NULL, NULL, NULL, NULL},
+};
 
-	/* init handles */
-	pthread_mutex_init (&player->pauseMutex, NULL);
-	player->waith.data = (void *) player;
-	/* extraHeaders will be initialized later */
-	player->waith.extraHeaders = extraHeaders;
+/*	find decoder for audio format
+ *	@param preferred decoder's name or NULL
+ *	@param audio format
+ *	@return decoder or NULL if the format is not supported
+ */
+static const BarPlayerDecoder_t *BarPlayerFindDecoder (const char *name,
+		PianoAudioFormat_t format) {
+	const BarPlayerDecoder_t *d, *found = NULL;
 
-	switch (player->audioFormat) {
-		#ifdef ENABLE_FAAD
-		case PIANO_AF_AACPLUS:
-			player->aacHandle = NeAACDecOpen();
-			/* set aac conf */
-			conf = NeAACDecGetCurrentConfiguration(player->aacHandle);
-			conf->outputFormat = FAAD_FMT_16BIT;
-		    conf->downMatrix = 1;
-			NeAACDecSetConfiguration(player->aacHandle, conf);
-
-			player->waith.callback = BarPlayerAACCb;
-			break;
-		#endif /* ENABLE_FAAD */
+	for (d = decoders; d->name != NULL; d++) {
+		if (!d->handles (format)) {
+			continue;
+		}
+		if (name == NULL || strcmp (d->name, name) == 0) {
+			return d;
+		}
+		if (found == NULL) {
+			found = d;
+		}
+	}
 
-		#ifdef ENABLE_MAD
-		case PIANO_AF_MP3:
-		case PIANO_AF_MP3_HI:
-			mad_stream_init (&player->mp3Stream);
-			mad_frame_init (&player->mp3Frame);
-			mad_synth_init (&player->mp3Synth);
+	return found;
+}
 
-			player->waith.callback = BarPlayerMp3Cb;
-			break;
-		#endif /* ENABLE_MAD */
+/*	buffer received data and pass it to the decoder
+ *	@param streamed data
+ *	@param received bytes
+ *	@param extra data (player data)
+ *	@return WAITRESS_CB_RET_OK or WAITRESS_CB_RET_ERR
+ */
+static WaitressCbReturn_t BarPlayerDecodeCb (void *ptr, size_t size,
+		void *stream) {
+	char *data = ptr;
+	struct audioPlayer *player = stream;
 
-		default:
-		  printf("Unsupported audio format!\n");
-			return PLAYER_RET_OK;
-			break;
+	QUIT_PAUSE_CHECK;
+
+	if (!BarPlayerBufferFill (player, data, size)) {
+		return WAITRESS_CB_RET_ERR;
+	}
+
+	if (player->decoder->decode (player) != WAITRESS_CB_RET_OK) {
+		return WAITRESS_CB_RET_ERR;
+	}
+
+	BarPlayerBufferMove (player);
+	BarPlayerPublishStatus (player);
+
+	return WAITRESS_CB_RET_OK;
+}
+
+/*	store received data in cache, then decode it
+ *	@param streamed data
+ *	@param received bytes
+ *	@param extra data (player data)
+ *	@return decoder's return value
+ */
+static WaitressCbReturn_t BarPlayerCacheCb (void *ptr, size_t size,
+		void *stream) {
+	struct audioPlayer *player = stream;
+
+	BarCacheWriterWrite (&player->cacheWriter, ptr, size);
+	return player->decoderCb (ptr, size, stream);
+}
+
+/*	stop waiting for the cache if playback is aborted
+ *	@param player structure
+ *	@return true to stop waiting
+ */
+static bool BarPlayerCacheCancel (void *data) {
+	const struct audioPlayer *player = data;
+
+	return (player->ctl & PLAYER_CTL_QUIT) != 0;
+}
+
+/*	feed cached song to decoder
+ *	@param player structure
+ *	@param mapped file
+ *	@return WAITRESS_RET_OK or WAITRESS_RET_CB_ABORT
+ */
+static WaitressReturn_t BarPlayerPlayCached (struct audioPlayer *player,
+		const BarCacheMap_t *map) {
+	char *data = map->data;
+	size_t offset = 0;
+
+	/* needed for duration calculation */
+	player->waith.request.contentLength = map->size;
+
+	while (offset < map->size) {
+		size_t chunk = WAITRESS_BUFFER_SIZE;
+
+		if (chunk > map->size - offset) {
+			chunk = map->size - offset;
+		}
+		/* decoders copy the data, they never write to it */
+		if (player->waith.callback (data + offset, chunk, player) !=
+				WAITRESS_CB_RET_OK) {
+			return WAITRESS_RET_CB_ABORT;
+		}
+		offset += chunk;
+	}
+
+	return WAITRESS_RET_OK;
+}
+
+/*	stream song from network, store it in cache if enabled
+ *	@param player structure
+ *	@param extra header buffer, used by waith
+ *	@param size of buffer
+ *	@return last waitress return value
+ */
+static WaitressReturn_t BarPlayerFetch (struct audioPlayer *player,
+		char *extraHeaders, size_t extraHeadersN) {
+	WaitressReturn_t wRet;
+	int retry;
+
+	if (player->cache != NULL && BarCacheWriterOpen (player->cache,
+			player->cacheKey, &player->cacheWriter)) {
+		player->decoderCb = player->waith.callback;
+		player->waith.callback = BarPlayerCacheCb;
 	}
-	
-	player->mode = PLAYER_INITIALIZED;
 
 	/* This loop should work around song abortions by requesting the
 	 * missing part of the song */
 	do {
-		snprintf (extraHeaders, sizeof (extraHeaders), "Range: bytes=%zu-\r\n",
+		snprintf (extraHeaders, extraHeadersN, "Range: bytes=%zu-\r\n",
 				player->bytesReceived);
 		wRet = WaitressFetchCall (&player->waith);
-	} while (wRet == WAITRESS_RET_PARTIAL_FILE || wRet == WAITRESS_RET_TIMEOUT
-			|| wRet == WAITRESS_RET_READ_ERR);
+		retry = wRet == WAITRESS_RET_PARTIAL_FILE ||
+				wRet == WAITRESS_RET_TIMEOUT || wRet == WAITRESS_RET_READ_ERR;
+		if (retry) {
+			/* stream stalled, playback ran dry */
+			++player->underruns;
+			BarPlayerPublishStatus (player);
+		}
+	} while (retry);
 
-	switch (player->audioFormat) {
-		#ifdef ENABLE_FAAD
-		case PIANO_AF_AACPLUS:
-			NeAACDecClose(player->aacHandle);
-			break;
-		#endif /* ENABLE_FAAD */
-
-		#ifdef ENABLE_MAD
-		case PIANO_AF_MP3:
-		case PIANO_AF_MP3_HI:
-			mad_synth_finish (&player->mp3Synth);
-			mad_frame_finish (&player->mp3Frame);
-			mad_stream_finish (&player->mp3Stream);
-			break;
-		#endif /* ENABLE_MAD */
+	if (player->decoderCb != NULL) {
+		/* only complete songs are cached */
+		BarCacheWriterClose (player->cache, &player->cacheWriter,
+				wRet == WAITRESS_RET_OK);
+	}
 
-		default:
-			/* this should never happen: thread is aborted above */
-			break;
+	return wRet;
+}
+
+/*	player thread; for every song a new thread is started
+ *	@param aacPlayer structure
+ *	@return NULL NULL NULL ...
+ */
+void *BarPlayerThread (void *data) {
+	struct audioPlayer *player = data;
+	char extraHeaders[25];
+	void *ret = PLAYER_RET_OK;
+	BarCacheMap_t cached;
+
+	/* init handles */
+	player->waith.data = (void *) player;
+	/* extraHeaders will be initialized later */
+	player->waith.extraHeaders = extraHeaders;
+	player->waith.callback = BarPlayerDecodeCb;
+
+	player->decoder = BarPlayerFindDecoder (player->decoderName,
+			player->audioFormat);
+	if (player->decoder == NULL) {
+		printf ("Unsupported audio format!\n");
+		player->mode = PLAYER_FINISHED_PLAYBACK;
+		BarPlayerPublishStatus (player);
+		return PLAYER_RET_OK;
 	}
+	if (!player->decoder->open (player)) {
+		printf ("Cannot initialize %s decoder\n", player->decoder->name);
+		player->decoder->close (player);
+		player->mode = PLAYER_FINISHED_PLAYBACK;
+		BarPlayerPublishStatus (player);
+		return (void *) PLAYER_RET_ERR;
+	}
+
+	player->mode = PLAYER_INITIALIZED;
+	BarPlayerPublishStatus (player);
+
+	if (player->cache != NULL) {
+		/* the song may be prefetched right now */
+		BarCacheWaitPrefetch (player->cache, player->cacheKey,
+				BarPlayerCacheCancel, player);
+	}
+	if (player->cache != NULL &&
+			BarCacheMap (player->cache, player->cacheKey, &cached)) {
+		BarPlayerPlayCached (player, &cached);
+		BarCacheUnmap (&cached);
+	} else {
+		BarPlayerFetch (player, extraHeaders, sizeof (extraHeaders));
+	}
+
+	player->decoder->close (player);
 	if (player->aoError) {
 		ret = (void *) PLAYER_RET_ERR;
 	}
-
-	if (player->audioOutDevice) 
-	  ao_close(player->audioOutDevice);
+	if (player->audioOutDevice != NULL) {
+		ao_close(player->audioOutDevice);
+	}
 	WaitressFree (&player->waith);
-	#ifdef ENABLE_FAAD
 	if (player->sampleSize != NULL) {
 		free (player->sampleSize);
 	}
-	#endif /* ENABLE_FAAD */
-	pthread_mutex_destroy (&player->pauseMutex);
 
 	player->mode = PLAYER_FINISHED_PLAYBACK;
+	BarPlayerPublishStatus (player);
 
 	return ret;
 }
@@ -34,16 +34,54 @@ THE SOFTWARE.
 #include <mad.h>
 #endif
 
+#ifdef ENABLE_AVCODEC
+#include <libavcodec/avcodec.h>
+#endif
+
 #include <ao/ao.h>
+#include <stdbool.h>
 /* required for freebsd */
 #include <sys/types.h>
 #include <pthread.h>
+#include <signal.h>
 
 #include <piano.h>
 #include <waitress.h>
+#include "../pianobar/src/cache.h"
 
 #define BAR_PLAYER_MS_TO_S_FACTOR 1000
 
+/* consistent copy of the player's state, safe to read from any thread */
+typedef struct {
+	/* PLAYER_* mode */
+	int mode;
+	/* measured in milliseconds */
+	unsigned long int songDuration;
+	unsigned long int songPlayed;
+	/* undecoded bytes in player's buffer */
+	size_t bufferFilled;
+	/* average stream bitrate in kbit/s, 0 if unknown */
+	unsigned int bitrate;
+	/* how often the stream stalled and had to be resumed */
+	unsigned int underruns;
+} BarPlayerStatus_t;
+
+struct audioPlayer;
+
+/* decoder backend */
+typedef struct {
+	/* used by audio_decoder setting */
+	const char *name;
+	/* can this backend decode format? */
+	bool (*handles) (PianoAudioFormat_t);
+	/* set up decoder state; close is called even if this fails */
+	bool (*open) (struct audioPlayer *);
+	/* decode data between bufferRead and bufferFilled, advance bufferRead;
+	 * output is passed to the audio device */
+	WaitressCbReturn_t (*decode) (struct audioPlayer *);
+	void (*close) (struct audioPlayer *);
+} BarPlayerDecoder_t;
+
 typedef void (*WriteCallback) (void* ctx, char* samples, size_t bytes);
 
 struct audioPlayer {
@@ -71,13 +109,18 @@ struct audioPlayer {
 	unsigned long int songDuration;
 	unsigned long int songPlayed;
 
-	/* aac */
-	#ifdef ENABLE_FAAD
-	NeAACDecHandle aacHandle;
-	/* stsz atom: sample sizes */
+	/* decoder backend; decoderName is preferred if it supports audioFormat */
+	const BarPlayerDecoder_t *decoder;
+	const char *decoderName;
+
+	/* mp4 container, stsz atom: sample sizes */
 	unsigned int *sampleSize;
 	size_t sampleSizeN;
 	size_t sampleSizeCurr;
+
+	/* aac */
+	#ifdef ENABLE_FAAD
+	NeAACDecHandle aacHandle;
 	#endif
 
 	/* mp3 */
@@ -87,6 +130,15 @@ struct audioPlayer {
 	struct mad_synth mp3Synth;
 	#endif
 
+	/* aac and mp3 */
+	#ifdef ENABLE_AVCODEC
+	AVCodecContext *avContext;
+	AVCodecParserContext *avParser;
+	int16_t *avSamples;
+	/* zero padded copy of the packet being decoded */
+	uint8_t *avPacket;
+	#endif
+
 	unsigned long samplerate;
 	unsigned char channels;
 
@@ -102,14 +154,41 @@ struct audioPlayer {
 
 	WaitressHandle_t waith;
 
-	char doQuit;
-	pthread_mutex_t pauseMutex;
+	/* optional audio cache (NULL if disabled) and this song's key */
+	BarCache_t *cache;
+	char cacheKey[BAR_CACHE_KEY_LEN];
+	BarCacheWriter_t cacheWriter;
+	/* decoder callback, if waith.callback is diverted through the cache */
+	WaitressCbReturn_t (*decoderCb) (void *, size_t, void *);
+
+	unsigned int underruns;
+	/* seqlock protected status; written by player thread only, odd
+	 * sequence number means update in progress */
+	volatile unsigned int statusSeq;
+	BarPlayerStatus_t status;
+
+	/* control word (PLAYER_CTL_*); only changed with ctlMutex held, but
+	 * polled without it by the player thread */
+	volatile sig_atomic_t ctl;
+	pthread_mutex_t ctlMutex;
+	/* signalled whenever ctl changes */
+	pthread_cond_t ctlCond;
     // ***MYTHPANDORA REMOVE
 	// const BarSettings_t *settings;
 };
 
 enum {PLAYER_RET_OK = 0, PLAYER_RET_ERR = 1};
 
+/* player control word bits */
+enum {PLAYER_CTL_RUN = 0, PLAYER_CTL_PAUSE = 1, PLAYER_CTL_QUIT = 2};
+
+void BarPlayerInit (struct audioPlayer *);
+void BarPlayerDestroy (struct audioPlayer *);
+void BarPlayerReset (struct audioPlayer *);
+void BarPlayerTogglePause (struct audioPlayer *);
+void BarPlayerQuit (struct audioPlayer *);
+void BarPlayerGetStatus (const struct audioPlayer *, BarPlayerStatus_t *);
+void BarPlayerSetStarting (struct audioPlayer *);
 void *BarPlayerThread (void *data);
 unsigned int BarPlayerCalcScale (float);
 
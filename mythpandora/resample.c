@@ -0,0 +1,350 @@
+/*
+Copyright (c) 2010
+	Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* sample rate/channel layout conversion; windowed sinc, polyphase */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#include "resample.h"
+
+/* taps per phase when upsampling; scaled up when decimating */
+#define RESAMPLER_TAPS 64
+/* passband edge, relative to the lower nyquist frequency */
+#define RESAMPLER_ROLLOFF 0.91
+/* kaiser window; ~80 dB stopband */
+#define RESAMPLER_BETA 8.0
+/* upper bound for coefficient table size */
+#define RESAMPLER_MAX_PHASES 1024
+/* M_PI is not c99 */
+#define RESAMPLER_PI 3.14159265358979323846
+
+static unsigned long BarResamplerGcd (unsigned long a, unsigned long b) {
+	while (b != 0) {
+		unsigned long t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*	zeroth order modified bessel function, series expansion
+ */
+static double BarResamplerBesselI0 (double x) {
+	double sum = 1.0, term = 1.0;
+	unsigned int k;
+
+	for (k = 1; k < 64; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12) {
+			break;
+		}
+	}
+	return sum;
+}
+
+/*	design low-pass prototype and split it into up phases
+ *	@param resampler with up/down/taps set
+ *	@return RESAMPLER_RET_OK or RESAMPLER_RET_ERR (out of memory)
+ */
+static int BarResamplerDesign (BarResampler_t *rs) {
+	const unsigned int len = rs->up * rs->taps;
+	const double center = (len - 1) / 2.0;
+	const double i0beta = BarResamplerBesselI0 (RESAMPLER_BETA);
+	/* cutoff, normalized to the (virtual) upsampled rate */
+	double fc = 0.5 * RESAMPLER_ROLLOFF / rs->up;
+	unsigned int p, k;
+
+	if (rs->down > rs->up) {
+		fc = 0.5 * RESAMPLER_ROLLOFF / rs->down;
+	}
+
+	free (rs->coeffs);
+	if ((rs->coeffs = malloc (len * sizeof (*rs->coeffs))) == NULL) {
+		return RESAMPLER_RET_ERR;
+	}
+
+	for (p = 0; p < rs->up; p++) {
+		float *c = rs->coeffs + p * rs->taps;
+		double sum = 0.0;
+
+		for (k = 0; k < rs->taps; k++) {
+			/* reversed, so the filter loop walks history forwards */
+			const unsigned int m = (rs->taps - 1 - k) * rs->up + p;
+			const double t = m - center;
+			const double r = t / (center + 0.5);
+			double h, w;
+
+			if (t == 0.0) {
+				h = 2.0 * fc;
+			} else {
+				h = sin (2.0 * RESAMPLER_PI * fc * t) / (RESAMPLER_PI * t);
+			}
+			w = BarResamplerBesselI0 (RESAMPLER_BETA *
+					sqrt (r * r < 1.0 ? 1.0 - r * r : 0.0)) / i0beta;
+			c[k] = h * w;
+			sum += c[k];
+		}
+		/* unity dc gain for every phase */
+		for (k = 0; k < rs->taps; k++) {
+			c[k] /= sum;
+		}
+	}
+
+	return RESAMPLER_RET_OK;
+}
+
+/*	make room for frames more history frames
+ *	@return RESAMPLER_RET_OK or RESAMPLER_RET_ERR
+ */
+static int BarResamplerReserve (BarResampler_t *rs, size_t frames) {
+	unsigned char c;
+	size_t newSize;
+
+	if (rs->histFrames + frames <= rs->histSize) {
+		return RESAMPLER_RET_OK;
+	}
+
+	newSize = (rs->histFrames + frames) * 2;
+	for (c = 0; c < rs->outChannels; c++) {
+		float *tmp = realloc (rs->hist[c], newSize * sizeof (*tmp));
+		if (tmp == NULL) {
+			return RESAMPLER_RET_ERR;
+		}
+		rs->hist[c] = tmp;
+	}
+	rs->histSize = newSize;
+
+	return RESAMPLER_RET_OK;
+}
+
+/*	one output sample; four independent sums keep the dependency chain
+ *	short and let the compiler use vector registers
+ */
+static inline float BarResamplerDot (const float *c, const float *x,
+		unsigned int n) {
+	float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	unsigned int k;
+
+	for (k = 0; k + 4 <= n; k += 4) {
+		s0 += c[k] * x[k];
+		s1 += c[k+1] * x[k+1];
+		s2 += c[k+2] * x[k+2];
+		s3 += c[k+3] * x[k+3];
+	}
+	for (; k < n; k++) {
+		s0 += c[k] * x[k];
+	}
+
+	return (s0 + s1) + (s2 + s3);
+}
+
+static inline short BarResamplerClip (float v) {
+	if (v >= SHRT_MAX) {
+		return SHRT_MAX;
+	} else if (v <= SHRT_MIN) {
+		return SHRT_MIN;
+	}
+	return (short) lrintf (v);
+}
+
+/*	set up resampler
+ *	@param resampler
+ *	@param output sample rate
+ *	@param output channels
+ */
+void BarResamplerInit (BarResampler_t *rs, unsigned long outRate,
+		unsigned char outChannels) {
+	memset (rs, 0, sizeof (*rs));
+	rs->outRate = outRate;
+	if (outChannels > BAR_RESAMPLER_MAX_CHANNELS) {
+		outChannels = BAR_RESAMPLER_MAX_CHANNELS;
+	}
+	rs->outChannels = outChannels;
+}
+
+/*	(re)configure input format; does nothing if the format did not change,
+ *	so history is carried over between tracks
+ *	@param resampler
+ *	@param input sample rate
+ *	@param input channels
+ *	@return RESAMPLER_RET_OK or RESAMPLER_RET_ERR (unsupported format/oom)
+ */
+int BarResamplerSetInput (BarResampler_t *rs, unsigned long inRate,
+		unsigned char inChannels) {
+	unsigned long gcd;
+	unsigned char c;
+
+	if (inRate == 0 || inChannels == 0 || rs->outRate == 0 ||
+			rs->outChannels == 0) {
+		return RESAMPLER_RET_ERR;
+	}
+
+	if (rs->coeffs != NULL && inRate == rs->inRate &&
+			inChannels == rs->inChannels) {
+		return RESAMPLER_RET_OK;
+	}
+
+	gcd = BarResamplerGcd (inRate, rs->outRate);
+	if (rs->outRate / gcd > RESAMPLER_MAX_PHASES) {
+		return RESAMPLER_RET_ERR;
+	}
+
+	rs->inRate = inRate;
+	rs->inChannels = inChannels;
+	rs->up = rs->outRate / gcd;
+	rs->down = inRate / gcd;
+	if (rs->up == rs->down) {
+		/* same rate, channel conversion only */
+		rs->up = rs->down = 1;
+		rs->taps = 1;
+		free (rs->coeffs);
+		if ((rs->coeffs = malloc (sizeof (*rs->coeffs))) == NULL) {
+			return RESAMPLER_RET_ERR;
+		}
+		rs->coeffs[0] = 1.0f;
+	} else {
+		rs->taps = RESAMPLER_TAPS;
+		if (rs->down > rs->up) {
+			rs->taps = (RESAMPLER_TAPS * rs->down + rs->up - 1) / rs->up;
+		}
+		if (BarResamplerDesign (rs) != RESAMPLER_RET_OK) {
+			return RESAMPLER_RET_ERR;
+		}
+	}
+
+	/* start with silence */
+	rs->histFrames = 0;
+	if (BarResamplerReserve (rs, rs->taps - 1) != RESAMPLER_RET_OK) {
+		return RESAMPLER_RET_ERR;
+	}
+	for (c = 0; c < rs->outChannels; c++) {
+		memset (rs->hist[c], 0, (rs->taps - 1) * sizeof (*rs->hist[c]));
+	}
+	rs->histFrames = rs->taps - 1;
+	rs->pos = (unsigned long long) (rs->taps - 1) * rs->up;
+
+	return RESAMPLER_RET_OK;
+}
+
+/*	convert frames
+ *	@param resampler
+ *	@param interleaved input
+ *	@param input frames
+ *	@param returns pointer to interleaved output, valid until next call
+ *	@return output frames
+ */
+size_t BarResamplerProcess (BarResampler_t *rs, const short *in,
+		size_t frames, short **out) {
+	const unsigned char inCh = rs->inChannels, outCh = rs->outChannels;
+	size_t f, n, maxOut, drop;
+	unsigned long long avail;
+	unsigned char c;
+
+	*out = NULL;
+	if (rs->coeffs == NULL ||
+			BarResamplerReserve (rs, frames) != RESAMPLER_RET_OK) {
+		return 0;
+	}
+
+	/* deinterleave and map channels */
+	for (f = 0; f < frames; f++) {
+		const short *frame = in + f * inCh;
+		const size_t dst = rs->histFrames + f;
+
+		if (inCh == outCh) {
+			for (c = 0; c < outCh; c++) {
+				rs->hist[c][dst] = frame[c];
+			}
+		} else if (outCh == 1) {
+			/* downmix */
+			float sum = 0;
+			for (c = 0; c < inCh; c++) {
+				sum += frame[c];
+			}
+			rs->hist[0][dst] = sum / inCh;
+		} else {
+			for (c = 0; c < outCh; c++) {
+				rs->hist[c][dst] = frame[c % inCh];
+			}
+		}
+	}
+	rs->histFrames += frames;
+
+	avail = (unsigned long long) rs->histFrames * rs->up;
+	if (avail <= rs->pos) {
+		return 0;
+	}
+	maxOut = (avail - rs->pos + rs->down - 1) / rs->down;
+	if (maxOut > rs->outSize) {
+		short *tmp = realloc (rs->out, maxOut * outCh * sizeof (*tmp));
+		if (tmp == NULL) {
+			return 0;
+		}
+		rs->out = tmp;
+		rs->outSize = maxOut;
+	}
+
+	for (n = 0; rs->pos < avail; n++) {
+		const size_t i = rs->pos / rs->up;
+		const float *coeff = rs->coeffs + (rs->pos % rs->up) * rs->taps;
+		const size_t first = i - (rs->taps - 1);
+
+		for (c = 0; c < outCh; c++) {
+			rs->out[n * outCh + c] = BarResamplerClip (BarResamplerDot (coeff,
+					rs->hist[c] + first, rs->taps));
+		}
+		rs->pos += rs->down;
+	}
+
+	/* keep taps-1 frames before next output position */
+	drop = rs->pos / rs->up - (rs->taps - 1);
+	if (drop > rs->histFrames) {
+		drop = rs->histFrames;
+	}
+	for (c = 0; c < outCh; c++) {
+		memmove (rs->hist[c], rs->hist[c] + drop,
+				(rs->histFrames - drop) * sizeof (*rs->hist[c]));
+	}
+	rs->histFrames -= drop;
+	rs->pos -= (unsigned long long) drop * rs->up;
+
+	*out = rs->out;
+	return n;
+}
+
+/*	free resampler buffers
+ */
+void BarResamplerDestroy (BarResampler_t *rs) {
+	unsigned char c;
+
+	for (c = 0; c < BAR_RESAMPLER_MAX_CHANNELS; c++) {
+		free (rs->hist[c]);
+	}
+	free (rs->coeffs);
+	free (rs->out);
+	memset (rs, 0, sizeof (*rs));
+}
@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2010
+	Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _RESAMPLE_H
+#define _RESAMPLE_H
+
+#include <stddef.h>
+
+#define BAR_RESAMPLER_MAX_CHANNELS 8
+
+/* polyphase resampler: converts signed 16 bit interleaved pcm with arbitrary
+ * rate/channel layout to a fixed output rate and layout */
+typedef struct {
+	unsigned long inRate, outRate;
+	unsigned char inChannels, outChannels;
+
+	/* outRate/inRate = up/down */
+	unsigned int up, down;
+	/* filter taps per phase */
+	unsigned int taps;
+	/* up phases, taps coefficients each (stored reversed) */
+	float *coeffs;
+
+	/* planar input history, one array per output channel */
+	float *hist[BAR_RESAMPLER_MAX_CHANNELS];
+	size_t histFrames, histSize;
+	/* position of next output sample, in 1/up input frames */
+	unsigned long long pos;
+
+	/* interleaved output */
+	short *out;
+	size_t outSize;
+} BarResampler_t;
+
+enum {RESAMPLER_RET_OK = 0, RESAMPLER_RET_ERR = 1};
+
+void BarResamplerInit (BarResampler_t *, unsigned long, unsigned char);
+int BarResamplerSetInput (BarResampler_t *, unsigned long, unsigned char);
+size_t BarResamplerProcess (BarResampler_t *, const short *, size_t, short **);
+void BarResamplerDestroy (BarResampler_t *);
+
+#endif /* _RESAMPLE_H */
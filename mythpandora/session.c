@@ -0,0 +1,291 @@
+/*
+Copyright (c) 2010
+	Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* binary session snapshot; integers are little endian u32 (except for the
+ * station flags byte), strings are stored as length followed by the bytes
+ * (no terminator), SESSION_NULL length for NULL pointers */
+
+#define _POSIX_C_SOURCE 1 /* fileno() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "session.h"
+
+#define SESSION_MAGIC "MPSS"
+#define SESSION_VERSION 1
+#define SESSION_NULL 0xffffffffUL
+/* sanity limit, real snapshots are a few KiB */
+#define SESSION_MAX_SIZE (1024*1024)
+
+/* snapshot being read */
+typedef struct {
+	const unsigned char *pos, *end;
+	int failed;
+} BarSessionReader_t;
+
+static void BarSessionPutU32 (FILE *fp, uint32_t v) {
+	unsigned char buf[4];
+
+	buf[0] = v & 0xff;
+	buf[1] = (v >> 8) & 0xff;
+	buf[2] = (v >> 16) & 0xff;
+	buf[3] = (v >> 24) & 0xff;
+	fwrite (buf, sizeof (buf), 1, fp);
+}
+
+static void BarSessionPutString (FILE *fp, const char *s) {
+	if (s == NULL) {
+		BarSessionPutU32 (fp, SESSION_NULL);
+	} else {
+		size_t len = strlen (s);
+		BarSessionPutU32 (fp, len);
+		fwrite (s, len, 1, fp);
+	}
+}
+
+static uint32_t BarSessionGetU32 (BarSessionReader_t *r) {
+	uint32_t v;
+
+	if (r->failed || r->end - r->pos < 4) {
+		r->failed = 1;
+		return 0;
+	}
+	v = (uint32_t) r->pos[0] | ((uint32_t) r->pos[1] << 8) |
+			((uint32_t) r->pos[2] << 16) | ((uint32_t) r->pos[3] << 24);
+	r->pos += 4;
+	return v;
+}
+
+/*	read string
+ *	@param reader
+ *	@return malloc'ed string, NULL if it was stored as NULL or reading
+ *			failed (check r->failed)
+ */
+static char *BarSessionGetString (BarSessionReader_t *r) {
+	uint32_t len = BarSessionGetU32 (r);
+	char *s;
+
+	if (r->failed || len == SESSION_NULL) {
+		return NULL;
+	}
+	if ((size_t) (r->end - r->pos) < len ||
+			(s = malloc (len + 1)) == NULL) {
+		r->failed = 1;
+		return NULL;
+	}
+	memcpy (s, r->pos, len);
+	s[len] = '\0';
+	r->pos += len;
+	return s;
+}
+
+/*	write snapshot; replaces the old one atomically, file is only readable
+ *	by its owner (it contains auth tokens)
+ *	@param logged in piano handle
+ *	@param station list
+ *	@param pandora user name, snapshot is only valid for this user
+ *	@param snapshot path
+ *	@return SESSION_RET_OK or SESSION_RET_ERR
+ */
+int BarSessionSave (const PianoHandle_t *ph, const PianoStation_t *stations,
+		const char *user, const char *path) {
+	const PianoStation_t *curStation;
+	char *tmpPath;
+	uint32_t count = 0;
+	FILE *fp;
+	int fd, ok;
+
+	if ((tmpPath = malloc (strlen (path) + 5)) == NULL) {
+		return SESSION_RET_ERR;
+	}
+	sprintf (tmpPath, "%s.tmp", path);
+
+	if ((fd = open (tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1) {
+		free (tmpPath);
+		return SESSION_RET_ERR;
+	}
+	if ((fp = fdopen (fd, "wb")) == NULL) {
+		close (fd);
+		unlink (tmpPath);
+		free (tmpPath);
+		return SESSION_RET_ERR;
+	}
+
+	for (curStation = stations; curStation != NULL;
+			curStation = curStation->next) {
+		++count;
+	}
+
+	fwrite (SESSION_MAGIC, 4, 1, fp);
+	BarSessionPutU32 (fp, SESSION_VERSION);
+	BarSessionPutString (fp, user);
+	BarSessionPutString (fp, ph->routeId);
+	BarSessionPutU32 (fp, (uint32_t) ph->timeOffset);
+	BarSessionPutString (fp, ph->user.webAuthToken);
+	BarSessionPutString (fp, ph->user.listenerId);
+	BarSessionPutString (fp, ph->user.authToken);
+	BarSessionPutU32 (fp, count);
+	for (curStation = stations; curStation != NULL;
+			curStation = curStation->next) {
+		fputc ((curStation->isCreator ? 1 : 0) |
+				(curStation->isQuickMix ? 2 : 0) |
+				(curStation->useQuickMix ? 4 : 0), fp);
+		BarSessionPutString (fp, curStation->name);
+		BarSessionPutString (fp, curStation->id);
+		BarSessionPutString (fp, curStation->seedId);
+	}
+
+	ok = !ferror (fp);
+	if (fclose (fp) != 0) {
+		ok = 0;
+	}
+	if (ok && rename (tmpPath, path) != 0) {
+		ok = 0;
+	}
+	if (!ok) {
+		unlink (tmpPath);
+	}
+	free (tmpPath);
+
+	return ok ? SESSION_RET_OK : SESSION_RET_ERR;
+}
+
+/*	restore snapshot written by BarSessionSave; the handle is only touched
+ *	if the whole snapshot could be read
+ *	@param initialized piano handle
+ *	@param returns station list
+ *	@param pandora user name, must match the stored one
+ *	@param snapshot path
+ *	@return SESSION_RET_OK or SESSION_RET_ERR
+ */
+int BarSessionLoad (PianoHandle_t *ph, PianoStation_t **retStations,
+		const char *user, const char *path) {
+	BarSessionReader_t r;
+	PianoStation_t *stations = NULL, **tail = &stations;
+	PianoUserInfo_t info;
+	unsigned char *buf;
+	char *storedUser, *routeId;
+	struct stat st;
+	uint32_t count, timeOffset;
+	FILE *fp;
+
+	if ((fp = fopen (path, "rb")) == NULL) {
+		return SESSION_RET_ERR;
+	}
+	if (fstat (fileno (fp), &st) != 0 || st.st_size < 8 ||
+			st.st_size > SESSION_MAX_SIZE ||
+			(buf = malloc (st.st_size)) == NULL) {
+		fclose (fp);
+		return SESSION_RET_ERR;
+	}
+	if (fread (buf, st.st_size, 1, fp) != 1) {
+		free (buf);
+		fclose (fp);
+		return SESSION_RET_ERR;
+	}
+	fclose (fp);
+
+	memset (&r, 0, sizeof (r));
+	r.pos = buf + 4;
+	r.end = buf + st.st_size;
+	if (memcmp (buf, SESSION_MAGIC, 4) != 0 ||
+			BarSessionGetU32 (&r) != SESSION_VERSION) {
+		free (buf);
+		return SESSION_RET_ERR;
+	}
+
+	storedUser = BarSessionGetString (&r);
+	if (storedUser == NULL || strcmp (storedUser, user) != 0) {
+		free (storedUser);
+		free (buf);
+		return SESSION_RET_ERR;
+	}
+	free (storedUser);
+
+	routeId = BarSessionGetString (&r);
+	timeOffset = BarSessionGetU32 (&r);
+	info.webAuthToken = BarSessionGetString (&r);
+	info.listenerId = BarSessionGetString (&r);
+	info.authToken = BarSessionGetString (&r);
+	count = BarSessionGetU32 (&r);
+
+	while (!r.failed && count-- > 0) {
+		PianoStation_t *station;
+		uint32_t flags;
+
+		if (r.pos >= r.end ||
+				(station = calloc (1, sizeof (*station))) == NULL) {
+			r.failed = 1;
+			break;
+		}
+		flags = *r.pos++;
+		station->isCreator = (flags & 1) != 0;
+		station->isQuickMix = (flags & 2) != 0;
+		station->useQuickMix = (flags & 4) != 0;
+		station->name = BarSessionGetString (&r);
+		station->id = BarSessionGetString (&r);
+		station->seedId = BarSessionGetString (&r);
+		*tail = station;
+		tail = &station->next;
+
+		if (station->name == NULL || station->id == NULL) {
+			r.failed = 1;
+		}
+	}
+	free (buf);
+
+	if (r.failed || routeId == NULL || strlen (routeId) >= sizeof (ph->routeId) ||
+			info.listenerId == NULL || info.authToken == NULL) {
+		free (routeId);
+		free (info.webAuthToken);
+		free (info.listenerId);
+		free (info.authToken);
+		PianoDestroyStations (stations);
+		return SESSION_RET_ERR;
+	}
+
+	strcpy (ph->routeId, routeId);
+	free (routeId);
+	ph->timeOffset = (int32_t) timeOffset;
+	free (ph->user.webAuthToken);
+	free (ph->user.listenerId);
+	free (ph->user.authToken);
+	ph->user = info;
+	*retStations = stations;
+
+	return SESSION_RET_OK;
+}
+
+/*	remove snapshot, next login goes to pandora again
+ *	@param snapshot path
+ */
+void BarSessionRemove (const char *path) {
+	unlink (path);
+}
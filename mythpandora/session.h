@@ -0,0 +1,40 @@
+/*
+Copyright (c) 2010
+	Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _SESSION_H
+#define _SESSION_H
+
+#include <piano.h>
+
+/* snapshot of a logged in session: auth tokens, server time offset and the
+ * station list, so the plugin can show stations before pandora answers */
+
+enum {SESSION_RET_OK = 0, SESSION_RET_ERR = 1};
+
+int BarSessionSave (const PianoHandle_t *, const PianoStation_t *,
+		const char *, const char *);
+int BarSessionLoad (PianoHandle_t *, PianoStation_t **, const char *,
+		const char *);
+void BarSessionRemove (const char *);
+
+#endif /* _SESSION_H */
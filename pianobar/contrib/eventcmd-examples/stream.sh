@@ -0,0 +1,26 @@
+#!/bin/bash
+#
+# Long-running event command, see event_command_stream. Records are read from
+# stdin, each one starts with event=<name> and ends with an empty line.
+
+eof=0
+while [ $eof -eq 0 ]; do
+	unset event title artist album stationName
+	while true; do
+		IFS= read -r L || { eof=1; break; }
+		[ -z "$L" ] && break
+		k="${L%%=*}"
+		v="${L#*=}"
+		case "$k" in
+			event|title|artist|album|stationName)
+				printf -v "$k" '%s' "$v"
+				;;
+		esac
+	done
+
+	case "$event" in
+		songstart)
+			echo "$title -- $artist" > $HOME/.config/pianobar/nowplaying
+			;;
+	esac
+done
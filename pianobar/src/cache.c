@@ -0,0 +1,595 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* size-bounded lru disk cache for audio files */
+
+#ifndef __FreeBSD__
+#define _POSIX_C_SOURCE 200112L /* mmap(), mkstemp() */
+#define _BSD_SOURCE /* strdup() */
+#define _DARWIN_C_SOURCE /* strdup() on OS X */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include <waitress.h>
+
+#include "cache.h"
+
+#define BAR_CACHE_INDEX "index"
+
+/*	build path of file in cache dir
+ *	@param cache
+ *	@param file name
+ *	@param store path here
+ *	@param size of path buffer
+ */
+static void BarCachePath (const BarCache_t *cache, const char *name,
+		char *path, size_t pathN) {
+	snprintf (path, pathN, "%s/%s", cache->dir, name);
+}
+
+/*	write index; lock must be held
+ *	@param cache
+ */
+static void BarCacheSaveIndex (const BarCache_t *cache) {
+	char path[PATH_MAX], tmpPath[PATH_MAX];
+	const BarCacheEntry_t *entry;
+	FILE *fp;
+
+	BarCachePath (cache, BAR_CACHE_INDEX, path, sizeof (path));
+	BarCachePath (cache, BAR_CACHE_INDEX ".tmp", tmpPath, sizeof (tmpPath));
+
+	if ((fp = fopen (tmpPath, "w")) == NULL) {
+		return;
+	}
+	for (entry = cache->entries; entry != NULL; entry = entry->next) {
+		fprintf (fp, "%s %zu %lu\n", entry->key, entry->size, entry->lastUse);
+	}
+	if (fclose (fp) == 0) {
+		rename (tmpPath, path);
+	} else {
+		unlink (tmpPath);
+	}
+}
+
+/*	read index, drop entries whose files are gone
+ *	@param cache
+ */
+static void BarCacheLoadIndex (BarCache_t *cache) {
+	char path[PATH_MAX], key[BAR_CACHE_KEY_LEN];
+	size_t size;
+	unsigned long lastUse;
+	FILE *fp;
+
+	BarCachePath (cache, BAR_CACHE_INDEX, path, sizeof (path));
+	if ((fp = fopen (path, "r")) == NULL) {
+		return;
+	}
+
+	while (fscanf (fp, "%63s %zu %lu", key, &size, &lastUse) == 3) {
+		char filePath[PATH_MAX];
+		struct stat st;
+		BarCacheEntry_t *entry;
+
+		BarCachePath (cache, key, filePath, sizeof (filePath));
+		if (stat (filePath, &st) != 0 || (size_t) st.st_size != size) {
+			continue;
+		}
+		if ((entry = calloc (1, sizeof (*entry))) == NULL) {
+			break;
+		}
+		snprintf (entry->key, sizeof (entry->key), "%s", key);
+		entry->size = size;
+		entry->lastUse = lastUse;
+		entry->next = cache->entries;
+		cache->entries = entry;
+
+		cache->curSize += size;
+		if (lastUse > cache->clock) {
+			cache->clock = lastUse;
+		}
+	}
+	fclose (fp);
+}
+
+/*	find entry; lock must be held
+ *	@param cache
+ *	@param key
+ *	@return entry or NULL
+ */
+static BarCacheEntry_t *BarCacheFind (const BarCache_t *cache,
+		const char *key) {
+	BarCacheEntry_t *entry;
+
+	for (entry = cache->entries; entry != NULL; entry = entry->next) {
+		if (strcmp (entry->key, key) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/*	unlink and free entry; lock must be held
+ *	@param cache
+ *	@param entry
+ */
+static void BarCacheRemove (BarCache_t *cache, BarCacheEntry_t *entry) {
+	BarCacheEntry_t **prev = &cache->entries;
+	char path[PATH_MAX];
+
+	while (*prev != entry) {
+		prev = &(*prev)->next;
+	}
+	*prev = entry->next;
+
+	BarCachePath (cache, entry->key, path, sizeof (path));
+	unlink (path);
+	cache->curSize -= entry->size;
+	free (entry);
+}
+
+/*	evict least recently used entries until cache fits; lock must be held
+ *	@param cache
+ */
+static void BarCacheEvict (BarCache_t *cache) {
+	while (cache->curSize > cache->maxSize && cache->entries != NULL) {
+		BarCacheEntry_t *entry, *oldest = cache->entries;
+
+		for (entry = cache->entries; entry != NULL; entry = entry->next) {
+			if (entry->lastUse < oldest->lastUse) {
+				oldest = entry;
+			}
+		}
+		BarCacheRemove (cache, oldest);
+	}
+}
+
+/*	set up cache, creates directory if necessary
+ *	@param cache
+ *	@param cache directory
+ *	@param maximum size in bytes
+ */
+void BarCacheInit (BarCache_t *cache, const char *dir, size_t maxSize) {
+	memset (cache, 0, sizeof (*cache));
+
+	if (mkdir (dir, 0700) != 0 && errno != EEXIST) {
+		return;
+	}
+
+	cache->dir = strdup (dir);
+	cache->maxSize = maxSize;
+	pthread_mutex_init (&cache->lock, NULL);
+	pthread_cond_init (&cache->prefetchCond, NULL);
+
+	BarCacheLoadIndex (cache);
+	BarCacheEvict (cache);
+}
+
+/*	abort prefetching and free cache structure (files are kept)
+ *	@param cache
+ */
+void BarCacheDestroy (BarCache_t *cache) {
+	BarCacheEntry_t *entry;
+
+	if (cache->dir == NULL) {
+		return;
+	}
+
+	if (cache->prefetchStarted) {
+		/* drop queued download and stop the current one, so joining
+		 * does not wait for the network */
+		pthread_mutex_lock (&cache->lock);
+		free (cache->prefetchUrl);
+		free (cache->prefetchProxy);
+		cache->prefetchUrl = NULL;
+		cache->prefetchProxy = NULL;
+		cache->prefetchAbort = 1;
+		pthread_mutex_unlock (&cache->lock);
+		pthread_join (cache->prefetchThread, NULL);
+	}
+
+	pthread_mutex_lock (&cache->lock);
+	BarCacheSaveIndex (cache);
+	pthread_mutex_unlock (&cache->lock);
+
+	entry = cache->entries;
+	while (entry != NULL) {
+		BarCacheEntry_t *next = entry->next;
+		free (entry);
+		entry = next;
+	}
+
+	pthread_cond_destroy (&cache->prefetchCond);
+	pthread_mutex_destroy (&cache->lock);
+	free (cache->dir);
+	memset (cache, 0, sizeof (*cache));
+}
+
+/*	derive cache key from song; urls are session-bound, the music id and
+ *	format are not
+ *	@param song
+ *	@param store key here
+ *	@param key buffer size
+ */
+void BarCacheKey (const PianoSong_t *song, char *key, size_t keyN) {
+	const char *id = song->musicId != NULL ? song->musicId : "";
+	size_t i;
+
+	snprintf (key, keyN, "%s-%i", id, song->audioFormat);
+	/* don't let the server choose our file names */
+	for (i = 0; key[i] != '\0'; i++) {
+		const char c = key[i];
+		if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+				(c >= 'A' && c <= 'Z') || c == '-')) {
+			key[i] = '_';
+		}
+	}
+}
+
+/*	map cached file into memory
+ *	@param cache
+ *	@param key
+ *	@param store mapping here
+ *	@return true if key is cached
+ */
+bool BarCacheMap (BarCache_t *cache, const char *key, BarCacheMap_t *map) {
+	BarCacheEntry_t *entry;
+	char path[PATH_MAX];
+	int fd = -1;
+
+	memset (map, 0, sizeof (*map));
+	if (cache->dir == NULL) {
+		return false;
+	}
+
+	pthread_mutex_lock (&cache->lock);
+	if ((entry = BarCacheFind (cache, key)) != NULL) {
+		BarCachePath (cache, key, path, sizeof (path));
+		if ((fd = open (path, O_RDONLY)) == -1) {
+			/* deleted behind our back */
+			BarCacheRemove (cache, entry);
+		} else {
+			map->size = entry->size;
+			entry->lastUse = ++cache->clock;
+		}
+		BarCacheSaveIndex (cache);
+	}
+	pthread_mutex_unlock (&cache->lock);
+
+	if (fd == -1) {
+		return false;
+	}
+
+	/* the mapping stays valid even if the entry is evicted meanwhile */
+	map->data = mmap (NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd);
+	if (map->data == MAP_FAILED) {
+		memset (map, 0, sizeof (*map));
+		return false;
+	}
+
+	return true;
+}
+
+/*	release mapping
+ *	@param mapping
+ */
+void BarCacheUnmap (BarCacheMap_t *map) {
+	if (map->data != NULL) {
+		munmap (map->data, map->size);
+	}
+	memset (map, 0, sizeof (*map));
+}
+
+/*	start new cache file
+ *	@param cache
+ *	@param key
+ *	@param writer
+ *	@return true on success
+ */
+bool BarCacheWriterOpen (BarCache_t *cache, const char *key,
+		BarCacheWriter_t *writer) {
+	char path[PATH_MAX];
+
+	memset (writer, 0, sizeof (*writer));
+	writer->fd = -1;
+	if (cache->dir == NULL) {
+		return false;
+	}
+
+	snprintf (path, sizeof (path), "%s/%s.XXXXXX", cache->dir, key);
+	if ((writer->fd = mkstemp (path)) == -1) {
+		return false;
+	}
+	snprintf (writer->key, sizeof (writer->key), "%s", key);
+	writer->tmpPath = strdup (path);
+
+	return true;
+}
+
+/*	append data; errors disable the writer, they don't affect playback
+ *	@param writer
+ *	@param data
+ *	@param data size
+ */
+void BarCacheWriterWrite (BarCacheWriter_t *writer, const void *data,
+		size_t size) {
+	const char *ptr = data;
+
+	while (writer->fd != -1 && size > 0) {
+		ssize_t ret = write (writer->fd, ptr, size);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			close (writer->fd);
+			writer->fd = -1;
+			break;
+		}
+		ptr += ret;
+		size -= ret;
+		writer->size += ret;
+	}
+}
+
+/*	finish cache file
+ *	@param cache
+ *	@param writer
+ *	@param add file to cache (true) or discard it (false)
+ */
+void BarCacheWriterClose (BarCache_t *cache, BarCacheWriter_t *writer,
+		bool commit) {
+	if (writer->tmpPath == NULL) {
+		return;
+	}
+
+	if (writer->fd != -1 && close (writer->fd) == 0 && commit &&
+			writer->size > 0 && writer->size <= cache->maxSize) {
+		BarCacheEntry_t *entry;
+		char path[PATH_MAX];
+
+		pthread_mutex_lock (&cache->lock);
+		BarCachePath (cache, writer->key, path, sizeof (path));
+		if ((entry = BarCacheFind (cache, writer->key)) != NULL) {
+			/* replaced below */
+			cache->curSize -= entry->size;
+		} else if ((entry = calloc (1, sizeof (*entry))) != NULL) {
+			snprintf (entry->key, sizeof (entry->key), "%s", writer->key);
+			entry->next = cache->entries;
+			cache->entries = entry;
+		}
+		if (entry != NULL && rename (writer->tmpPath, path) == 0) {
+			entry->size = writer->size;
+			entry->lastUse = ++cache->clock;
+			cache->curSize += entry->size;
+			BarCacheEvict (cache);
+			BarCacheSaveIndex (cache);
+		} else if (entry != NULL) {
+			/* size was already subtracted */
+			entry->size = 0;
+			BarCacheRemove (cache, entry);
+		}
+		pthread_mutex_unlock (&cache->lock);
+	}
+
+	/* no-op if renamed */
+	unlink (writer->tmpPath);
+	free (writer->tmpPath);
+	memset (writer, 0, sizeof (*writer));
+	writer->fd = -1;
+}
+
+/* prefetch thread's download state */
+typedef struct {
+	BarCache_t *cache;
+	BarCacheWriter_t writer;
+} BarCachePrefetch_t;
+
+/*	prefetch download callback
+ */
+static WaitressCbReturn_t BarCachePrefetchCb (void *ptr, size_t size,
+		void *data) {
+	BarCachePrefetch_t *prefetch = data;
+
+	if (prefetch->cache->prefetchAbort) {
+		return WAITRESS_CB_RET_ERR;
+	}
+	BarCacheWriterWrite (&prefetch->writer, ptr, size);
+	return prefetch->writer.fd == -1 ? WAITRESS_CB_RET_ERR :
+			WAITRESS_CB_RET_OK;
+}
+
+/*	download url to cache
+ *	@param cache
+ *	@param key
+ *	@param url
+ *	@param proxy or NULL
+ */
+static void BarCachePrefetchDownload (BarCache_t *cache, const char *key,
+		const char *url, const char *proxy) {
+	BarCachePrefetch_t prefetch;
+	WaitressHandle_t waith;
+	WaitressReturn_t wRet;
+	char extraHeaders[32];
+
+	prefetch.cache = cache;
+	if (!BarCacheWriterOpen (cache, key, &prefetch.writer)) {
+		return;
+	}
+
+	WaitressInit (&waith);
+	WaitressSetUrl (&waith, url);
+	if (proxy != NULL) {
+		WaitressSetProxy (&waith, proxy);
+	}
+	waith.extraHeaders = extraHeaders;
+	waith.callback = BarCachePrefetchCb;
+	waith.data = &prefetch;
+
+	/* resume like the player does */
+	do {
+		snprintf (extraHeaders, sizeof (extraHeaders),
+				"Range: bytes=%zu-\r\n", prefetch.writer.size);
+		wRet = WaitressFetchCall (&waith);
+	} while (!cache->prefetchAbort && (wRet == WAITRESS_RET_PARTIAL_FILE ||
+			wRet == WAITRESS_RET_TIMEOUT || wRet == WAITRESS_RET_READ_ERR));
+
+	BarCacheWriterClose (cache, &prefetch.writer,
+			wRet == WAITRESS_RET_OK && !cache->prefetchAbort);
+	WaitressFree (&waith);
+}
+
+/*	prefetch thread, downloads queued songs until the queue is empty
+ *	@param cache
+ *	@return NULL
+ */
+static void *BarCachePrefetchThread (void *data) {
+	BarCache_t *cache = data;
+
+	pthread_mutex_lock (&cache->lock);
+	while (cache->prefetchUrl != NULL && !cache->prefetchAbort) {
+		char * const url = cache->prefetchUrl;
+		char * const proxy = cache->prefetchProxy;
+
+		cache->prefetchUrl = NULL;
+		cache->prefetchProxy = NULL;
+		memcpy (cache->prefetchKey, cache->prefetchNextKey,
+				sizeof (cache->prefetchKey));
+
+		if (BarCacheFind (cache, cache->prefetchKey) == NULL) {
+			pthread_mutex_unlock (&cache->lock);
+			BarCachePrefetchDownload (cache, cache->prefetchKey, url, proxy);
+			pthread_mutex_lock (&cache->lock);
+		}
+		free (url);
+		free (proxy);
+
+		memset (cache->prefetchKey, 0, sizeof (cache->prefetchKey));
+		pthread_cond_broadcast (&cache->prefetchCond);
+	}
+	cache->prefetchRunning = false;
+	pthread_cond_broadcast (&cache->prefetchCond);
+	pthread_mutex_unlock (&cache->lock);
+
+	return NULL;
+}
+
+/*	download song in background, unless it is cached already; if another
+ *	download is still running, this one is queued and replaces any other
+ *	queued download
+ *	@param cache
+ *	@param key
+ *	@param audio url
+ *	@param proxy or NULL
+ */
+void BarCachePrefetch (BarCache_t *cache, const char *key, const char *url,
+		const char *proxy) {
+	bool running;
+
+	if (cache->dir == NULL || url == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock (&cache->lock);
+	if (BarCacheFind (cache, key) != NULL ||
+			strcmp (cache->prefetchKey, key) == 0) {
+		pthread_mutex_unlock (&cache->lock);
+		return;
+	}
+
+	free (cache->prefetchUrl);
+	free (cache->prefetchProxy);
+	memset (cache->prefetchNextKey, 0, sizeof (cache->prefetchNextKey));
+	snprintf (cache->prefetchNextKey, sizeof (cache->prefetchNextKey), "%s",
+			key);
+	cache->prefetchUrl = strdup (url);
+	cache->prefetchProxy = proxy == NULL ? NULL : strdup (proxy);
+
+	running = cache->prefetchRunning;
+	if (!running) {
+		cache->prefetchRunning = true;
+	}
+	pthread_mutex_unlock (&cache->lock);
+
+	if (running) {
+		/* picked up by the running thread */
+		return;
+	}
+
+	/* previous thread has left its loop already, this does not block */
+	if (cache->prefetchStarted) {
+		pthread_join (cache->prefetchThread, NULL);
+		cache->prefetchStarted = false;
+	}
+
+	cache->prefetchAbort = 0;
+	if (pthread_create (&cache->prefetchThread, NULL, BarCachePrefetchThread,
+			cache) == 0) {
+		cache->prefetchStarted = true;
+	} else {
+		pthread_mutex_lock (&cache->lock);
+		cache->prefetchRunning = false;
+		free (cache->prefetchUrl);
+		free (cache->prefetchProxy);
+		cache->prefetchUrl = NULL;
+		cache->prefetchProxy = NULL;
+		pthread_mutex_unlock (&cache->lock);
+	}
+}
+
+/*	wait until a running background download of key is finished, so the
+ *	song is not fetched twice
+ *	@param cache
+ *	@param key
+ *	@param stop waiting if this returns true, polled periodically
+ *	@param passed to cancel callback
+ */
+void BarCacheWaitPrefetch (BarCache_t *cache, const char *key,
+		bool (*cancel) (void *), void *data) {
+	if (cache->dir == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock (&cache->lock);
+	while (strcmp (cache->prefetchKey, key) == 0 && !cancel (data)) {
+		struct timeval now;
+		struct timespec deadline;
+
+		gettimeofday (&now, NULL);
+		/* 100ms */
+		deadline.tv_sec = now.tv_sec + (now.tv_usec + 100000) / 1000000;
+		deadline.tv_nsec = (now.tv_usec + 100000) % 1000000 * 1000;
+		pthread_cond_timedwait (&cache->prefetchCond, &cache->lock,
+				&deadline);
+	}
+	pthread_mutex_unlock (&cache->lock);
+}
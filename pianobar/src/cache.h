@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdbool.h>
+#include <signal.h>
+/* required for freebsd */
+#include <sys/types.h>
+#include <pthread.h>
+
+#include <piano.h>
+
+#define BAR_CACHE_KEY_LEN 64
+
+typedef struct BarCacheEntry {
+	char key[BAR_CACHE_KEY_LEN];
+	size_t size;
+	/* lru clock value of last access */
+	unsigned long lastUse;
+	struct BarCacheEntry *next;
+} BarCacheEntry_t;
+
+typedef struct {
+	/* NULL if cache is disabled */
+	char *dir;
+	size_t maxSize, curSize;
+	unsigned long clock;
+	BarCacheEntry_t *entries;
+	/* protects everything above */
+	pthread_mutex_t lock;
+
+	/* background download */
+	pthread_t prefetchThread;
+	/* thread created, but not joined yet; owner only */
+	bool prefetchStarted;
+	volatile sig_atomic_t prefetchAbort;
+	/* the fields below are protected by lock too; prefetch thread is
+	 * running and downloading prefetchKey (empty if it's about to exit) */
+	bool prefetchRunning;
+	char prefetchKey[BAR_CACHE_KEY_LEN];
+	/* queued download, picked up by prefetch thread; url is NULL if
+	 * nothing is queued */
+	char prefetchNextKey[BAR_CACHE_KEY_LEN];
+	char *prefetchUrl;
+	char *prefetchProxy;
+	/* signalled when a download is finished */
+	pthread_cond_t prefetchCond;
+} BarCache_t;
+
+/* mapped cache file */
+typedef struct {
+	void *data;
+	size_t size;
+} BarCacheMap_t;
+
+/* new cache file being written */
+typedef struct {
+	int fd;
+	char key[BAR_CACHE_KEY_LEN];
+	char *tmpPath;
+	size_t size;
+} BarCacheWriter_t;
+
+void BarCacheInit (BarCache_t *, const char *, size_t);
+void BarCacheDestroy (BarCache_t *);
+void BarCacheKey (const PianoSong_t *, char *, size_t);
+bool BarCacheMap (BarCache_t *, const char *, BarCacheMap_t *);
+void BarCacheUnmap (BarCacheMap_t *);
+bool BarCacheWriterOpen (BarCache_t *, const char *, BarCacheWriter_t *);
+void BarCacheWriterWrite (BarCacheWriter_t *, const void *, size_t);
+void BarCacheWriterClose (BarCache_t *, BarCacheWriter_t *, bool);
+void BarCachePrefetch (BarCache_t *, const char *, const char *,
+		const char *);
+void BarCacheWaitPrefetch (BarCache_t *, const char *, bool (*) (void *),
+		void *);
+
+#endif /* _CACHE_H */
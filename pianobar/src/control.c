@@ -0,0 +1,332 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* remote control through a unix socket: line-based commands, replies and
+ * event records are written back. nothing here blocks, slow clients are
+ * disconnected */
+
+#ifndef __FreeBSD__
+#define _POSIX_C_SOURCE 200112L
+#define _BSD_SOURCE /* strdup() */
+#define _DARWIN_C_SOURCE /* strdup() on OS X */
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "control.h"
+
+#ifndef MSG_NOSIGNAL
+/* os x, sigpipe is not an issue there */
+#define MSG_NOSIGNAL 0
+#endif
+
+/*	set up disabled control socket
+ *	@param control socket
+ */
+void BarControlInit (BarControl_t *ctl) {
+	memset (ctl, 0, sizeof (*ctl));
+	ctl->fd = -1;
+	for (size_t i = 0; i < BAR_CONTROL_CLIENTS; i++) {
+		ctl->clients[i].fd = -1;
+	}
+}
+
+/*	remove socket left behind by a pianobar that did not exit cleanly;
+ *	anything else, including the socket of a running pianobar, is kept
+ *	@param socket address
+ */
+static void BarControlRemoveStale (const struct sockaddr_un *addr) {
+	struct stat st;
+	int fd;
+
+	if (lstat (addr->sun_path, &st) == -1 || !S_ISSOCK (st.st_mode)) {
+		return;
+	}
+
+	/* nobody listening? */
+	if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		return;
+	}
+	if (connect (fd, (const struct sockaddr *) addr, sizeof (*addr)) == -1 &&
+			errno == ECONNREFUSED) {
+		unlink (addr->sun_path);
+	}
+	close (fd);
+}
+
+/*	create socket and listen, a stale socket file is replaced
+ *	@param control socket
+ *	@param path
+ *	@return true on success
+ */
+bool BarControlOpen (BarControl_t *ctl, const char *path) {
+	struct sockaddr_un addr;
+
+	if (strlen (path) >= sizeof (addr.sun_path)) {
+		return false;
+	}
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+	strcpy (addr.sun_path, path);
+
+	if ((ctl->fd = socket (AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		return false;
+	}
+	BarControlRemoveStale (&addr);
+	/* bind fails if the path is still in use */
+	if (bind (ctl->fd, (struct sockaddr *) &addr, sizeof (addr)) == -1 ||
+			listen (ctl->fd, BAR_CONTROL_CLIENTS) == -1 ||
+			fcntl (ctl->fd, F_SETFL, O_NONBLOCK) == -1 ||
+			fcntl (ctl->fd, F_SETFD, FD_CLOEXEC) == -1 ||
+			(ctl->path = strdup (path)) == NULL) {
+		close (ctl->fd);
+		ctl->fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+/*	disconnect client
+ *	@param client
+ */
+static void BarControlDrop (BarControlClient_t *client) {
+	close (client->fd);
+	client->fd = -1;
+	client->lineLen = 0;
+	client->subscribed = false;
+}
+
+/*	disconnect everyone and remove socket file
+ *	@param control socket
+ */
+void BarControlDestroy (BarControl_t *ctl) {
+	for (size_t i = 0; i < BAR_CONTROL_CLIENTS; i++) {
+		if (ctl->clients[i].fd != -1) {
+			BarControlDrop (&ctl->clients[i]);
+		}
+	}
+	if (ctl->fd != -1) {
+		close (ctl->fd);
+		ctl->fd = -1;
+		unlink (ctl->path);
+	}
+	free (ctl->path);
+	ctl->path = NULL;
+}
+
+/*	make BarReadline return if there is something to do for us
+ *	@param control socket
+ *	@param readline fds, watchSet is replaced
+ */
+void BarControlWatch (const BarControl_t *ctl, BarReadlineFds_t *input) {
+	FD_ZERO (&input->watchSet);
+	input->watchMaxfd = 0;
+
+	if (ctl->fd == -1) {
+		return;
+	}
+
+	FD_SET (ctl->fd, &input->watchSet);
+	input->watchMaxfd = ctl->fd + 1;
+	for (size_t i = 0; i < BAR_CONTROL_CLIENTS; i++) {
+		const int fd = ctl->clients[i].fd;
+		if (fd != -1) {
+			FD_SET (fd, &input->watchSet);
+			if (fd >= input->watchMaxfd) {
+				input->watchMaxfd = fd + 1;
+			}
+		}
+	}
+}
+
+/*	accept pending connections
+ *	@param control socket
+ */
+static void BarControlAccept (BarControl_t *ctl) {
+	int fd;
+
+	while ((fd = accept (ctl->fd, NULL, NULL)) != -1) {
+		BarControlClient_t *client = NULL;
+
+		for (size_t i = 0; i < BAR_CONTROL_CLIENTS; i++) {
+			if (ctl->clients[i].fd == -1) {
+				client = &ctl->clients[i];
+				break;
+			}
+		}
+		if (client == NULL || fcntl (fd, F_SETFL, O_NONBLOCK) == -1 ||
+				fcntl (fd, F_SETFD, FD_CLOEXEC) == -1) {
+			/* too many clients */
+			close (fd);
+			continue;
+		}
+		client->fd = fd;
+		client->lineLen = 0;
+		client->subscribed = false;
+	}
+}
+
+/*	read from client and run complete lines
+ *	@param client
+ *	@param command callback
+ *	@param callback data
+ */
+static void BarControlRead (BarControlClient_t *client,
+		BarControlCommandCb_t callback, void *data) {
+	const ssize_t ret = recv (client->fd, &client->line[client->lineLen],
+			sizeof (client->line) - client->lineLen, 0);
+	char *lineStart, *lineEnd;
+
+	if (ret == -1 && (errno == EAGAIN || errno == EINTR)) {
+		return;
+	} else if (ret <= 0) {
+		BarControlDrop (client);
+		return;
+	}
+	client->lineLen += ret;
+
+	lineStart = client->line;
+	while ((lineEnd = memchr (lineStart, '\n',
+			client->lineLen - (lineStart - client->line))) != NULL) {
+		*lineEnd = '\0';
+		if (lineEnd > lineStart && lineEnd[-1] == '\r') {
+			lineEnd[-1] = '\0';
+		}
+		callback (data, client, lineStart);
+		if (client->fd == -1) {
+			/* dropped by callback */
+			return;
+		}
+		lineStart = lineEnd + 1;
+	}
+
+	client->lineLen -= lineStart - client->line;
+	if (client->lineLen == sizeof (client->line)) {
+		/* line too long */
+		BarControlDrop (client);
+	} else {
+		memmove (client->line, lineStart, client->lineLen);
+	}
+}
+
+/*	accept clients and run their commands, does not block
+ *	@param control socket
+ *	@param called for every line
+ *	@param callback data
+ */
+void BarControlProcess (BarControl_t *ctl, BarControlCommandCb_t callback,
+		void *data) {
+	fd_set set;
+	int maxfd;
+	struct timeval timeout;
+
+	if (ctl->fd == -1) {
+		return;
+	}
+
+	FD_ZERO (&set);
+	FD_SET (ctl->fd, &set);
+	maxfd = ctl->fd;
+	for (size_t i = 0; i < BAR_CONTROL_CLIENTS; i++) {
+		const int fd = ctl->clients[i].fd;
+		if (fd != -1) {
+			FD_SET (fd, &set);
+			if (fd > maxfd) {
+				maxfd = fd;
+			}
+		}
+	}
+
+	memset (&timeout, 0, sizeof (timeout));
+	if (select (maxfd + 1, &set, NULL, NULL, &timeout) <= 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < BAR_CONTROL_CLIENTS; i++) {
+		BarControlClient_t * const client = &ctl->clients[i];
+		if (client->fd != -1 && FD_ISSET (client->fd, &set)) {
+			BarControlRead (client, callback, data);
+		}
+	}
+	if (FD_ISSET (ctl->fd, &set)) {
+		BarControlAccept (ctl);
+	}
+}
+
+/*	send to client; it is disconnected if it does not keep up
+ *	@param client
+ *	@param data
+ *	@param data length
+ */
+void BarControlReply (BarControlClient_t *client, const char *buf,
+		size_t len) {
+	while (client->fd != -1 && len > 0) {
+		const ssize_t ret = send (client->fd, buf, len, MSG_NOSIGNAL);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			BarControlDrop (client);
+			break;
+		}
+		buf += ret;
+		len -= ret;
+	}
+}
+
+/*	anyone interested in events?
+ *	@param control socket
+ */
+bool BarControlSubscribed (const BarControl_t *ctl) {
+	for (size_t i = 0; i < BAR_CONTROL_CLIENTS; i++) {
+		if (ctl->clients[i].fd != -1 && ctl->clients[i].subscribed) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*	send event record to subscribed clients
+ *	@param control socket
+ *	@param record
+ *	@param record length
+ */
+void BarControlPublish (BarControl_t *ctl, const char *buf, size_t len) {
+	for (size_t i = 0; i < BAR_CONTROL_CLIENTS; i++) {
+		BarControlClient_t * const client = &ctl->clients[i];
+		if (client->fd != -1 && client->subscribed) {
+			BarControlReply (client, buf, len);
+		}
+	}
+}
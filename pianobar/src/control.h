@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _CONTROL_H
+#define _CONTROL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ui_readline.h"
+
+#define BAR_CONTROL_CLIENTS 16
+/* longest command line */
+#define BAR_CONTROL_LINE 1024
+
+typedef struct {
+	/* -1 if unused */
+	int fd;
+	char line[BAR_CONTROL_LINE];
+	size_t lineLen;
+	/* receives event records */
+	bool subscribed;
+} BarControlClient_t;
+
+/* unix socket for remote control, line-based */
+typedef struct {
+	/* listening socket, -1 if disabled */
+	int fd;
+	char *path;
+	BarControlClient_t clients[BAR_CONTROL_CLIENTS];
+} BarControl_t;
+
+/* called for every complete line received */
+typedef void (*BarControlCommandCb_t) (void *, BarControlClient_t *, char *);
+
+void BarControlInit (BarControl_t *);
+bool BarControlOpen (BarControl_t *, const char *);
+void BarControlDestroy (BarControl_t *);
+void BarControlWatch (const BarControl_t *, BarReadlineFds_t *);
+void BarControlProcess (BarControl_t *, BarControlCommandCb_t, void *);
+void BarControlReply (BarControlClient_t *, const char *, size_t);
+bool BarControlSubscribed (const BarControl_t *);
+void BarControlPublish (BarControl_t *, const char *, size_t);
+
+#endif /* _CONTROL_H */
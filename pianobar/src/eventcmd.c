@@ -0,0 +1,340 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* long-running event command: the main thread queues event records, a
+ * background thread writes them to the command's stdin. a slow command does
+ * not hold up playback this way */
+
+#ifndef __FreeBSD__
+#define _POSIX_C_SOURCE 200112L
+#define _BSD_SOURCE /* strdup() */
+#define _DARWIN_C_SOURCE /* strdup() on OS X */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "eventcmd.h"
+
+#ifndef MSG_NOSIGNAL
+/* os x, sigpipe is not an issue there */
+#define MSG_NOSIGNAL 0
+#endif
+
+/* seconds a stuck command may hold up quitting, per step */
+#define BAR_EVENTCMD_QUIT_TIMEOUT 1
+
+/*	append to event record
+ *	@param record, zeroed before first use
+ *	@param printf format string
+ */
+void BarEventRecordPrintf (BarEventRecord_t *rec, const char *format, ...) {
+	va_list args;
+	int len;
+
+	if (rec->failed) {
+		return;
+	}
+
+	va_start (args, format);
+	len = vsnprintf (NULL, 0, format, args);
+	va_end (args);
+	if (len < 0) {
+		rec->failed = true;
+		return;
+	}
+
+	if (rec->len + len + 1 > rec->size) {
+		size_t newSize = rec->size == 0 ? 1024 : rec->size;
+		char *newData;
+
+		while (newSize < rec->len + len + 1) {
+			newSize *= 2;
+		}
+		if ((newData = realloc (rec->data, newSize)) == NULL) {
+			rec->failed = true;
+			return;
+		}
+		rec->data = newData;
+		rec->size = newSize;
+	}
+
+	va_start (args, format);
+	vsnprintf (rec->data + rec->len, rec->size - rec->len, format, args);
+	va_end (args);
+	rec->len += len;
+}
+
+/*	start event command, its stdin is connected to ec->fd
+ *	@param event command
+ *	@return true on success
+ */
+static bool BarEventCmdSpawn (BarEventCmd_t *ec) {
+	int sockFd[2];
+
+	/* a socket instead of a pipe, so writes can suppress sigpipe */
+	if (socketpair (AF_UNIX, SOCK_STREAM, 0, sockFd) == -1) {
+		return false;
+	}
+
+	ec->child = fork ();
+	if (ec->child == 0) {
+		/* child; must not keep pianobar's sockets, pipes, ... open */
+		long maxFd = sysconf (_SC_OPEN_MAX);
+
+		dup2 (sockFd[1], STDIN_FILENO);
+		if (maxFd == -1) {
+			maxFd = 1024;
+		}
+		for (int fd = STDERR_FILENO + 1; fd < maxFd; fd++) {
+			close (fd);
+		}
+		execl (ec->path, ec->path, "eventstream", (char *) NULL);
+		_exit (1);
+	} else if (ec->child == -1) {
+		close (sockFd[0]);
+		close (sockFd[1]);
+		return false;
+	}
+
+	close (sockFd[1]);
+	ec->fd = sockFd[0];
+	/* writes wait in select, so quitting is not held up by the command */
+	fcntl (ec->fd, F_SETFL, O_NONBLOCK);
+	fcntl (ec->fd, F_SETFD, FD_CLOEXEC);
+
+	return true;
+}
+
+/*	wait a little for child to exit
+ *	@param child
+ *	@return true if it exited
+ */
+static bool BarEventCmdWaitChild (pid_t child) {
+	const struct timespec step = {0, 100*1000*1000};
+
+	for (unsigned int i = 0; i < BAR_EVENTCMD_QUIT_TIMEOUT*10; i++) {
+		int status;
+		const pid_t ret = waitpid (child, &status, WNOHANG);
+		if (ret == child || (ret == -1 && errno != EINTR)) {
+			return true;
+		}
+		nanosleep (&step, NULL);
+	}
+	return false;
+}
+
+/*	close connection to event command and wait for it to exit; it is
+ *	terminated if it does not exit on eof
+ *	@param event command
+ */
+static void BarEventCmdReap (BarEventCmd_t *ec) {
+	if (ec->fd != -1) {
+		close (ec->fd);
+		ec->fd = -1;
+	}
+	if (ec->child != -1) {
+		if (!BarEventCmdWaitChild (ec->child)) {
+			kill (ec->child, SIGTERM);
+			if (!BarEventCmdWaitChild (ec->child)) {
+				int status;
+				kill (ec->child, SIGKILL);
+				waitpid (ec->child, &status, 0);
+			}
+		}
+		ec->child = -1;
+	}
+}
+
+/*	BarEventCmdDestroy has been called?
+ *	@param event command
+ */
+static bool BarEventCmdQuitting (BarEventCmd_t *ec) {
+	bool quit;
+
+	pthread_mutex_lock (&ec->lock);
+	quit = ec->quit;
+	pthread_mutex_unlock (&ec->lock);
+
+	return quit;
+}
+
+/*	write record to event command
+ *	@param event command, running
+ *	@param record
+ *	@return false if the command exited
+ */
+static bool BarEventCmdWrite (BarEventCmd_t *ec, const char *rec) {
+	size_t len = strlen (rec);
+
+	while (len > 0) {
+		const ssize_t ret = send (ec->fd, rec, len, MSG_NOSIGNAL);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				/* command is busy; wait for it, unless we are quitting */
+				struct timeval timeout = {BAR_EVENTCMD_QUIT_TIMEOUT, 0};
+				fd_set set;
+
+				FD_ZERO (&set);
+				FD_SET (ec->fd, &set);
+				if (select (ec->fd + 1, NULL, &set, NULL, &timeout) == 0 &&
+						BarEventCmdQuitting (ec)) {
+					return false;
+				}
+				continue;
+			}
+			return false;
+		}
+		rec += ret;
+		len -= ret;
+	}
+	return true;
+}
+
+/*	feed queued records to event command until BarEventCmdDestroy
+ */
+static void *BarEventCmdThread (void *data) {
+	BarEventCmd_t *ec = data;
+	bool giveUp = false;
+
+	pthread_mutex_lock (&ec->lock);
+	while (true) {
+		char *rec;
+
+		while (ec->count == 0 && !ec->quit) {
+			pthread_cond_wait (&ec->wakeup, &ec->lock);
+		}
+		if (ec->count == 0) {
+			/* quit, everything has been written */
+			break;
+		}
+		rec = ec->queue[ec->head];
+		ec->head = (ec->head + 1) % BAR_EVENTCMD_QUEUE_SIZE;
+		--ec->count;
+		pthread_mutex_unlock (&ec->lock);
+
+		/* (re)start command if necessary; a record is tried on one fresh
+		 * instance at most, otherwise a broken command would be restarted
+		 * over and over */
+		for (unsigned int i = 0; i < 2; i++) {
+			if (ec->fd == -1 && !BarEventCmdSpawn (ec)) {
+				break;
+			}
+			if (BarEventCmdWrite (ec, rec)) {
+				break;
+			}
+			BarEventCmdReap (ec);
+			if (BarEventCmdQuitting (ec)) {
+				/* do not start it again just to wait for it */
+				giveUp = true;
+				break;
+			}
+		}
+		free (rec);
+
+		pthread_mutex_lock (&ec->lock);
+		if (giveUp) {
+			while (ec->count > 0) {
+				free (ec->queue[ec->head]);
+				ec->head = (ec->head + 1) % BAR_EVENTCMD_QUEUE_SIZE;
+				--ec->count;
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock (&ec->lock);
+
+	BarEventCmdReap (ec);
+
+	return NULL;
+}
+
+/*	set up event command; it is started when the first record arrives
+ *	@param event command
+ *	@param path to executable
+ */
+void BarEventCmdInit (BarEventCmd_t *ec, const char *path) {
+	memset (ec, 0, sizeof (*ec));
+	ec->fd = -1;
+	ec->child = -1;
+	pthread_mutex_init (&ec->lock, NULL);
+	pthread_cond_init (&ec->wakeup, NULL);
+
+	if ((ec->path = strdup (path)) != NULL &&
+			pthread_create (&ec->thread, NULL, BarEventCmdThread, ec) == 0) {
+		ec->started = true;
+	}
+}
+
+/*	queue record, never blocks
+ *	@param event command
+ *	@param malloc'ed record, owned by the event command on success
+ *	@return false if the queue is full
+ */
+bool BarEventCmdPush (BarEventCmd_t *ec, char *rec) {
+	bool queued = false;
+
+	pthread_mutex_lock (&ec->lock);
+	if (ec->started && ec->count < BAR_EVENTCMD_QUEUE_SIZE) {
+		ec->queue[(ec->head + ec->count) % BAR_EVENTCMD_QUEUE_SIZE] = rec;
+		++ec->count;
+		queued = true;
+		pthread_cond_signal (&ec->wakeup);
+	}
+	pthread_mutex_unlock (&ec->lock);
+
+	return queued;
+}
+
+/*	write pending records, then close the command's stdin and wait for it.
+ *	a command that does not keep up or exit is given up on after a few
+ *	seconds
+ *	@param event command
+ */
+void BarEventCmdDestroy (BarEventCmd_t *ec) {
+	if (ec->started) {
+		pthread_mutex_lock (&ec->lock);
+		ec->quit = true;
+		pthread_cond_signal (&ec->wakeup);
+		pthread_mutex_unlock (&ec->lock);
+
+		pthread_join (ec->thread, NULL);
+		ec->started = false;
+	}
+	pthread_cond_destroy (&ec->wakeup);
+	pthread_mutex_destroy (&ec->lock);
+	free (ec->path);
+	ec->path = NULL;
+}
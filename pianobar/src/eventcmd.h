@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _EVENTCMD_H
+#define _EVENTCMD_H
+
+#include <stdbool.h>
+/* required for freebsd */
+#include <sys/types.h>
+#include <pthread.h>
+
+/* records waiting for the event command; new ones are dropped if full */
+#define BAR_EVENTCMD_QUEUE_SIZE 32
+
+/* event record, growing string */
+typedef struct {
+	char *data;
+	size_t len, size;
+	/* allocation failed, data is incomplete */
+	bool failed;
+} BarEventRecord_t;
+
+/* long-running event command, fed by a background thread */
+typedef struct {
+	char *path;
+
+	pthread_t thread;
+	/* thread created, but not joined yet */
+	bool started;
+
+	/* ring buffer of malloc'ed records, protected by lock */
+	pthread_mutex_t lock;
+	pthread_cond_t wakeup;
+	char *queue[BAR_EVENTCMD_QUEUE_SIZE];
+	size_t head, count;
+	bool quit;
+
+	/* child, thread only */
+	pid_t child;
+	int fd;
+} BarEventCmd_t;
+
+void BarEventRecordPrintf (BarEventRecord_t *, const char *, ...);
+void BarEventCmdInit (BarEventCmd_t *, const char *);
+void BarEventCmdDestroy (BarEventCmd_t *);
+bool BarEventCmdPush (BarEventCmd_t *, char *);
+
+#endif /* _EVENTCMD_H */
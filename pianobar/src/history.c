@@ -0,0 +1,212 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* song history, kept in a ring buffer and saved across restarts */
+
+#ifndef __FreeBSD__
+#define _POSIX_C_SOURCE 200112L
+#define _BSD_SOURCE /* strdup() */
+#define _DARWIN_C_SOURCE /* strdup() on OS X */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "history.h"
+
+/* first line of history file */
+#define BAR_HISTORY_MAGIC "pianobar history 1"
+
+/* fields stored in history file, one line per song, tab-separated; the
+ * audio url expires, so it is not saved */
+#define BAR_HISTORY_FIELDS(song) {&(song)->artist, &(song)->title, \
+		&(song)->album, &(song)->stationId, &(song)->musicId, \
+		&(song)->artistMusicId, &(song)->userSeed, &(song)->seedId, \
+		&(song)->feedbackId, &(song)->detailUrl, &(song)->trackToken, \
+		&(song)->coverArt}
+
+/*	set up empty history
+ *	@param history
+ *	@param max number of songs, 0 disables history
+ */
+void BarHistoryInit (BarHistory_t *history, size_t size) {
+	memset (history, 0, sizeof (*history));
+	if (size > 0 &&
+			(history->songs = calloc (size, sizeof (*history->songs))) != NULL) {
+		history->size = size;
+	}
+}
+
+/*	free all songs
+ *	@param history
+ */
+void BarHistoryDestroy (BarHistory_t *history) {
+	for (size_t i = 0; i < history->count; i++) {
+		PianoDestroyPlaylist (BarHistoryGet (history, i));
+	}
+	free (history->songs);
+	memset (history, 0, sizeof (*history));
+}
+
+/*	add song, the oldest one is destroyed if history is full
+ *	@param history
+ *	@param song, must not be part of a list; owned by history afterwards
+ */
+void BarHistoryPrepend (BarHistory_t *history, PianoSong_t *song) {
+	song->next = NULL;
+
+	if (history->size == 0) {
+		PianoDestroyPlaylist (song);
+		return;
+	}
+
+	/* the slot in front of the newest song holds the oldest one if full */
+	history->first = (history->first + history->size - 1) % history->size;
+	if (history->count == history->size) {
+		PianoDestroyPlaylist (history->songs[history->first]);
+	} else {
+		++history->count;
+	}
+	history->songs[history->first] = song;
+}
+
+/*	get song by age
+ *	@param history
+ *	@param index, 0 is the newest song
+ *	@return song or NULL if index is out of range
+ */
+PianoSong_t *BarHistoryGet (const BarHistory_t *history, size_t i) {
+	if (i >= history->count) {
+		return NULL;
+	}
+	return history->songs[(history->first + i) % history->size];
+}
+
+/*	read saved history; songs are added to the current ones
+ *	@param history
+ *	@param file name
+ */
+void BarHistoryLoad (BarHistory_t *history, const char *path) {
+	char line[4096];
+	FILE *fp;
+
+	if (history->size == 0 || (fp = fopen (path, "r")) == NULL) {
+		return;
+	}
+
+	if (fgets (line, sizeof (line), fp) == NULL ||
+			strcmp (line, BAR_HISTORY_MAGIC "\n") != 0) {
+		fclose (fp);
+		return;
+	}
+
+	/* oldest song first */
+	while (fgets (line, sizeof (line), fp) != NULL) {
+		PianoSong_t *song;
+		char *pos = line, *end;
+		const size_t len = strlen (line);
+
+		if (len == 0 || line[len-1] != '\n') {
+			/* too long, skip the rest; newer songs follow */
+			int c;
+			while ((c = fgetc (fp)) != '\n' && c != EOF);
+			continue;
+		}
+		line[len-1] = '\0';
+
+		if ((song = calloc (1, sizeof (*song))) == NULL) {
+			break;
+		}
+		char **fields[] = BAR_HISTORY_FIELDS (song);
+		for (size_t i = 0; i < sizeof (fields) / sizeof (*fields); i++) {
+			if ((end = strchr (pos, '\t')) == NULL) {
+				break;
+			}
+			*end = '\0';
+			if (*pos != '\0') {
+				*fields[i] = strdup (pos);
+			}
+			pos = end+1;
+		}
+		song->rating = atoi (pos);
+
+		/* printed and searched without checking for NULL */
+		if (song->artist == NULL) {
+			song->artist = strdup ("");
+		}
+		if (song->title == NULL) {
+			song->title = strdup ("");
+		}
+
+		if (song->musicId == NULL || song->stationId == NULL ||
+				song->artist == NULL || song->title == NULL) {
+			/* broken line */
+			PianoDestroyPlaylist (song);
+			continue;
+		}
+		BarHistoryPrepend (history, song);
+	}
+	fclose (fp);
+}
+
+/*	write history
+ *	@param history
+ *	@param file name
+ */
+void BarHistorySave (const BarHistory_t *history, const char *path) {
+	char tmpPath[PATH_MAX];
+	FILE *fp;
+
+	if (history->size == 0) {
+		return;
+	}
+
+	snprintf (tmpPath, sizeof (tmpPath), "%s.tmp", path);
+	if ((fp = fopen (tmpPath, "w")) == NULL) {
+		return;
+	}
+
+	fputs (BAR_HISTORY_MAGIC "\n", fp);
+	for (size_t i = history->count; i > 0; i--) {
+		PianoSong_t * const song = BarHistoryGet (history, i-1);
+		char **fields[] = BAR_HISTORY_FIELDS (song);
+
+		for (size_t j = 0; j < sizeof (fields) / sizeof (*fields); j++) {
+			/* tabs and newlines would break the file */
+			for (const char *c = *fields[j]; c != NULL && *c != '\0'; c++) {
+				fputc ((*c == '\t' || *c == '\n') ? ' ' : *c, fp);
+			}
+			fputc ('\t', fp);
+		}
+		fprintf (fp, "%d\n", song->rating);
+	}
+
+	if (fclose (fp) == 0) {
+		rename (tmpPath, path);
+	} else {
+		unlink (tmpPath);
+	}
+}
@@ -0,0 +1,48 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _HISTORY_H
+#define _HISTORY_H
+
+#include <stddef.h>
+
+#include <piano.h>
+
+/* fixed-size ring of recently played songs, index 0 is the newest one */
+typedef struct {
+	/* NULL if history is disabled */
+	PianoSong_t **songs;
+	size_t size;
+	/* position of newest song */
+	size_t first;
+	size_t count;
+} BarHistory_t;
+
+void BarHistoryInit (BarHistory_t *, size_t);
+void BarHistoryDestroy (BarHistory_t *);
+void BarHistoryPrepend (BarHistory_t *, PianoSong_t *);
+PianoSong_t *BarHistoryGet (const BarHistory_t *, size_t);
+void BarHistoryLoad (BarHistory_t *, const char *);
+void BarHistorySave (const BarHistory_t *, const char *);
+
+#endif /* _HISTORY_H */
@@ -35,11 +35,27 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <stdint.h>
 #include "ezxml.h"
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#define EZXML_SSE2
+#include <emmintrin.h>
+#endif
+
 #define EZXML_WS   "\t\r\n "  // whitespace
 #define EZXML_ERRL 128        // maximum error string length
 
+typedef struct ezxml_block *ezxml_block_t;
+struct ezxml_block {      // arena memory, see ezxml_parse_str_arena()
+    ezxml_block_t next;   // previously filled block
+    size_t size;          // usable bytes
+    size_t used;          // bytes handed out
+    union { void *p; double d; long l; } data[]; // aligned for any tag data
+};
+
+#define EZXML_ALIGN sizeof(((ezxml_block_t)NULL)->data[0])
+
 typedef struct ezxml_root *ezxml_root_t;
 struct ezxml_root {       // additional data for the root tag
     struct ezxml xml;     // is a super-struct built on top of ezxml struct
@@ -52,12 +68,100 @@ struct ezxml_root {       // additional data for the root tag
     char **ent;           // general entities (ampersand sequences)
     char ***attr;         // default attributes
     char ***pi;           // processing instructions
+    ezxml_block_t block;  // current arena block, NULL if none
     short standalone;     // non-zero if <?xml standalone="yes"?>
     char err[EZXML_ERRL]; // error string
 };
 
 char *EZXML_NIL[] = { NULL }; // empty, null terminated array of strings
 
+#ifdef EZXML_SSE2
+// Returns a pointer to the first a, b or null terminator in s. Compares 16
+// bytes at a time. Aligned loads never cross a page boundary, but may read
+// bytes past the terminator, which address sanitizer would complain about.
+__attribute__((no_sanitize_address))
+static char *ezxml_find(char *s, char a, char b)
+{
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b),
+                  vz = _mm_setzero_si128();
+    const size_t off = (uintptr_t)s & 15;
+    const __m128i *p = (const __m128i *)(s - off);
+    __m128i v = _mm_load_si128(p);
+    unsigned int m;
+
+    m = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va),
+        _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vz))) >> off; // skip head
+    while (! m) {
+        v = _mm_load_si128(++p);
+        m = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va),
+            _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vz)));
+        s = (char *)p;
+    }
+    return s + __builtin_ctz(m);
+}
+#else
+// returns a pointer to the first a, b or null terminator in s
+static char *ezxml_find(char *s, char a, char b)
+{
+    while (*s && *s != a && *s != b) s++;
+    return s;
+}
+#endif
+
+// adds a new arena block of at least len bytes, returns the block
+static ezxml_block_t ezxml_grow(ezxml_root_t root, size_t len)
+{
+    ezxml_block_t b = root->block;
+    size_t size = (b) ? b->size * 2 : EZXML_BUFSIZE;
+
+    if (size < len) size = len;
+    if (! (b = malloc(sizeof(struct ezxml_block) + size))) return NULL;
+    b->next = root->block;
+    b->size = size;
+    b->used = 0;
+    return root->block = b;
+}
+
+// returns len bytes of memory for the document, taken from the arena if root
+// has one, malloced otherwise
+static void *ezxml_alloc(ezxml_root_t root, size_t len)
+{
+    ezxml_block_t b;
+    void *p;
+
+    if (! root || ! (root->xml.flags & EZXML_ARENA)) return malloc(len);
+
+    len = (len + EZXML_ALIGN - 1) / EZXML_ALIGN * EZXML_ALIGN;
+    if (! (b = root->block) || b->size - b->used < len)
+        if (! (b = ezxml_grow(root, len))) return NULL;
+    p = (char *)b->data + b->used;
+    b->used += len;
+    return p;
+}
+
+// resizes memory returned by ezxml_alloc(), old is its current size. arena
+// memory is extended in place if it is the last allocation, copied otherwise
+static void *ezxml_realloc(ezxml_root_t root, void *p, size_t old, size_t len)
+{
+    ezxml_block_t b;
+    size_t o, l;
+    void *r;
+
+    if (! root || ! (root->xml.flags & EZXML_ARENA)) return realloc(p, len);
+    if (! p) return ezxml_alloc(root, len);
+
+    b = root->block;
+    o = (old + EZXML_ALIGN - 1) / EZXML_ALIGN * EZXML_ALIGN;
+    l = (len + EZXML_ALIGN - 1) / EZXML_ALIGN * EZXML_ALIGN;
+    if ((char *)p + o == (char *)b->data + b->used &&
+        (size_t)((char *)p - (char *)b->data) + l <= b->size) {
+        b->used += l - o;
+        return p;
+    }
+    if ((r = ezxml_alloc(root, len))) memcpy(r, p, (old < len) ? old : len);
+    return r;
+}
+
 // sets a flag for the given tag and returns the tag
 static ezxml_t ezxml_set_flag(ezxml_t xml, short flag) {
     if (xml) xml->flags |= flag;
@@ -72,11 +176,13 @@ static ezxml_t ezxml_insert(ezxml_t xml, ezxml_t dest, size_t off)
     xml->next = xml->sibling = xml->ordered = NULL;
     xml->off = off;
     xml->parent = dest;
+    xml->tail = xml;
 
     if ((head = dest->child)) { // already have sub tags
         if (head->off <= off) { // not first subtag
-            for (cur = head; cur->ordered && cur->ordered->off <= off;
-                 cur = cur->ordered);
+            // the parser always appends, don't walk the whole list then
+            cur = (dest->last->off <= off) ? dest->last : head;
+            while (cur->ordered && cur->ordered->off <= off) cur = cur->ordered;
             xml->ordered = cur->ordered;
             cur->ordered = xml;
         }
@@ -84,36 +190,42 @@ static ezxml_t ezxml_insert(ezxml_t xml, ezxml_t dest, size_t off)
             xml->ordered = head;
             dest->child = xml;
         }
+        if (! xml->ordered) dest->last = xml;
 
         for (cur = head, prev = NULL; cur && strcmp(cur->name, xml->name);
              prev = cur, cur = cur->sibling); // find tag type
         if (cur && cur->off <= off) { // not first of type
+            head = cur; // first of type
+            if (cur->tail->off <= off) cur = cur->tail; // append
             while (cur->next && cur->next->off <= off) cur = cur->next;
             xml->next = cur->next;
             cur->next = xml;
+            if (! xml->next) head->tail = xml;
         }
         else { // first tag of this type
             if (prev && cur) prev->sibling = cur->sibling; // remove old first
             xml->next = cur; // old first tag is now next
+            if (cur) xml->tail = cur->tail;
             for (cur = head, prev = NULL; cur && cur->off <= off;
                  prev = cur, cur = cur->sibling); // new sibling insert point
             xml->sibling = cur;
             if (prev) prev->sibling = xml;
         }
     }
-    else dest->child = xml; // only sub tag
+    else dest->child = dest->last = xml; // only sub tag
 
     return xml;
 }
 
 // Adds a child tag. off is the offset of the child tag relative to the start
 // of the parent tag's character content. Returns the child tag.
-static ezxml_t ezxml_add_child(ezxml_t xml, const char *name, size_t off)
+static ezxml_t ezxml_add_child(ezxml_root_t root, ezxml_t xml,
+                               const char *name, size_t off)
 {
     ezxml_t child;
 
     if (! xml) return NULL;
-    child = (ezxml_t)memset(malloc(sizeof(struct ezxml)), '\0',
+    child = (ezxml_t)memset(ezxml_alloc(root, sizeof(struct ezxml)), '\0',
                             sizeof(struct ezxml));
     child->name = (char *)name;
     child->attr = EZXML_NIL;
@@ -222,21 +334,22 @@ static ezxml_t ezxml_err(ezxml_root_t root, char *s, const char *err, ...)
 // to '&' for general entity decoding, '%' for parameter entity decoding, 'c'
 // for cdata sections, ' ' for attribute normalization, or '*' for non-cdata
 // attribute normalization. Returns s, or if the decoded string is longer than
-// s, returns a malloced string that must be freed.
-static char *ezxml_decode(char *s, char **ent, char t)
+// s, returns a string allocated with ezxml_alloc(root, ...) (malloced if root
+// is NULL).
+static char *ezxml_decode(ezxml_root_t root, char *s, char **ent, char t)
 {
     char *e, *r = s, *m = s;
     long b, c, d, l;
 
-    for (; *s; s++) { // normalize line endings
-        while (*s == '\r') {
-            *(s++) = '\n';
-            if (*s == '\n') memmove(s, (s + 1), strlen(s));
-        }
+    while (*(s = ezxml_find(s, '\r', '\r'))) { // normalize line endings
+        *(s++) = '\n';
+        if (*s == '\n') memmove(s, (s + 1), strlen(s));
     }
     
     for (s = r; ; ) {
-        while (*s && *s != '&' && (*s != '%' || t != '%') && !isspace(*s)) s++;
+        if (t != ' ' && t != '*') // whitespace needs no attention
+            s = ezxml_find(s, '&', (t == '%') ? '%' : '&');
+        else while (*s && *s != '&' && ! isspace(*s)) s++;
 
         if (! *s) break;
         else if (t != 'c' && ! strncmp(s, "&#", 2)) { // character reference
@@ -262,7 +375,8 @@ static char *ezxml_decode(char *s, char **ent, char t)
             if (ent[b++]) { // found a match
                 if ((c = strlen(ent[b])) - 1 > (e = strchr(s, ';')) - s) {
                     l = (d = (s - r)) + c + strlen(e); // new length
-                    r = (r == m) ? strcpy(malloc(l), r) : realloc(r, l);
+                    r = (r == m) ? strcpy(ezxml_alloc(root, l), r)
+                                 : ezxml_realloc(root, r, strlen(r) + 1, l);
                     e = strchr((s = r + d), ';'); // fix up pointers
                 }
 
@@ -290,7 +404,7 @@ static void ezxml_open_tag(ezxml_root_t root, char *name, char **attr)
 {
     ezxml_t xml = root->cur;
     
-    if (xml->name) xml = ezxml_add_child(xml, name, strlen(xml->txt));
+    if (xml->name) xml = ezxml_add_child(root, xml, name, strlen(xml->txt));
     else xml->name = name; // first open tag
 
     xml->attr = attr;
@@ -307,15 +421,17 @@ static void ezxml_char_content(ezxml_root_t root, char *s, size_t len, char t)
     if (! xml || ! xml->name || ! len) return; // sanity check
 
     s[len] = '\0'; // null terminate text (calling functions anticipate this)
-    len = strlen(s = ezxml_decode(s, root->ent, t)) + 1;
+    len = strlen(s = ezxml_decode(root, s, root->ent, t)) + 1;
 
     if (! *(xml->txt)) xml->txt = s; // initial character content
     else { // allocate our own memory and make a copy
+        l = strlen(xml->txt);
         xml->txt = (xml->flags & EZXML_TXTM) // allocate some space
-                   ? realloc(xml->txt, (l = strlen(xml->txt)) + len)
-                   : strcpy(malloc((l = strlen(xml->txt)) + len), xml->txt);
+                   ? ezxml_realloc(root, xml->txt, l + 1, l + len)
+                   : strcpy(ezxml_alloc(root, l + len), xml->txt);
         strcpy(xml->txt + l, s); // add new char content
-        if (s != m) free(s); // free s if it was malloced by ezxml_decode()
+        if (s != m && ! (root->xml.flags & EZXML_ARENA))
+            free(s); // free s if it was malloced by ezxml_decode()
     }
 
     if (xml->txt != m) ezxml_set_flag(xml, EZXML_TXTM);
@@ -413,7 +529,7 @@ static short ezxml_internal_dtd(ezxml_root_t root, char *s, size_t len)
 
             *(++s) = '\0'; // null terminate name
             if ((s = strchr(v, q))) *(s++) = '\0'; // null terminate value
-            ent[i + 1] = ezxml_decode(v, pe, '%'); // set value
+            ent[i + 1] = ezxml_decode(NULL, v, pe, '%'); // set value
             ent[i + 2] = NULL; // null terminate entity list
             if (! ezxml_ent_ok(n, ent[i + 1], ent)) { // circular reference
                 if (ent[i + 1] != v) free(ent[i + 1]);
@@ -468,8 +584,8 @@ static short ezxml_internal_dtd(ezxml_root_t root, char *s, size_t len)
 
                 root->attr[i][j + 3] = NULL; // null terminate list
                 root->attr[i][j + 2] = c; // is it cdata?
-                root->attr[i][j + 1] = (v) ? ezxml_decode(v, root->ent, *c)
-                                           : NULL;
+                root->attr[i][j + 1] = (v) ? ezxml_decode(NULL, v, root->ent,
+                                                          *c) : NULL;
                 root->attr[i][j] = n; // attribute name 
                 ++s;
             }
@@ -520,12 +636,13 @@ static char *ezxml_str2utf8(char **s, size_t *len)
     return *s = realloc(u, *len = l);
 }
 
-// frees a tag attribute list
-static void ezxml_free_attr(char **attr) {
+// frees a tag attribute list, unless it belongs to root's arena
+static void ezxml_free_attr(ezxml_root_t root, char **attr) {
     int i = 0;
     char *m;
     
     if (! attr || attr == EZXML_NIL) return; // nothing to free
+    if (root && (root->xml.flags & EZXML_ARENA)) return; // freed with root
     while (attr[i]) i += 2; // find end of attribute list
     m = attr[i + 1]; // list of which names and values are malloced
     for (i = 0; m[i]; i++) {
@@ -536,10 +653,9 @@ static void ezxml_free_attr(char **attr) {
     free(attr);
 }
 
-// parse the given xml string and return an ezxml structure
-ezxml_t ezxml_parse_str(char *s, size_t len)
+// parse the given xml string into the new document root
+static ezxml_t ezxml_parse(ezxml_root_t root, char *s, size_t len)
 {
-    ezxml_root_t root = (ezxml_root_t)ezxml_new(NULL);
     char q, e, *d, **attr, **a = NULL; // initialize a to avoid compile warning
     int l, i, j;
 
@@ -551,7 +667,7 @@ ezxml_t ezxml_parse_str(char *s, size_t len)
     e = s[len - 1]; // save end char
     s[len - 1] = '\0'; // turn end char into null terminator
 
-    while (*s && *s != '<') s++; // find first tag
+    s = ezxml_find(s, '<', '<'); // find first tag
     if (! *s) return ezxml_err(root, s, "root tag missing");
 
     for (; ; ) {
@@ -569,10 +685,12 @@ ezxml_t ezxml_parse_str(char *s, size_t len)
                 for (i = 0; (a = root->attr[i]) && strcmp(a[0], d); i++);
 
             for (l = 0; *s && *s != '/' && *s != '>'; l += 2) { // new attrib
-                attr = (l) ? realloc(attr, (l + 4) * sizeof(char *))
-                           : malloc(4 * sizeof(char *)); // allocate space
-                attr[l + 3] = (l) ? realloc(attr[l + 1], (l / 2) + 2)
-                                  : malloc(2); // mem for list of maloced vals
+                attr = (l) ? ezxml_realloc(root, attr, (l + 2) * sizeof(char *),
+                                           (l + 4) * sizeof(char *))
+                           : ezxml_alloc(root, 4 * sizeof(char *)); // space
+                attr[l + 3] = (l) ? ezxml_realloc(root, attr[l + 1],
+                                                  (l / 2) + 1, (l / 2) + 2)
+                                  : ezxml_alloc(root, 2); // list of maloced vals
                 strcpy(attr[l + 3] + (l / 2), " "); // value is not malloced
                 attr[l + 2] = NULL; // null terminate list
                 attr[l + 1] = ""; // temporary attribute value
@@ -587,13 +705,14 @@ ezxml_t ezxml_parse_str(char *s, size_t len)
                         while (*s && *s != q) s++;
                         if (*s) *(s++) = '\0'; // null terminate attribute val
                         else {
-                            ezxml_free_attr(attr);
+                            ezxml_free_attr(root, attr);
                             return ezxml_err(root, d, "missing %c", q);
                         }
 
                         for (j = 1; a && a[j] && strcmp(a[j], attr[l]); j +=3);
-                        attr[l + 1] = ezxml_decode(attr[l + 1], root->ent, (a
-                                                   && a[j]) ? *a[j + 2] : ' ');
+                        attr[l + 1] = ezxml_decode(root, attr[l + 1], root->ent,
+                                                   (a && a[j]) ? *a[j + 2]
+                                                   : ' ');
                         if (attr[l + 1] < d || attr[l + 1] > s)
                             attr[l + 3][l / 2] = EZXML_TXTM; // value malloced
                     }
@@ -604,7 +723,7 @@ ezxml_t ezxml_parse_str(char *s, size_t len)
             if (*s == '/') { // self closing tag
                 *(s++) = '\0';
                 if ((*s && *s != '>') || (! *s && e != '>')) {
-                    if (l) ezxml_free_attr(attr);
+                    if (l) ezxml_free_attr(root, attr);
                     return ezxml_err(root, d, "missing >");
                 }
                 ezxml_open_tag(root, d, attr);
@@ -616,7 +735,7 @@ ezxml_t ezxml_parse_str(char *s, size_t len)
                 *s = q;
             }
             else {
-                if (l) ezxml_free_attr(attr);
+                if (l) ezxml_free_attr(root, attr);
                 return ezxml_err(root, d, "missing >"); 
             }
         }
@@ -657,7 +776,7 @@ ezxml_t ezxml_parse_str(char *s, size_t len)
         *s = '\0';
         d = ++s;
         if (*s && *s != '<') { // tag character content
-            while (*s && *s != '<') s++;
+            s = ezxml_find(s, '<', '<');
             if (*s) ezxml_char_content(root, d, s - d, '&');
             else break;
         }
@@ -669,16 +788,41 @@ ezxml_t ezxml_parse_str(char *s, size_t len)
     else return ezxml_err(root, d, "unclosed tag <%s>", root->cur->name);
 }
 
+// parse the given xml string and return an ezxml structure
+ezxml_t ezxml_parse_str(char *s, size_t len)
+{
+    return ezxml_parse((ezxml_root_t)ezxml_new(NULL), s, len);
+}
+
+// parse the given xml string into an ezxml structure that lives in an arena
+ezxml_t ezxml_parse_str_arena(char *s, size_t len)
+{
+    ezxml_root_t root = (ezxml_root_t)ezxml_new(NULL);
+
+    root->xml.flags |= EZXML_ARENA;
+    ezxml_grow(root, len * 2); // tags need about twice the size of the text
+    return ezxml_parse(root, s, len);
+}
+
 // free the memory allocated for the ezxml structure
 void ezxml_free(ezxml_t xml)
 {
     ezxml_root_t root = (ezxml_root_t)xml;
+    ezxml_block_t b;
     int i, j;
     char **a, *s;
 
     if (! xml) return;
-    ezxml_free(xml->child);
-    ezxml_free(xml->ordered);
+    if (xml->flags & EZXML_ARENA) { // all other tags are in the arena
+        while ((b = root->block)) {
+            root->block = b->next;
+            free(b);
+        }
+    }
+    else {
+        ezxml_free(xml->child);
+        ezxml_free(xml->ordered);
+    }
 
     if (! xml->parent) { // free root tag allocations
         for (i = 10; root->ent[i]; i += 2) // 0 - 9 are default entites (<>&"')
@@ -703,9 +847,11 @@ void ezxml_free(ezxml_t xml)
         if (root->u) free(root->u); // utf8 conversion
     }
 
-    ezxml_free_attr(xml->attr); // tag attributes
-    if ((xml->flags & EZXML_TXTM)) free(xml->txt); // character content
-    if ((xml->flags & EZXML_NAMEM)) free(xml->name); // tag name
+    if (! (xml->flags & EZXML_ARENA)) {
+        ezxml_free_attr(NULL, xml->attr); // tag attributes
+        if ((xml->flags & EZXML_TXTM)) free(xml->txt); // character content
+        if ((xml->flags & EZXML_NAMEM)) free(xml->name); // tag name
+    }
     free(xml);
 }
 
@@ -34,6 +34,7 @@
 #define EZXML_NAMEM   0x80 // name is malloced
 #define EZXML_TXTM    0x40 // txt is malloced
 #define EZXML_DUP     0x20 // attribute name and value are strduped
+#define EZXML_ARENA   0x10 // root tag owns the memory of the whole document
 
 typedef struct ezxml *ezxml_t;
 struct ezxml {
@@ -46,6 +47,8 @@ struct ezxml {
     ezxml_t ordered; // next tag, same section and depth, in original order
     ezxml_t child;   // head of sub tag list, NULL if none
     ezxml_t parent;  // parent tag, NULL if current tag is root tag
+    ezxml_t last;    // last sub tag in original order, NULL if none
+    ezxml_t tail;    // last tag of the next list, valid in its first tag only
     short flags;     // additional information
 };
 
@@ -55,6 +58,11 @@ struct ezxml {
 // pass in the copy. Returns NULL on failure.
 ezxml_t ezxml_parse_str(char *s, size_t len);
 
+// Same as ezxml_parse_str(), but all tags, attribute lists and decoded
+// character content are carved out of a few large blocks owned by the root
+// tag. ezxml_free() releases them at once; only the root may be freed.
+ezxml_t ezxml_parse_str_arena(char *s, size_t len);
+
 // returns the first child tag (one level deeper) with the given name or NULL
 // if not found
 ezxml_t ezxml_child(ezxml_t xml, const char *name);
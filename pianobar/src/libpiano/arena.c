@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* first chunk fits a four song playlist; doubled up to ARENA_CHUNK_MAX */
+#define ARENA_CHUNK_MIN 4096
+#define ARENA_CHUNK_MAX 65536
+#define ARENA_ALIGN (sizeof (((PianoArenaChunk_t *) NULL)->data[0]))
+
+/*	create arena, holds one reference for the creator (the parser)
+ *	@return arena or NULL
+ */
+PianoArena_t *PianoArenaNew (void) {
+	PianoArena_t *arena;
+
+	if ((arena = calloc (1, sizeof (*arena))) == NULL) {
+		return NULL;
+	}
+	arena->refs = 1;
+	return arena;
+}
+
+/*	get zeroed memory from arena
+ *	@param arena, plain calloc if NULL
+ *	@param bytes
+ *	@return memory or NULL
+ */
+void *PianoArenaAlloc (PianoArena_t *arena, size_t size) {
+	PianoArenaChunk_t *chunk;
+	void *ret;
+
+	if (arena == NULL) {
+		return calloc (1, size);
+	}
+
+	size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+	chunk = arena->chunks;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		size_t chunkSize = ARENA_CHUNK_MIN;
+
+		if (chunk != NULL) {
+			chunkSize = chunk->size * 2;
+			if (chunkSize > ARENA_CHUNK_MAX) {
+				chunkSize = ARENA_CHUNK_MAX;
+			}
+		}
+		if (chunkSize < size) {
+			chunkSize = size;
+		}
+		if ((chunk = malloc (sizeof (*chunk) + chunkSize)) == NULL) {
+			return NULL;
+		}
+		chunk->size = chunkSize;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	ret = (char *) chunk->data + chunk->used;
+	chunk->used += size;
+	memset (ret, 0, size);
+	return ret;
+}
+
+/*	allocate song/station/artist, which references the arena until it is
+ *	destroyed
+ *	@param arena, plain calloc if NULL
+ *	@param struct size
+ *	@return zeroed struct or NULL
+ */
+void *PianoArenaNewObject (PianoArena_t *arena, size_t size) {
+	void *ret;
+
+	if ((ret = PianoArenaAlloc (arena, size)) != NULL && arena != NULL) {
+		++arena->refs;
+	}
+	return ret;
+}
+
+/*	copy string into arena
+ *	@param arena, plain calloc if NULL
+ *	@param string
+ *	@return copy or NULL
+ */
+char *PianoArenaStrdup (PianoArena_t *arena, const char *s) {
+	const size_t len = strlen (s);
+	char *ret;
+
+	if ((ret = PianoArenaAlloc (arena, len + 1)) != NULL) {
+		memcpy (ret, s, len);
+	}
+	return ret;
+}
+
+/*	drop reference, frees all memory with the last one
+ *	@param arena
+ */
+void PianoArenaUnref (PianoArena_t *arena) {
+	PianoArenaChunk_t *chunk, *next;
+
+	if (arena == NULL || --arena->refs > 0) {
+		return;
+	}
+
+	for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		free (chunk);
+	}
+	free (arena);
+}
@@ -0,0 +1,55 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+typedef struct PianoArenaChunk {
+	struct PianoArenaChunk *next;
+	size_t size, used;
+	/* max_align_t is c11 */
+	union {
+		long double d;
+		void *p;
+		long long l;
+	} data[];
+} PianoArenaChunk_t;
+
+/* bump allocator owning all structs and strings of one parsed response;
+ * every song/station/artist allocated from it holds a reference, the
+ * memory is returned when the last one is destroyed. not thread-safe, but
+ * objects may be handed to another thread as a whole. */
+typedef struct PianoArena {
+	PianoArenaChunk_t *chunks;
+	size_t refs;
+} PianoArena_t;
+
+PianoArena_t *PianoArenaNew (void);
+void *PianoArenaAlloc (PianoArena_t *, size_t);
+void *PianoArenaNewObject (PianoArena_t *, size_t);
+char *PianoArenaStrdup (PianoArena_t *, const char *);
+void PianoArenaUnref (PianoArena_t *);
+
+#endif /* _ARENA_H */
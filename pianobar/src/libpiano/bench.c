@@ -0,0 +1,690 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* parser benchmark: time, number of allocations and peak rss per parsed
+ * response. responses are generated, but look like the ones pandora sends,
+ * for accounts from tiny to huge. needs gnu ld, allocations are counted with
+ * --wrap. every benchmark runs in its own process; peak rss is what that
+ * process grew by */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime(), strdup() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <ezxml.h>
+#include <waitress.h>
+
+#include "piano.h"
+#include "xml.h"
+#include "crypt.h"
+#include "trace.h"
+
+#define BENCH_BUFFER_SIZE (16*1024*1024)
+/* streaming parser is fed tcp segment sized pieces */
+#define BENCH_CHUNK_SIZE 1460
+
+static size_t benchAllocs = 0;
+/* peak rss when the benchmark process started, kB */
+static long benchRssStart = 0;
+static bool benchFailed = false;
+
+void *__real_malloc (size_t);
+void *__real_calloc (size_t, size_t);
+void *__real_realloc (void *, size_t);
+
+void *__wrap_malloc (size_t size) {
+	++benchAllocs;
+	return __real_malloc (size);
+}
+
+void *__wrap_calloc (size_t n, size_t size) {
+	++benchAllocs;
+	return __real_calloc (n, size);
+}
+
+void *__wrap_realloc (void *ptr, size_t size) {
+	++benchAllocs;
+	return __real_realloc (ptr, size);
+}
+
+char *__wrap_strdup (const char *s) {
+	const size_t len = strlen (s) + 1;
+	char *ret;
+
+	++benchAllocs;
+	if ((ret = __real_malloc (len)) != NULL) {
+		memcpy (ret, s, len);
+	}
+	return ret;
+}
+
+/*	append xml-rpc struct member
+ */
+static size_t BenchMember (char *buf, const char *name, const char *value) {
+	return sprintf (buf, "<member><name>%s</name><value>%s</value></member>",
+			name, value);
+}
+
+/*	playlist, as returned by getFragment
+ *	@param buffer
+ *	@param number of songs
+ */
+static void BenchGenPlaylist (char *buf, size_t songs) {
+	/* 48 hex chars, encrypted url tail */
+	const char *url = "http://audio-sv5-t1-1.pandora.com/access/"
+			"1234567890?version=4&lid=12345678&token="
+			"0123456789abcdef0123456789abcdef0123456789abcdef";
+	char tmp[64];
+	size_t i;
+
+	buf += sprintf (buf, "<?xml version=\"1.0\"?><methodResponse><params>"
+			"<param><value><array><data>");
+	for (i = 0; i < songs; i++) {
+		buf += sprintf (buf, "<value><struct>");
+		buf += BenchMember (buf, "audioURL", url);
+		buf += BenchMember (buf, "artRadio",
+				"http://images-sv2-t1.pandora.com/images/public/amz/2/9/1/2/"
+				"800012192_130W_130H.jpg");
+		buf += BenchMember (buf, "artistSummary", "Some Artist &amp; Band");
+		snprintf (tmp, sizeof (tmp), "S%zu", 1000000 + i);
+		buf += BenchMember (buf, "musicId", tmp);
+		buf += BenchMember (buf, "userSeed", "R123456");
+		buf += BenchMember (buf, "songTitle", "A Rather Long Song Title (Live)");
+		buf += BenchMember (buf, "rating", "<int>0</int>");
+		buf += BenchMember (buf, "stationId", "123456789012345678");
+		buf += BenchMember (buf, "albumTitle", "Greatest Hits Vol. 2");
+		buf += BenchMember (buf, "fileGain", "-1.23");
+		buf += BenchMember (buf, "audioEncoding", "aacplus");
+		buf += BenchMember (buf, "artistMusicId", "R98765");
+		buf += BenchMember (buf, "feedbackId", "-12345678901234567");
+		buf += BenchMember (buf, "songDetailURL",
+				"http://www.pandora.com/music/song/some+artist/a+song");
+		buf += BenchMember (buf, "trackToken", "S1234567");
+		buf += BenchMember (buf, "identity", "a1b2c3d4e5f6a7b8c9d0");
+		buf += BenchMember (buf, "songType", "<int>0</int>");
+		buf += BenchMember (buf, "artistArtUrl", "");
+		buf += sprintf (buf, "</struct></value>");
+	}
+	strcpy (buf, "</data></array></value></param></params></methodResponse>");
+}
+
+/*	station list, as returned by getStations; first one is quickmix
+ *	@param buffer
+ *	@param number of stations
+ */
+static void BenchGenStations (char *buf, size_t stations) {
+	char tmp[64];
+	size_t i;
+
+	buf += sprintf (buf, "<?xml version=\"1.0\"?><methodResponse><params>"
+			"<param><value><array><data>");
+	for (i = 0; i < stations; i++) {
+		buf += sprintf (buf, "<value><struct>");
+		snprintf (tmp, sizeof (tmp), "%zu", 100000000000 + i);
+		buf += BenchMember (buf, "stationId", tmp);
+		snprintf (tmp, sizeof (tmp), "Station number %zu Radio", i);
+		buf += BenchMember (buf, "stationName", tmp);
+		buf += BenchMember (buf, "isCreator",
+				"<boolean>1</boolean>");
+		buf += BenchMember (buf, "isQuickMix",
+				i == 0 ? "<boolean>1</boolean>" : "<boolean>0</boolean>");
+		if (i == 0) {
+			size_t j;
+			buf += sprintf (buf, "<member><name>quickMixStationIds</name>"
+					"<value><array><data>");
+			for (j = 1; j < stations; j += 2) {
+				buf += sprintf (buf, "<value>%zu</value>", 100000000000 + j);
+			}
+			buf += sprintf (buf, "</data></array></value></member>");
+		}
+		buf += sprintf (buf, "</struct></value>");
+	}
+	strcpy (buf, "</data></array></value></param></params></methodResponse>");
+}
+
+/*	search result, as returned by musicSearch
+ *	@param buffer
+ *	@param number of artists and songs (each)
+ */
+static void BenchGenSearch (char *buf, size_t results) {
+	char tmp[64];
+	size_t i;
+
+	buf += sprintf (buf, "<?xml version=\"1.0\"?><methodResponse><params>"
+			"<param><value><struct><member><name>artists</name><value><array>"
+			"<data>");
+	for (i = 0; i < results; i++) {
+		buf += sprintf (buf, "<value><struct>");
+		snprintf (tmp, sizeof (tmp), "Artist %zu", i);
+		buf += BenchMember (buf, "artistName", tmp);
+		snprintf (tmp, sizeof (tmp), "R%zu", 2000000 + i);
+		buf += BenchMember (buf, "musicId", tmp);
+		buf += BenchMember (buf, "score", "<int>90</int>");
+		buf += sprintf (buf, "</struct></value>");
+	}
+	buf += sprintf (buf, "</data></array></value></member><member><name>songs"
+			"</name><value><array><data>");
+	for (i = 0; i < results; i++) {
+		buf += sprintf (buf, "<value><struct>");
+		snprintf (tmp, sizeof (tmp), "Song %zu", i);
+		buf += BenchMember (buf, "songTitle", tmp);
+		buf += BenchMember (buf, "artistSummary", "Some Artist");
+		snprintf (tmp, sizeof (tmp), "S%zu", 3000000 + i);
+		buf += BenchMember (buf, "musicId", tmp);
+		buf += sprintf (buf, "</struct></value>");
+	}
+	strcpy (buf, "</data></array></value></member></struct></value></param>"
+			"</params></methodResponse>");
+}
+
+/*	station info, as returned by getStation; song, artist and genre seeds
+ *	plus feedback
+ *	@param buffer
+ *	@param number of seeds (each type) and feedback entries
+ */
+static void BenchGenStationInfo (char *buf, size_t entries) {
+	char tmp[64];
+	size_t i;
+
+	buf += sprintf (buf, "<?xml version=\"1.0\"?><methodResponse><params>"
+			"<param><value><struct><member><name>seeds</name><value><array>"
+			"<data>");
+	for (i = 0; i < entries * 3; i++) {
+		buf += sprintf (buf, "<value><struct>");
+		snprintf (tmp, sizeof (tmp), "%zu", 4000000 + i);
+		buf += BenchMember (buf, "seedId", tmp);
+		switch (i % 3) {
+			case 0:
+				buf += sprintf (buf, "<member><name>song</name><value><struct>");
+				buf += BenchMember (buf, "songTitle", "Seed Song");
+				buf += BenchMember (buf, "artistSummary", "Seed Artist");
+				buf += BenchMember (buf, "musicId", "S123");
+				break;
+
+			case 1:
+				buf += sprintf (buf, "<member><name>artist</name><value><struct>");
+				buf += BenchMember (buf, "artistName", "Seed Artist");
+				buf += BenchMember (buf, "musicId", "R123");
+				break;
+
+			case 2:
+				buf += sprintf (buf, "<member><name>nonGenomeStation</name>"
+						"<value><struct>");
+				buf += BenchMember (buf, "stationName", "Genre Station");
+				buf += BenchMember (buf, "stationId", "G123");
+				break;
+		}
+		buf += sprintf (buf, "</struct></value></member></struct></value>");
+	}
+	buf += sprintf (buf, "</data></array></value></member><member><name>"
+			"feedback</name><value><array><data>");
+	for (i = 0; i < entries; i++) {
+		buf += sprintf (buf, "<value><struct>");
+		snprintf (tmp, sizeof (tmp), "%zu", 5000000 + i);
+		buf += BenchMember (buf, "feedbackId", tmp);
+		buf += BenchMember (buf, "songTitle", "Rated Song");
+		buf += BenchMember (buf, "artistSummary", "Some Artist");
+		buf += BenchMember (buf, "musicId", "S456");
+		buf += BenchMember (buf, "isPositive", "<boolean>1</boolean>");
+		buf += sprintf (buf, "</struct></value>");
+	}
+	strcpy (buf, "</data></array></value></member></struct></value></param>"
+			"</params></methodResponse>");
+}
+
+/*	genre station tree, as returned by the genre explorer
+ *	@param buffer
+ *	@param number of categories
+ *	@param number of genres per category
+ */
+static void BenchGenGenres (char *buf, size_t categories, size_t genres) {
+	size_t i, j;
+
+	buf += sprintf (buf, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+			"<categories>");
+	for (i = 0; i < categories; i++) {
+		buf += sprintf (buf, "<category categoryName=\"Category %zu\">", i);
+		for (j = 0; j < genres; j++) {
+			buf += sprintf (buf, "<genre name=\"Genre %zu/%zu Radio\" "
+					"musicId=\"G%zu\"/>", i, j, 6000000 + i * genres + j);
+		}
+		buf += sprintf (buf, "</category>");
+	}
+	strcpy (buf, "</categories>");
+}
+
+typedef enum {
+	BENCH_PLAYLIST, BENCH_STATIONS, BENCH_SEARCH, BENCH_STATIONINFO,
+	BENCH_GENRES, BENCH_PLAYLIST_STREAM, BENCH_STATIONS_STREAM, BENCH_EZXML,
+	BENCH_EZXML_ARENA, BENCH_ENCRYPT, BENCH_DECRYPT
+} BenchType_t;
+
+static long BenchMaxRss (void) {
+	struct rusage usage;
+
+	getrusage (RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/*	start benchmark in its own process, so its peak rss is not hidden by
+ *	the ones before
+ *	@return true in the parent, after the benchmark finished; false in the
+ *		child, which runs the benchmark and ends with BenchReport
+ */
+static bool BenchFork (void) {
+	pid_t pid;
+	int status;
+
+	fflush (stdout);
+	if ((pid = fork ()) == 0) {
+		benchRssStart = BenchMaxRss ();
+		return false;
+	}
+	if (pid == -1 || waitpid (pid, &status, 0) == -1 ||
+			!WIFEXITED (status) || WEXITSTATUS (status) != EXIT_SUCCESS) {
+		benchFailed = true;
+	}
+	return true;
+}
+
+/*	print results and end benchmark process
+ *	@param name
+ *	@param input or output size
+ *	@param start time
+ *	@param end time
+ *	@param allocations
+ *	@param iterations
+ */
+static void BenchReport (const char *name, size_t bytes,
+		const struct timespec *start, const struct timespec *end,
+		size_t allocs, size_t iterations) {
+	const double ns = (end->tv_sec - start->tv_sec) * 1e9 +
+			(end->tv_nsec - start->tv_nsec);
+
+	printf ("%-28s %8zu bytes %12.0f ns/op %8.1f allocs/op %8ld kB peak\n",
+			name, bytes, ns / iterations, (double) allocs / iterations,
+			BenchMaxRss () - benchRssStart);
+	exit (EXIT_SUCCESS);
+}
+
+/*	feed response to incremental parser in BENCH_CHUNK_SIZE pieces
+ *	@param parser
+ *	@param response
+ *	@param response length
+ */
+static void BenchFeed (PianoXmlStream_t *s, const char *xml, size_t len) {
+	size_t pos;
+
+	for (pos = 0; pos < len; pos += BENCH_CHUNK_SIZE) {
+		PianoXmlStreamFeed (s, &xml[pos], len - pos < BENCH_CHUNK_SIZE ?
+				len - pos : BENCH_CHUNK_SIZE);
+	}
+}
+
+/*	parse response over and over again and print results; parsed objects
+ *	are destroyed within the measured loop
+ *	@param name
+ *	@param type
+ *	@param response
+ *	@param iterations
+ */
+static void BenchRun (const char *name, BenchType_t type, const char *xml,
+		size_t iterations) {
+	const size_t len = strlen (xml) + 1;
+	char *work;
+	struct timespec start, end;
+	size_t allocs, i;
+
+	if (BenchFork ()) {
+		return;
+	}
+
+	work = __real_malloc (len);
+	allocs = benchAllocs;
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++) {
+		/* ezxml parses in place */
+		memcpy (work, xml, len);
+
+		switch (type) {
+			case BENCH_PLAYLIST: {
+				PianoSong_t *playlist = NULL;
+				PianoXmlParsePlaylist (NULL, work, &playlist);
+				PianoDestroyPlaylist (playlist);
+				break;
+			}
+
+			case BENCH_STATIONS: {
+				PianoHandle_t ph;
+				PianoInit (&ph);
+				PianoXmlParseStations (&ph, work);
+				PianoDestroy (&ph);
+				break;
+			}
+
+			case BENCH_SEARCH: {
+				PianoSearchResult_t searchResult;
+				PianoXmlParseSearch (work, &searchResult);
+				PianoDestroySearchResult (&searchResult);
+				break;
+			}
+
+			case BENCH_STATIONINFO: {
+				PianoStationInfo_t info;
+				memset (&info, 0, sizeof (info));
+				PianoXmlParseGetStationInfo (work, &info);
+				PianoDestroyStationInfo (&info);
+				break;
+			}
+
+			case BENCH_GENRES: {
+				PianoHandle_t ph;
+				PianoInit (&ph);
+				PianoXmlParseGenreExplorer (&ph, work);
+				PianoDestroy (&ph);
+				break;
+			}
+
+			case BENCH_PLAYLIST_STREAM: {
+				PianoSong_t *playlist = NULL;
+				PianoXmlStream_t *s = PianoXmlStreamNew (
+						PIANO_REQUEST_GET_PLAYLIST);
+				BenchFeed (s, work, len - 1);
+				PianoXmlStreamFinishPlaylist (s, &playlist);
+				PianoXmlStreamFree (s);
+				PianoDestroyPlaylist (playlist);
+				break;
+			}
+
+			case BENCH_STATIONS_STREAM: {
+				PianoHandle_t ph;
+				PianoXmlStream_t *s = PianoXmlStreamNew (
+						PIANO_REQUEST_GET_STATIONS);
+				PianoInit (&ph);
+				BenchFeed (s, work, len - 1);
+				PianoXmlStreamFinishStations (&ph, s);
+				PianoXmlStreamFree (s);
+				PianoDestroy (&ph);
+				break;
+			}
+
+			/* dom only, no piano structs */
+			case BENCH_EZXML:
+				ezxml_free (ezxml_parse_str (work, len - 1));
+				break;
+
+			case BENCH_EZXML_ARENA:
+				ezxml_free (ezxml_parse_str_arena (work, len - 1));
+				break;
+
+			/* request bodies and audio url tails */
+			case BENCH_ENCRYPT:
+				free (PianoEncryptString (work));
+				break;
+
+			case BENCH_DECRYPT:
+				free (PianoDecryptString (work));
+				break;
+		}
+	}
+	clock_gettime (CLOCK_MONOTONIC, &end);
+	allocs = benchAllocs - allocs;
+
+	BenchReport (name, len - 1, &start, &end, allocs, iterations);
+}
+
+/*	build request over and over again; stations are the parsed result of
+ *	BenchGenStations, every other one is part of the quickmix
+ *	@param name
+ *	@param request type
+ *	@param number of stations
+ *	@param iterations
+ */
+static void BenchRequest (const char *name, PianoRequestType_t type,
+		size_t stations, size_t iterations) {
+	char *xml;
+	PianoHandle_t ph;
+	PianoStation_t *station;
+	struct timespec start, end;
+	size_t allocs, len = 0, i;
+
+	if (BenchFork ()) {
+		return;
+	}
+
+	xml = __real_malloc (BENCH_BUFFER_SIZE);
+	PianoInit (&ph);
+	BenchGenStations (xml, stations);
+	PianoXmlParseStations (&ph, xml);
+	for (station = ph.stations, i = 0; station != NULL;
+			station = station->next, i++) {
+		station->useQuickMix = i % 2;
+	}
+	ph.user.listenerId = strdup ("12345678");
+	ph.user.authToken = strdup ("0123456789abcdef0123456789abcdef");
+
+	allocs = benchAllocs;
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++) {
+		PianoRequest_t req;
+
+		memset (&req, 0, sizeof (req));
+		PianoRequest (&ph, &req, type);
+		len = strlen (req.postData);
+		PianoDestroyRequest (&req);
+	}
+	clock_gettime (CLOCK_MONOTONIC, &end);
+	allocs = benchAllocs - allocs;
+
+	BenchReport (name, len, &start, &end, allocs, iterations);
+}
+
+/*	pass response to incremental parser, like pianobar's
+ *	BarPianoHttpResponseCb
+ */
+static WaitressCbReturn_t BenchReplayCb (void *data, size_t size,
+		void *extraData) {
+	PianoResponseFeed (extraData, data, size);
+	return WAITRESS_CB_RET_OK;
+}
+
+/*	piano call like pianobar's BarUiPianoCall, without reauthentication
+ *	@param piano handle
+ *	@param waitress handle
+ *	@param request type
+ *	@param request data
+ *	@return piano return value
+ */
+static PianoReturn_t BenchReplayCall (PianoHandle_t *ph,
+		WaitressHandle_t *waith, PianoRequestType_t type, void *data) {
+	PianoRequest_t req;
+	PianoReturn_t pRet;
+	WaitressReturn_t wRet;
+
+	memset (&req, 0, sizeof (req));
+	do {
+		req.data = data;
+		if ((pRet = PianoRequest (ph, &req, type)) == PIANO_RET_OK) {
+			waith->postData = req.postData;
+			waith->url.path = req.urlPath;
+			if (req.responseStream != NULL) {
+				waith->data = &req;
+				waith->callback = BenchReplayCb;
+				wRet = WaitressFetchCall (waith);
+			} else {
+				wRet = WaitressFetchBuf (waith, &req.responseData);
+			}
+			pRet = wRet == WAITRESS_RET_OK ? PianoResponse (ph, &req) :
+					PIANO_RET_ERR;
+		}
+		free (req.responseData);
+		PianoDestroyRequest (&req);
+	} while (pRet == PIANO_RET_CONTINUE_REQUEST);
+
+	return pRet;
+}
+
+/*	replay recorded session: login, get stations and a playlist, offline;
+ *	fails if the trace does not replay
+ *	@param name
+ *	@param trace file
+ *	@param iterations
+ */
+static void BenchReplay (const char *name, const char *path,
+		size_t iterations) {
+	struct timespec start, end;
+	size_t allocs, len = 0, i;
+	bool ok = true;
+
+	if (BenchFork ()) {
+		return;
+	}
+
+	allocs = benchAllocs;
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations && ok; i++) {
+		PianoHandle_t ph;
+		WaitressHandle_t waith;
+		PianoTrace_t *trace;
+		PianoRequestDataLogin_t login;
+		PianoRequestDataGetPlaylist_t playlist;
+
+		if ((trace = PianoTraceOpen (path, PIANO_TRACE_REPLAY)) == NULL) {
+			ok = false;
+			break;
+		}
+		PianoInit (&ph);
+		ph.trace = trace;
+		WaitressInit (&waith);
+		PianoTraceAttach (trace, &waith);
+
+		login.user = "user@example.com";
+		login.password = "secret";
+		login.step = 0;
+		memset (&playlist, 0, sizeof (playlist));
+		playlist.format = PIANO_AF_AACPLUS;
+
+		ok = BenchReplayCall (&ph, &waith, PIANO_REQUEST_LOGIN, &login) ==
+				PIANO_RET_OK &&
+				BenchReplayCall (&ph, &waith, PIANO_REQUEST_GET_STATIONS,
+				NULL) == PIANO_RET_OK &&
+				(playlist.station = ph.stations) != NULL &&
+				BenchReplayCall (&ph, &waith, PIANO_REQUEST_GET_PLAYLIST,
+				&playlist) == PIANO_RET_OK &&
+				playlist.retPlaylist != NULL;
+		len = ftell (trace->fp);
+
+		PianoDestroyPlaylist (playlist.retPlaylist);
+		WaitressFree (&waith);
+		PianoDestroy (&ph);
+		PianoTraceClose (trace);
+	}
+	clock_gettime (CLOCK_MONOTONIC, &end);
+	allocs = benchAllocs - allocs;
+
+	if (!ok) {
+		printf ("%-28s failed\n", name);
+		exit (EXIT_FAILURE);
+	}
+	BenchReport (name, len, &start, &end, allocs, iterations);
+}
+
+int main () {
+	char *buf = __real_malloc (BENCH_BUFFER_SIZE);
+
+	BenchGenPlaylist (buf, 4);
+	BenchRun ("playlist/4", BENCH_PLAYLIST, buf, 20000);
+	BenchRun ("playlist/4/stream", BENCH_PLAYLIST_STREAM, buf, 20000);
+	BenchGenPlaylist (buf, 100);
+	BenchRun ("playlist/100", BENCH_PLAYLIST, buf, 1000);
+	BenchRun ("playlist/100/stream", BENCH_PLAYLIST_STREAM, buf, 1000);
+	BenchGenStations (buf, 10);
+	BenchRun ("stations/10", BENCH_STATIONS, buf, 10000);
+	BenchRun ("stations/10/stream", BENCH_STATIONS_STREAM, buf, 10000);
+	BenchGenStations (buf, 100);
+	BenchRun ("stations/100", BENCH_STATIONS, buf, 1000);
+	BenchRun ("stations/100/stream", BENCH_STATIONS_STREAM, buf, 1000);
+	BenchGenStations (buf, 1000);
+	BenchRun ("stations/1000", BENCH_STATIONS, buf, 100);
+	BenchRun ("stations/1000/stream", BENCH_STATIONS_STREAM, buf, 100);
+	BenchGenStations (buf, 10000);
+	BenchRun ("stations/10000", BENCH_STATIONS, buf, 10);
+	BenchRun ("stations/10000/stream", BENCH_STATIONS_STREAM, buf, 10);
+	BenchGenSearch (buf, 50);
+	BenchRun ("search/50", BENCH_SEARCH, buf, 1000);
+	BenchGenStationInfo (buf, 100);
+	BenchRun ("stationinfo/100", BENCH_STATIONINFO, buf, 200);
+	BenchGenStationInfo (buf, 2000);
+	BenchRun ("stationinfo/2000", BENCH_STATIONINFO, buf, 10);
+	BenchGenGenres (buf, 20, 20);
+	BenchRun ("genres/20x20", BENCH_GENRES, buf, 1000);
+	BenchGenGenres (buf, 100, 200);
+	BenchRun ("genres/100x200", BENCH_GENRES, buf, 10);
+
+	BenchGenPlaylist (buf, 100);
+	BenchRun ("ezxml/playlist/100", BENCH_EZXML, buf, 1000);
+	BenchRun ("ezxml-arena/playlist/100", BENCH_EZXML_ARENA, buf, 1000);
+	BenchGenStations (buf, 1000);
+	BenchRun ("ezxml/stations/1000", BENCH_EZXML, buf, 100);
+	BenchRun ("ezxml-arena/stations/1000", BENCH_EZXML_ARENA, buf, 100);
+	BenchGenSearch (buf, 50);
+	BenchRun ("ezxml/search/50", BENCH_EZXML, buf, 1000);
+	BenchRun ("ezxml-arena/search/50", BENCH_EZXML_ARENA, buf, 1000);
+	BenchGenStationInfo (buf, 100);
+	BenchRun ("ezxml/stationinfo/100", BENCH_EZXML, buf, 200);
+	BenchRun ("ezxml-arena/stationinfo/100", BENCH_EZXML_ARENA, buf, 200);
+
+	BenchGenStations (buf, 10);
+	BenchRun ("encrypt/stations/10", BENCH_ENCRYPT, buf, 1000);
+	{
+		char *hex = PianoEncryptString (buf);
+		BenchRun ("decrypt/stations/10", BENCH_DECRYPT, hex, 1000);
+		free (hex);
+	}
+	BenchGenStations (buf, 1000);
+	BenchRun ("encrypt/stations/1000", BENCH_ENCRYPT, buf, 20);
+	{
+		char *hex = PianoEncryptString (buf);
+		BenchRun ("decrypt/stations/1000", BENCH_DECRYPT, hex, 20);
+		free (hex);
+	}
+	BenchRun ("decrypt/audiourl", BENCH_DECRYPT,
+			"0123456789abcdef0123456789abcdef0123456789abcdef", 100000);
+
+	BenchRequest ("request/quickmix/100", PIANO_REQUEST_SET_QUICKMIX, 100,
+			10000);
+
+	/* run from the source tree, see make bench */
+	BenchReplay ("replay/session", "contrib/trace/session.trace", 1000);
+
+	free (buf);
+	return benchFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
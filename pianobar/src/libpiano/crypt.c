@@ -22,176 +22,291 @@ THE SOFTWARE.
 */
 
 #include <string.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <arpa/inet.h>
 
 #include "crypt_key_output.h"
 #include "crypt_key_input.h"
-#include "piano_private.h"
+#include "crypt.h"
 
-#define byteswap32(x) ((((x) >> 24) & 0x000000ff) | \
-		(((x) >> 8) & 0x0000ff00) | \
-		(((x) << 8) & 0x00ff0000) | \
-		(((x) << 24) & 0xff000000))
+/* independent blocks en/decrypted in lock-step; s-box lookups of one block
+ * depend on the previous round, so the cpu would stall on every load when
+ * processing just one */
+#define PIANO_CRYPT_LANES 4
 
-#define hostToBigEndian32(x) htonl(x)
-#define bigToHostEndian32(x) ntohl(x)
+/* blowfish round function */
+#define PIANO_CRYPT_F(s, x) ((((s)[0][(x) >> 24] + \
+		(s)[1][((x) >> 16) & 0xff]) ^ (s)[2][((x) >> 8) & 0xff]) + \
+		(s)[3][(x) & 0xff])
 
-/*	decrypt hex-encoded, blowfish-crypted string: decode 2 hex-encoded blocks,
- *	decrypt, byteswap
- *	@param hex string
- *	@return decrypted string or NULL
+/* byte => two lowercase hex digits */
+static const char hexEncode[] =
+		"000102030405060708090a0b0c0d0e0f"
+		"101112131415161718191a1b1c1d1e1f"
+		"202122232425262728292a2b2c2d2e2f"
+		"303132333435363738393a3b3c3d3e3f"
+		"404142434445464748494a4b4c4d4e4f"
+		"505152535455565758595a5b5c5d5e5f"
+		"606162636465666768696a6b6c6d6e6f"
+		"707172737475767778797a7b7c7d7e7f"
+		"808182838485868788898a8b8c8d8e8f"
+		"909192939495969798999a9b9c9d9e9f"
+		"a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+		"b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+		"c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+		"d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+		"e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+		"f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+/* hex digit => nibble; everything else is decoded as zero */
+static const unsigned char hexDecode[256] = {
+	['0'] = 0x0, ['1'] = 0x1, ['2'] = 0x2, ['3'] = 0x3, ['4'] = 0x4,
+	['5'] = 0x5, ['6'] = 0x6, ['7'] = 0x7, ['8'] = 0x8, ['9'] = 0x9,
+	['a'] = 0xa, ['b'] = 0xb, ['c'] = 0xc, ['d'] = 0xd, ['e'] = 0xe,
+	['f'] = 0xf,
+};
+
+/*	read big endian 32 bit integer
  */
-#define INITIAL_SHIFT 28
-#define SHIFT_DEC 4
-unsigned char *PianoDecryptString (const unsigned char *strInput) {
-	/* hex-decode => strlen/2 + null-byte */
-	uint32_t *iDecrypt;
-	unsigned char *strDecrypted;
-	unsigned char shift = INITIAL_SHIFT, intsDecoded = 0, j;
-	/* blowfish blocks, 32-bit */
-	uint32_t f, l, r, lrExchange;
-
-	if ((iDecrypt = calloc (strlen ((char *) strInput)/2/sizeof (*iDecrypt)+1,
-			sizeof (*iDecrypt))) == NULL) {
-		return NULL;
+static inline uint32_t PianoCryptLoad (const unsigned char *p) {
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+			((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+/*	write 32 bit integer, big endian
+ */
+static inline void PianoCryptStore (unsigned char *p, uint32_t x) {
+	p[0] = x >> 24;
+	p[1] = x >> 16;
+	p[2] = x >> 8;
+	p[3] = x;
+}
+
+/*	write 32 bit integer as 8 hex digits, big endian
+ */
+static inline void PianoCryptHexStore (char *hex, uint32_t x) {
+	memcpy (hex, &hexEncode[2 * (x >> 24)], 2);
+	memcpy (hex+2, &hexEncode[2 * ((x >> 16) & 0xff)], 2);
+	memcpy (hex+4, &hexEncode[2 * ((x >> 8) & 0xff)], 2);
+	memcpy (hex+6, &hexEncode[2 * (x & 0xff)], 2);
+}
+
+/* one blowfish round for block n, half x is xor'ed with p-array entry p */
+#define PIANO_CRYPT_ROUND(s, p, n) { \
+		const uint32_t x = l##n ^ (p); \
+		l##n = r##n ^ PIANO_CRYPT_F (s, x); \
+		r##n = x; \
 	}
-	strDecrypted = (unsigned char *) iDecrypt;
-
-	while (*strInput != '\0') {
-		/* hex-decode string */
-		if (*strInput >= '0' && *strInput <= '9') {
-			*iDecrypt |= (*strInput & 0x0f) << shift;
-		} else if (*strInput >= 'a' && *strInput <= 'f') {
-			/* 0xa (hex) = 10 (decimal), 'a' & 0x0f == 1 => +9 */
-			*iDecrypt |= ((*strInput+9) & 0x0f) << shift;
+
+/*	blowfish-encrypt PIANO_CRYPT_LANES blocks; rounds of all blocks are
+ *	spelled out, so halves stay in registers
+ *	@param left halves
+ *	@param right halves
+ */
+static void PianoEncryptLanes (uint32_t *l, uint32_t *r) {
+	uint32_t l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
+	uint32_t r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3];
+	size_t i;
+
+	for (i = 0; i < out_key_n; i++) {
+		const uint32_t p = out_key_p[i];
+		PIANO_CRYPT_ROUND (out_key_s, p, 0);
+		PIANO_CRYPT_ROUND (out_key_s, p, 1);
+		PIANO_CRYPT_ROUND (out_key_s, p, 2);
+		PIANO_CRYPT_ROUND (out_key_s, p, 3);
+	}
+	/* undo last exchange of l & r */
+	l[0] = r0 ^ out_key_p[out_key_n+1];
+	l[1] = r1 ^ out_key_p[out_key_n+1];
+	l[2] = r2 ^ out_key_p[out_key_n+1];
+	l[3] = r3 ^ out_key_p[out_key_n+1];
+	r[0] = l0 ^ out_key_p[out_key_n];
+	r[1] = l1 ^ out_key_p[out_key_n];
+	r[2] = l2 ^ out_key_p[out_key_n];
+	r[3] = l3 ^ out_key_p[out_key_n];
+}
+
+/*	blowfish-decrypt PIANO_CRYPT_LANES blocks
+ *	@param key: number of rounds, p-array and s-boxes
+ *	@param left halves
+ *	@param right halves
+ */
+static inline void PianoDecryptLanes (const unsigned int key_n,
+		const uint32_t *key_p, const uint32_t (*key_s)[256], uint32_t *l,
+		uint32_t *r) {
+	uint32_t l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
+	uint32_t r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3];
+	size_t i;
+
+	for (i = key_n + 1; i > 1; --i) {
+		const uint32_t p = key_p[i];
+		PIANO_CRYPT_ROUND (key_s, p, 0);
+		PIANO_CRYPT_ROUND (key_s, p, 1);
+		PIANO_CRYPT_ROUND (key_s, p, 2);
+		PIANO_CRYPT_ROUND (key_s, p, 3);
+	}
+	/* undo last exchange of l & r */
+	l[0] = r0 ^ key_p[0];
+	l[1] = r1 ^ key_p[0];
+	l[2] = r2 ^ key_p[0];
+	l[3] = r3 ^ key_p[0];
+	r[0] = l0 ^ key_p[1];
+	r[1] = l1 ^ key_p[1];
+	r[2] = l2 ^ key_p[1];
+	r[3] = l3 ^ key_p[1];
+}
+
+/*	blowfish-encrypt/hex-encode complete blocks, no padding
+ *	@param input, number of blocks * PIANO_CRYPT_BLOCK bytes
+ *	@param number of blocks
+ *	@param output buffer, number of blocks * PIANO_CRYPT_BLOCK * 2 bytes;
+ *		not null-terminated
+ */
+void PianoEncryptBlocks (const char *in, size_t blockN, char *out) {
+	const unsigned char *src = (const unsigned char *) in;
+	size_t block, k;
+	char *hex = out;
+
+	for (block = 0; block < blockN; block += PIANO_CRYPT_LANES) {
+		const size_t lanes = blockN - block < PIANO_CRYPT_LANES ?
+				blockN - block : PIANO_CRYPT_LANES;
+		const unsigned char *pos = &src[block * PIANO_CRYPT_BLOCK];
+		unsigned char tail[PIANO_CRYPT_LANES * PIANO_CRYPT_BLOCK];
+		uint32_t l[PIANO_CRYPT_LANES], r[PIANO_CRYPT_LANES];
+
+		if (lanes < PIANO_CRYPT_LANES) {
+			/* fill unused lanes with zeros */
+			memset (tail, 0, sizeof (tail));
+			memcpy (tail, pos, lanes * PIANO_CRYPT_BLOCK);
+			pos = tail;
 		}
-		if (shift > 0) {
-			shift -= SHIFT_DEC;
-		} else {
-			shift = INITIAL_SHIFT;
-			/* initialize next dword */
-			*(++iDecrypt) = 0;
-			++intsDecoded;
+		for (k = 0; k < PIANO_CRYPT_LANES; k++) {
+			l[k] = PianoCryptLoad (&pos[k*PIANO_CRYPT_BLOCK]);
+			r[k] = PianoCryptLoad (&pos[k*PIANO_CRYPT_BLOCK + 4]);
 		}
 
-		/* two 32-bit hex-decoded boxes available => blowfish decrypt */
-		if (intsDecoded == 2) {
-			l = *(iDecrypt-2);
-			r = *(iDecrypt-1);
-
-			for (j = in_key_n + 1; j > 1; --j) {
-				l ^= in_key_p [j];
-				
-				f = in_key_s [0][(l >> 24) & 0xff] +
-						in_key_s [1][(l >> 16) & 0xff];
-				f ^= in_key_s [2][(l >> 8) & 0xff];
-				f += in_key_s [3][l & 0xff];
-				r ^= f;
-				/* exchange l & r */
-				lrExchange = l;
-				l = r;
-				r = lrExchange;
-			}
-			/* exchange l & r */
-			lrExchange = l;
-			l = r;
-			r = lrExchange;
-			r ^= in_key_p [1];
-			l ^= in_key_p [0];
-
-			*(iDecrypt-2) = bigToHostEndian32 (l);
-			*(iDecrypt-1) = bigToHostEndian32 (r);
-
-			intsDecoded = 0;
+		PianoEncryptLanes (l, r);
+
+		for (k = 0; k < lanes; k++) {
+			PianoCryptHexStore (hex, l[k]);
+			PianoCryptHexStore (hex+8, r[k]);
+			hex += PIANO_CRYPT_BLOCK * 2;
 		}
-		++strInput;
 	}
+}
 
-	return strDecrypted;
+/*	blowfish-encrypt/hex-encode buffer; input is zero-padded to the next
+ *	block, a full block of zeros is added if it is a multiple of the block
+ *	size already
+ *	@param input
+ *	@param input length
+ *	@param output buffer, PIANO_ENCRYPT_SIZE (input length) bytes
+ *	@return number of hex digits written, excluding terminating null byte
+ */
+size_t PianoEncryptBuffer (const char *in, size_t inN, char *out) {
+	const size_t blockN = inN / PIANO_CRYPT_BLOCK;
+	char last[PIANO_CRYPT_BLOCK];
+
+	memset (last, 0, sizeof (last));
+	memcpy (last, &in[blockN * PIANO_CRYPT_BLOCK], inN % PIANO_CRYPT_BLOCK);
+
+	PianoEncryptBlocks (in, blockN, out);
+	PianoEncryptBlocks (last, 1, &out[blockN * PIANO_CRYPT_BLOCK * 2]);
+	out[(blockN + 1) * PIANO_CRYPT_BLOCK * 2] = '\0';
+
+	return (blockN + 1) * PIANO_CRYPT_BLOCK * 2;
 }
-#undef INITIAL_SHIFT
-#undef SHIFT_DEC
 
-/*	blowfish-encrypt/hex-encode string
- *	@param encrypt this
- *	@return encrypted, hex-encoded string
+/*	hex-decode/blowfish-decrypt buffer, see PianoDecryptBuffer
+ *	@param key: number of rounds, p-array and s-boxes
  */
-unsigned char *PianoEncryptString (const unsigned char *strInput) {
-	const size_t strInputN = strlen ((char *) strInput);
-	/* num of 64-bit blocks, rounded to next block */
-	size_t blockN = strInputN / 8 + 1;
-	uint32_t *blockInput, *blockPtr;
-	/* output string */
-	unsigned char *strHex, *hexPtr;
-	const char *hexmap = "0123456789abcdef";
-
-	if ((blockInput = calloc (blockN*2, sizeof (*blockInput))) == NULL) {
-		return NULL;
-	}
-	blockPtr = blockInput;
+static inline size_t PianoDecryptWithKey (const unsigned int key_n,
+		const uint32_t *key_p, const uint32_t (*key_s)[256], const char *in,
+		size_t inN, char *out) {
+	const unsigned char *src = (const unsigned char *) in;
+	unsigned char *dest = (unsigned char *) out;
+	const size_t blockN = inN / (PIANO_CRYPT_BLOCK * 2);
+	size_t block, k;
 
-	if ((strHex = calloc (blockN*8*2 + 1, sizeof (*strHex))) == NULL) {
-		return NULL;
-	}
-	hexPtr = strHex;
-
-	memcpy (blockInput, strInput, strInputN);
-
-	while (blockN > 0) {
-		/* encryption blocks */
-		uint32_t f, lrExchange;
-		register uint32_t l, r;
-		int i;
-
-		l = hostToBigEndian32 (*blockPtr);
-		r = hostToBigEndian32 (*(blockPtr+1));
-		
-		/* encrypt blocks */
-		for (i = 0; i < out_key_n; i++) {
-			l ^= out_key_p[i];
-
-			f = out_key_s[0][(l >> 24) & 0xff] +
-					out_key_s[1][(l >> 16) & 0xff];
-			f ^= out_key_s[2][(l >> 8) & 0xff];
-			f += out_key_s[3][l & 0xff];
-			r ^= f;
-			/* exchange l & r */
-			lrExchange = l;
-			l = r;
-			r = lrExchange;
+	for (block = 0; block < blockN; block += PIANO_CRYPT_LANES) {
+		const size_t lanes = blockN - block < PIANO_CRYPT_LANES ?
+				blockN - block : PIANO_CRYPT_LANES;
+		const unsigned char *hex = &src[block * PIANO_CRYPT_BLOCK * 2];
+		unsigned char bytes[PIANO_CRYPT_LANES * PIANO_CRYPT_BLOCK];
+		uint32_t l[PIANO_CRYPT_LANES], r[PIANO_CRYPT_LANES];
+		size_t i;
+
+		if (lanes < PIANO_CRYPT_LANES) {
+			memset (bytes, 0, sizeof (bytes));
 		}
-		/* exchange l & r again */
-		lrExchange = l;
-		l = r;
-		r = lrExchange;
-		r ^= out_key_p [out_key_n];
-		l ^= out_key_p [out_key_n+1];
-
-		/* swap bytes again... */
-		l = byteswap32 (l);
-		r = byteswap32 (r);
-
-		/* hex-encode encrypted blocks */
-		for (i = 0; i < 4; i++) {
-			*hexPtr++ = hexmap[(l & 0xf0) >> 4];
-			*hexPtr++ = hexmap[l & 0x0f];
-			l >>= 8;
+		for (i = 0; i < lanes * PIANO_CRYPT_BLOCK; i++) {
+			bytes[i] = (hexDecode[hex[2*i]] << 4) | hexDecode[hex[2*i+1]];
 		}
-		for (i = 0; i < 4; i++) {
-			*hexPtr++ = hexmap[(r & 0xf0) >> 4];
-			*hexPtr++ = hexmap[r & 0x0f];
-			r >>= 8;
+		for (k = 0; k < PIANO_CRYPT_LANES; k++) {
+			l[k] = PianoCryptLoad (&bytes[k*PIANO_CRYPT_BLOCK]);
+			r[k] = PianoCryptLoad (&bytes[k*PIANO_CRYPT_BLOCK + 4]);
 		}
 
-		/* two! 32-bit blocks encrypted (l & r) */
-		blockPtr += 2;
-		--blockN;
+		PianoDecryptLanes (key_n, key_p, key_s, l, r);
+
+		for (k = 0; k < lanes; k++) {
+			PianoCryptStore (dest, l[k]);
+			PianoCryptStore (dest+4, r[k]);
+			dest += PIANO_CRYPT_BLOCK;
+		}
+	}
+	*dest = '\0';
+
+	return dest - (unsigned char *) out;
+}
+
+/*	hex-decode/blowfish-decrypt buffer; an incomplete block at the end is
+ *	ignored
+ *	@param hex-encoded input
+ *	@param input length
+ *	@param output buffer, PIANO_DECRYPT_SIZE (input length) bytes
+ *	@return number of bytes written, excluding terminating null byte
+ */
+size_t PianoDecryptBuffer (const char *in, size_t inN, char *out) {
+	return PianoDecryptWithKey (in_key_n, in_key_p, in_key_s, in, inN, out);
+}
+
+/*	decrypt our own post data (PianoEncryptBuffer's output), for session
+ *	traces; see PianoDecryptBuffer
+ */
+size_t PianoDecryptPostData (const char *in, size_t inN, char *out) {
+	return PianoDecryptWithKey (out_key_n, out_key_p, out_key_s, in, inN,
+			out);
+}
+
+/*	decrypt hex-encoded, blowfish-crypted string
+ *	@param hex string
+ *	@return decrypted string or NULL
+ */
+char *PianoDecryptString (const char *strInput) {
+	const size_t strInputN = strlen (strInput);
+	char *strDecrypted;
+
+	if ((strDecrypted = malloc (PIANO_DECRYPT_SIZE (strInputN))) == NULL) {
+		return NULL;
 	}
+	PianoDecryptBuffer (strInput, strInputN, strDecrypted);
 
-	free (blockInput);
+	return strDecrypted;
+}
+
+/*	blowfish-encrypt/hex-encode string
+ *	@param encrypt this
+ *	@return encrypted, hex-encoded string
+ */
+char *PianoEncryptString (const char *strInput) {
+	const size_t strInputN = strlen (strInput);
+	char *strHex;
+
+	if ((strHex = malloc (PIANO_ENCRYPT_SIZE (strInputN))) == NULL) {
+		return NULL;
+	}
+	PianoEncryptBuffer (strInput, strInputN, strHex);
 
 	return strHex;
 }
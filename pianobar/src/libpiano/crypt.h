@@ -21,9 +21,22 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 
-#ifndef _CRYPH_H
+#ifndef _CRYPT_H
 #define _CRYPT_H
 
+#include <stddef.h>
+
+/* blowfish block size */
+#define PIANO_CRYPT_BLOCK 8
+/* output buffer size for n bytes of plaintext (including null byte) */
+#define PIANO_ENCRYPT_SIZE(n) (((n) / 8 + 1) * 16 + 1)
+/* output buffer size for n hex digits (including null byte) */
+#define PIANO_DECRYPT_SIZE(n) ((n) / 16 * 8 + 1)
+
+void PianoEncryptBlocks (const char *, size_t, char *);
+size_t PianoEncryptBuffer (const char *, size_t, char *);
+size_t PianoDecryptBuffer (const char *, size_t, char *);
+size_t PianoDecryptPostData (const char *, size_t, char *);
 char *PianoDecryptString (const char *strInput);
 char *PianoEncryptString (const char *strInput);
 
@@ -38,15 +38,17 @@ THE SOFTWARE.
 
 #include "piano_private.h"
 #include "piano.h"
+#include "arena.h"
 #include "xml.h"
 #include "crypt.h"
+#include "strbuf.h"
+#include "trace.h"
 #include "config.h"
 
 #define PIANO_PROTOCOL_VERSION "33"
 #define PIANO_RPC_HOST "www.pandora.com"
 #define PIANO_RPC_PORT "80"
 #define PIANO_RPC_PATH "/radio/xmlrpc/v" PIANO_PROTOCOL_VERSION "?"
-#define PIANO_SEND_BUFFER_SIZE 10000
 
 /*	initialize piano handle
  *	@param piano handle
@@ -67,12 +69,16 @@ void PianoDestroyArtists (PianoArtist_t *artists) {
 
 	curArtist = artists;
 	while (curArtist != NULL) {
-		free (curArtist->name);
-		free (curArtist->musicId);
-		free (curArtist->seedId);
 		lastArtist = curArtist;
 		curArtist = curArtist->next;
-		free (lastArtist);
+		if (lastArtist->arena != NULL) {
+			PianoArenaUnref (lastArtist->arena);
+		} else {
+			free (lastArtist->name);
+			free (lastArtist->musicId);
+			free (lastArtist->seedId);
+			free (lastArtist);
+		}
 	}
 }
 
@@ -85,18 +91,40 @@ void PianoDestroySearchResult (PianoSearchResult_t *searchResult) {
 	PianoDestroyPlaylist (searchResult->songs);
 }
 
-/*	free single station
+/*	free single station's data, the structure itself (and its arena) is
+ *	kept
  *	@param station
  */
 void PianoDestroyStation (PianoStation_t *station) {
-	free (station->name);
-	free (station->id);
-	free (station->seedId);
+	PianoArena_t *arena = station->arena;
+
+	/* strings are released with the arena */
+	if (arena == NULL) {
+		free (station->name);
+		free (station->id);
+		free (station->seedId);
+	}
 	memset (station, 0, sizeof (*station));
+	station->arena = arena;
+}
+
+/*	free single station, including the structure
+ *	@param station
+ */
+void PianoFreeStation (PianoStation_t *station) {
+	PianoArena_t *arena = station->arena;
+
+	PianoDestroyStation (station);
+	if (arena != NULL) {
+		PianoArenaUnref (arena);
+	} else {
+		free (station);
+	}
 }
 
 /*	free complete station list
- *	@param piano handle
+ *	@public yes
+ *	@param station list
  */
 void PianoDestroyStations (PianoStation_t *stations) {
 	PianoStation_t *curStation, *lastStation;
@@ -105,8 +133,7 @@ void PianoDestroyStations (PianoStation_t *stations) {
 	while (curStation != NULL) {
 		lastStation = curStation;
 		curStation = curStation->next;
-		PianoDestroyStation (lastStation);
-		free (lastStation);
+		PianoFreeStation (lastStation);
 	}
 }
 
@@ -120,21 +147,25 @@ void PianoDestroyPlaylist (PianoSong_t *playlist) {
 
 	curSong = playlist;
 	while (curSong != NULL) {
-		free (curSong->audioUrl);
-		free (curSong->coverArt);
-		free (curSong->artist);
-		free (curSong->musicId);
-		free (curSong->title);
-		free (curSong->userSeed);
-		free (curSong->stationId);
-		free (curSong->album);
-		free (curSong->artistMusicId);
-		free (curSong->feedbackId);
-		free (curSong->seedId);
-		free (curSong->detailUrl);
-		free (curSong->trackToken);
 		lastSong = curSong;
 		curSong = curSong->next;
+		if (lastSong->arena != NULL) {
+			PianoArenaUnref (lastSong->arena);
+			continue;
+		}
+		free (lastSong->audioUrl);
+		free (lastSong->coverArt);
+		free (lastSong->artist);
+		free (lastSong->musicId);
+		free (lastSong->title);
+		free (lastSong->userSeed);
+		free (lastSong->stationId);
+		free (lastSong->album);
+		free (lastSong->artistMusicId);
+		free (lastSong->feedbackId);
+		free (lastSong->seedId);
+		free (lastSong->detailUrl);
+		free (lastSong->trackToken);
 		free (lastSong);
 	}
 }
@@ -169,6 +200,15 @@ void PianoDestroyUserInfo (PianoUserInfo_t *user) {
 	free (user->listenerId);
 }
 
+/*	free station index
+ *	@param index
+ */
+static void PianoDestroyStationIndex (PianoStationIndex_t *index) {
+	free (index->byId);
+	free (index->byName);
+	memset (index, 0, sizeof (*index));
+}
+
 /*	frees the whole piano handle structure
  *	@param piano handle
  *	@return nothing
@@ -176,6 +216,7 @@ void PianoDestroyUserInfo (PianoUserInfo_t *user) {
 void PianoDestroy (PianoHandle_t *ph) {
 	PianoDestroyUserInfo (&ph->user);
 	PianoDestroyStations (ph->stations);
+	PianoDestroyStationIndex (&ph->stationIndex);
 	/* destroy genre stations */
 	PianoGenreCategory_t *curGenreCat = ph->genreStations, *lastGenreCat;
 	while (curGenreCat != NULL) {
@@ -194,6 +235,10 @@ void PianoDestroy (PianoHandle_t *ph) {
  */
 void PianoDestroyRequest (PianoRequest_t *req) {
 	free (req->postData);
+	free (req->urlPath);
+	if (req->responseStream != NULL) {
+		PianoXmlStreamFree (req->responseStream);
+	}
 	memset (req, 0, sizeof (*req));
 }
 
@@ -228,13 +273,18 @@ static const char *PianoAudioFormatToString (PianoAudioFormat_t format) {
  */
 PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 		PianoRequestType_t type) {
-	char xmlSendBuf[PIANO_SEND_BUFFER_SIZE];
+	/* post data is encrypted while it is written */
+	PianoStrBuf_t xmlSendBuf, urlPath;
 	/* corrected timestamp */
 	time_t timestamp = time (NULL) - ph->timeOffset;
+	PianoReturn_t ret;
 
 	assert (ph != NULL);
 	assert (req != NULL);
 
+	PianoStrBufInit (&xmlSendBuf, true);
+	PianoStrBufInit (&urlPath, false);
+
 	req->type = type;
 
 	switch (req->type) {
@@ -246,11 +296,11 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			switch (logindata->step) {
 				case 0:
-					snprintf (xmlSendBuf, sizeof (xmlSendBuf), 
+					PianoStrBufPrintf (&xmlSendBuf, 
 							"<?xml version=\"1.0\"?><methodCall>"
 							"<methodName>misc.sync</methodName>"
 							"<params></params></methodCall>");
-					snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+					PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 							"rid=%s&method=sync", ph->routeId);
 					break;
 
@@ -264,7 +314,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 						return PIANO_RET_OUT_OF_MEMORY;
 					}
 
-					snprintf (xmlSendBuf, sizeof (xmlSendBuf), 
+					PianoStrBufPrintf (&xmlSendBuf, 
 							"<?xml version=\"1.0\"?><methodCall>"
 							"<methodName>listener.authenticateListener</methodName>"
 							"<params><param><value><int>%lu</int></value></param>"
@@ -280,7 +330,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 							"<param><value><boolean>1</boolean></value></param>"
 							"</params></methodCall>", (unsigned long) timestamp,
 							logindata->user, xmlencodedPassword);
-					snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+					PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 							"rid=%s&method=authenticateListener", ph->routeId);
 
 					free (xmlencodedPassword);
@@ -294,13 +344,13 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			/* get stations, user must be authenticated */
 			assert (ph->user.listenerId != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.getStations</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=getStations", ph->routeId,
 					ph->user.listenerId);
 			break;
@@ -314,7 +364,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->station->id != NULL);
 			assert (reqData->format != PIANO_AF_UNKNOWN);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>playlist.getFragment</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -336,7 +386,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, reqData->station->id,
 					PianoAudioFormatToString (reqData->format));
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=getFragment&arg1=%s&arg2=0"
 					"&arg3=&arg4=&arg5=%s&arg6=0&arg7=0", ph->routeId,
 					ph->user.listenerId, reqData->station->id,
@@ -352,7 +402,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->stationId != NULL);
 			assert (reqData->rating != PIANO_RATE_NONE);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.addFeedback</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -366,7 +416,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, reqData->stationId, reqData->trackToken,
 					(reqData->rating == PIANO_RATE_LOVE) ? 1 : 0);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=addFeedback&arg1=%s&arg2=%s"
 					"&arg3=%s",
 					ph->routeId, ph->user.listenerId, reqData->stationId,
@@ -389,7 +439,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			}
 			urlencodedNewName = WaitressUrlEncode (reqData->newName);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.setStationName</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -401,7 +451,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, reqData->station->id,
 					xmlencodedNewName);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=setStationName&arg1=%s&arg2=%s",
 					ph->routeId, ph->user.listenerId, reqData->station->id,
 					urlencodedNewName);
@@ -417,7 +467,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (station != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.removeStation</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -426,7 +476,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, station->id);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=removeStation&arg1=%s", ph->routeId,
 					ph->user.listenerId, station->id);
 			break;
@@ -445,7 +495,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			}
 			urlencodedSearchStr = WaitressUrlEncode (reqData->searchStr);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>music.search</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -454,7 +504,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, xmlencodedSearchStr);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=search&arg1=%s", ph->routeId,
 					ph->user.listenerId, urlencodedSearchStr);
 
@@ -472,7 +522,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->id != NULL);
 			assert (reqData->type != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.createStation</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -484,7 +534,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, reqData->type, reqData->id);
 
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=createStation&arg1=%s%s&arg2=", ph->routeId,
 					ph->user.listenerId, reqData->type, reqData->id);
 			break;
@@ -498,7 +548,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->station != NULL);
 			assert (reqData->musicId != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.addSeed</methodName><params>"
 					"<param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -509,7 +559,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, reqData->station->id, reqData->musicId);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=addSeed&arg1=%s&arg2=%s", ph->routeId,
 					ph->user.listenerId, reqData->station->id, reqData->musicId);
 			break;
@@ -521,7 +571,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (song != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>listener.addTiredSong</methodName><params>"
 					"<param><value><int>%lu</int></value></param>"
 					"<param><value><string>%s</string></value></param>"
@@ -536,7 +586,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					(song->musicId == NULL) ? "" : song->musicId,
 					(song->userSeed == NULL) ? "" : song->userSeed,
 					song->stationId);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=addTiredSong&arg1=%s&arg2=%s&arg3=%s",
 					ph->routeId, ph->user.listenerId,
 					(song->musicId == NULL) ? "" : song->musicId,
@@ -548,11 +598,10 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 		case PIANO_REQUEST_SET_QUICKMIX: {
 			/* select stations included in quickmix (see useQuickMix flag of
 			 * PianoStation_t) */
-			char valueBuf[1000], urlArgBuf[1000];
 			PianoStation_t *curStation = ph->stations;
+			bool first = true;
 
-			memset (urlArgBuf, 0, sizeof (urlArgBuf));
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.setQuickMix</methodName><params>"
 					"<param><value><int>%lu</int></value></param>"
 					"<param><value><string>%s</string></value></param>"
@@ -560,6 +609,9 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>RANDOM</string></value></param>"
 					"<param><value><array><data>", (unsigned long) timestamp,
 					ph->user.authToken);
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
+					"rid=%s&lid=%s&method=setQuickMix&arg1=RANDOM&arg2=",
+					ph->routeId, ph->user.listenerId);
 			while (curStation != NULL) {
 				/* quick mix can't contain itself */
 				if (!curStation->useQuickMix || curStation->isQuickMix) {
@@ -567,39 +619,31 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					continue;
 				}
 				/* append to xml doc */
-				snprintf (valueBuf, sizeof (valueBuf),
-						"<value><string>%s</string></value>", curStation->id);
-				strncat (xmlSendBuf, valueBuf, sizeof (xmlSendBuf) -
-						strlen (xmlSendBuf) - 1);
-				/* append to url arg */
-				strncat (urlArgBuf, curStation->id, sizeof (urlArgBuf) -
-						strlen (urlArgBuf) - 1);
-				curStation = curStation->next;
-				/* if not last item: append "," */
-				if (curStation != NULL) {
-					strncat (urlArgBuf, "%2C", sizeof (urlArgBuf) -
-							strlen (urlArgBuf) - 1);
+				PianoStrBufPuts (&xmlSendBuf, "<value><string>");
+				PianoStrBufPuts (&xmlSendBuf, curStation->id);
+				PianoStrBufPuts (&xmlSendBuf, "</string></value>");
+				/* append to url arg, separated by "," */
+				if (!first) {
+					PianoStrBufPuts (&urlPath, "%2C");
 				}
+				PianoStrBufPuts (&urlPath, curStation->id);
+				first = false;
+				curStation = curStation->next;
 			}
-			strncat (xmlSendBuf,
+			PianoStrBufPuts (&xmlSendBuf,
 					"</data></array></value></param>"
 					/* empty */
 					"<param><value><string></string></value></param>"
 					/* empty */
 					"<param><value><string></string></value></param>"
-					"</params></methodCall>",
-					sizeof (xmlSendBuf) - strlen (xmlSendBuf) - 1);
-
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
-					"rid=%s&lid=%s&method=setQuickMix&arg1=RANDOM&arg2=%s&arg3=&arg4=",
-					ph->routeId, ph->user.listenerId, urlArgBuf);
+					"</params></methodCall>");
+			PianoStrBufPuts (&urlPath, "&arg3=&arg4=");
 			break;
 		}
 
 		case PIANO_REQUEST_GET_GENRE_STATIONS:
 			/* receive list of pandora's genre stations */
-			xmlSendBuf[0] = '\0';
-			snprintf (req->urlPath, sizeof (req->urlPath), "/xml/genre?r=%lu",
+			PianoStrBufPrintf (&urlPath, "/xml/genre?r=%lu",
 					(unsigned long) timestamp);
 			break;
 
@@ -609,7 +653,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (station != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.transformShared</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -618,7 +662,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, station->id);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=transformShared&arg1=%s", ph->routeId,
 					ph->user.listenerId, station->id);
 			break;
@@ -631,7 +675,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData != NULL);
 			assert (reqData->song != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>playlist.narrative</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -643,7 +687,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, reqData->song->stationId,
 					reqData->song->musicId);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=narrative&arg1=%s&arg2=%s",
 					ph->routeId, ph->user.listenerId, reqData->song->stationId,
 					reqData->song->musicId);
@@ -658,7 +702,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData->musicId != NULL);
 			assert (reqData->max != 0);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>music.getSeedSuggestions</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -672,7 +716,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, reqData->station->id, reqData->musicId,
 					reqData->max);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=getSeedSuggestions&arg1=%s&arg2=%u",
 					ph->routeId, ph->user.listenerId, reqData->musicId, reqData->max);
 			break;
@@ -684,7 +728,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (song != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.createBookmark</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -695,7 +739,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, song->stationId, song->musicId);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=createBookmark&arg1=%s&arg2=%s",
 					ph->routeId, ph->user.listenerId, song->stationId,
 					song->musicId);
@@ -708,7 +752,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (song != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.createArtistBookmark</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -717,7 +761,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, song->artistMusicId);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=createArtistBookmark&arg1=%s",
 					ph->routeId, ph->user.listenerId, song->artistMusicId);
 			break;
@@ -730,7 +774,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 			assert (reqData != NULL);
 			assert (reqData->station != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.getStation</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -739,7 +783,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, reqData->station->id);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=getStation&arg1=%s",
 					ph->routeId, ph->user.listenerId, reqData->station->id);
 			break;
@@ -750,7 +794,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (song != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.deleteFeedback</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -759,7 +803,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, song->feedbackId);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=deleteFeedback&arg1=%s",
 					ph->routeId, ph->user.listenerId, song->feedbackId);
 			break;
@@ -783,7 +827,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 
 			assert (seedId != NULL);
 
-			snprintf (xmlSendBuf, sizeof (xmlSendBuf), "<?xml version=\"1.0\"?>"
+			PianoStrBufPrintf (&xmlSendBuf, "<?xml version=\"1.0\"?>"
 					"<methodCall><methodName>station.deleteSeed</methodName>"
 					"<params><param><value><int>%lu</int></value></param>"
 					/* auth token */
@@ -792,7 +836,7 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 					"<param><value><string>%s</string></value></param>"
 					"</params></methodCall>", (unsigned long) timestamp,
 					ph->user.authToken, seedId);
-			snprintf (req->urlPath, sizeof (req->urlPath), PIANO_RPC_PATH
+			PianoStrBufPrintf (&urlPath, PIANO_RPC_PATH
 					"rid=%s&lid=%s&method=deleteSeed&arg1=%s",
 					ph->routeId, ph->user.listenerId, seedId);
 			break;
@@ -862,13 +906,48 @@ PianoReturn_t PianoRequest (PianoHandle_t *ph, PianoRequest_t *req,
 		}
 	}
 
-	if ((req->postData = PianoEncryptString (xmlSendBuf)) == NULL) {
+	if ((req->postData = PianoStrBufFinish (&xmlSendBuf)) == NULL) {
+		PianoStrBufFree (&urlPath);
+		return PIANO_RET_OUT_OF_MEMORY;
+	}
+	if ((req->urlPath = PianoStrBufFinish (&urlPath)) == NULL) {
 		return PIANO_RET_OUT_OF_MEMORY;
 	}
+	if (ph->trace != NULL &&
+			(ret = PianoTraceRequest (ph->trace, req)) != PIANO_RET_OK) {
+		return ret;
+	}
+
+	/* the largest responses can be parsed while they are downloaded, see
+	 * PianoResponseFeed */
+	if (req->type == PIANO_REQUEST_GET_PLAYLIST ||
+			req->type == PIANO_REQUEST_GET_STATIONS) {
+		if (req->responseStream != NULL) {
+			PianoXmlStreamFree (req->responseStream);
+		}
+		if ((req->responseStream = PianoXmlStreamNew (req->type)) == NULL) {
+			return PIANO_RET_OUT_OF_MEMORY;
+		}
+	}
 
 	return PIANO_RET_OK;
 }
 
+/*	pass part of the http response body to the request's incremental parser;
+ *	only possible if PianoRequest set up req->responseStream. responseData
+ *	must stay NULL then, errors are returned by PianoResponse
+ *	@public yes
+ *	@param initialized request
+ *	@param data
+ *	@param data size
+ */
+void PianoResponseFeed (PianoRequest_t *req, const char *data, size_t size) {
+	assert (req != NULL);
+	assert (req->responseStream != NULL);
+
+	PianoXmlStreamFeed (req->responseStream, data, size);
+}
+
 /*	parse xml response and update data structures/return new data structure
  *	@param piano handle
  *	@param initialized request (expects responseData to be a NUL-terminated
@@ -932,21 +1011,29 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 
 		case PIANO_REQUEST_GET_STATIONS:
 			/* get stations */
-			assert (req->responseData != NULL);
-			
-			ret = PianoXmlParseStations (ph, req->responseData);
+			if (req->responseData != NULL) {
+				ret = PianoXmlParseStations (ph, req->responseData);
+			} else {
+				assert (req->responseStream != NULL);
+				ret = PianoXmlStreamFinishStations (ph, req->responseStream);
+			}
 			break;
 
 		case PIANO_REQUEST_GET_PLAYLIST: {
 			/* get playlist, usually four songs */
 			PianoRequestDataGetPlaylist_t *reqData = req->data;
 
-			assert (req->responseData != NULL);
 			assert (reqData != NULL);
 
 			reqData->retPlaylist = NULL;
-			ret = PianoXmlParsePlaylist (ph, req->responseData,
-					&reqData->retPlaylist);
+			if (req->responseData != NULL) {
+				ret = PianoXmlParsePlaylist (ph, req->responseData,
+						&reqData->retPlaylist);
+			} else {
+				assert (req->responseStream != NULL);
+				ret = PianoXmlStreamFinishPlaylist (req->responseStream,
+						&reqData->retPlaylist);
+			}
 			break;
 		}
 
@@ -993,8 +1080,14 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				assert (reqData->station != NULL);
 				assert (reqData->newName != NULL);
 
-				free (reqData->station->name);
-				reqData->station->name = strdup (reqData->newName);
+				/* arena strings can't be freed, the old name stays there
+				 * until the station is gone */
+				if (reqData->station->arena == NULL) {
+					free (reqData->station->name);
+				}
+				reqData->station->name = PianoArenaStrdup (
+						reqData->station->arena, reqData->newName);
+				PianoRebuildStationIndex (ph);
 			}
 			break;
 
@@ -1017,8 +1110,8 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 							/* first station in list */
 							ph->stations = curStation->next;
 						}
-						PianoDestroyStation (curStation);
-						free (curStation);
+						PianoFreeStation (curStation);
+						PianoRebuildStationIndex (ph);
 						break;
 					}
 					lastStation = curStation;
@@ -1056,6 +1149,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 
 			/* FIXME: update station data instead of replacing them */
 			ret = PianoXmlParseAddSeed (ph, req->responseData, reqData->station);
+			PianoRebuildStationIndex (ph);
 			break;
 		}
 
@@ -1138,18 +1232,160 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 	return ret;
 }
 
-/*	get station from list by id
- *	@param search here
+/*	fnv-1a string hash
+ *	@param string
+ *	@return hash
+ */
+static size_t PianoStationHash (const char *s) {
+	size_t h = 2166136261u;
+
+	while (*s != '\0') {
+		h ^= (unsigned char) *s++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/*	insert into one of the index tables (linear probing); stations with the
+ *	same key end up behind each other, lookups find the first one
+ *	@param table
+ *	@param table size, power of two
+ *	@param station
+ *	@param key, station's id or name
+ */
+static void PianoStationIndexPut (PianoStation_t **table, size_t size,
+		PianoStation_t *station, const char *key) {
+	size_t i = PianoStationHash (key) & (size - 1);
+
+	while (table[i] != NULL) {
+		i = (i + 1) & (size - 1);
+	}
+	table[i] = station;
+}
+
+/*	add station to index, must already be part of ph->stations
+ *	@param piano handle
+ *	@param station
+ */
+void PianoStationIndexAdd (PianoHandle_t *ph, PianoStation_t *station) {
+	PianoStationIndex_t *index = &ph->stationIndex;
+
+	/* keep load factor <= 1/2 */
+	if ((index->count + 1) * 2 > index->size) {
+		PianoRebuildStationIndex (ph);
+		return;
+	}
+	if (station->id != NULL) {
+		PianoStationIndexPut (index->byId, index->size, station, station->id);
+	}
+	if (station->name != NULL) {
+		PianoStationIndexPut (index->byName, index->size, station,
+				station->name);
+	}
+	++index->count;
+}
+
+/*	recreate station index from ph->stations; lookups fall back to walking
+ *	the list if there's not enough memory
+ *	@public yes
+ *	@param piano handle
+ */
+void PianoRebuildStationIndex (PianoHandle_t *ph) {
+	PianoStationIndex_t *index = &ph->stationIndex;
+	PianoStation_t *curStation;
+	size_t count = 0, size = 16;
+
+	PianoDestroyStationIndex (index);
+
+	for (curStation = ph->stations; curStation != NULL;
+			curStation = curStation->next) {
+		++count;
+	}
+	while (size < count * 2) {
+		size *= 2;
+	}
+
+	index->byId = calloc (size, sizeof (*index->byId));
+	index->byName = calloc (size, sizeof (*index->byName));
+	if (index->byId == NULL || index->byName == NULL) {
+		PianoDestroyStationIndex (index);
+		return;
+	}
+	index->size = size;
+
+	for (curStation = ph->stations; curStation != NULL;
+			curStation = curStation->next) {
+		if (curStation->id != NULL) {
+			PianoStationIndexPut (index->byId, size, curStation, curStation->id);
+		}
+		if (curStation->name != NULL) {
+			PianoStationIndexPut (index->byName, size, curStation,
+					curStation->name);
+		}
+	}
+	index->count = count;
+}
+
+/*	get station by id
+ *	@public yes
+ *	@param piano handle
  *	@param search for this
  *	@return the first station structure matching the given id
  */
-PianoStation_t *PianoFindStationById (PianoStation_t *stations,
+PianoStation_t *PianoFindStationById (const PianoHandle_t *ph,
 		const char *searchStation) {
-	while (stations != NULL) {
-		if (strcmp (stations->id, searchStation) == 0) {
-			return stations;
+	const PianoStationIndex_t *index = &ph->stationIndex;
+	PianoStation_t *curStation;
+
+	if (index->size == 0) {
+		for (curStation = ph->stations; curStation != NULL;
+				curStation = curStation->next) {
+			if (curStation->id != NULL &&
+					strcmp (curStation->id, searchStation) == 0) {
+				return curStation;
+			}
+		}
+		return NULL;
+	}
+
+	size_t i = PianoStationHash (searchStation) & (index->size - 1);
+	while ((curStation = index->byId[i]) != NULL) {
+		if (strcmp (curStation->id, searchStation) == 0) {
+			return curStation;
 		}
-		stations = stations->next;
+		i = (i + 1) & (index->size - 1);
+	}
+	return NULL;
+}
+
+/*	get station by name
+ *	@public yes
+ *	@param piano handle
+ *	@param search for this
+ *	@return the first station structure matching the given name
+ */
+PianoStation_t *PianoFindStationByName (const PianoHandle_t *ph,
+		const char *name) {
+	const PianoStationIndex_t *index = &ph->stationIndex;
+	PianoStation_t *curStation;
+
+	if (index->size == 0) {
+		for (curStation = ph->stations; curStation != NULL;
+				curStation = curStation->next) {
+			if (curStation->name != NULL &&
+					strcmp (curStation->name, name) == 0) {
+				return curStation;
+			}
+		}
+		return NULL;
+	}
+
+	size_t i = PianoStationHash (name) & (index->size - 1);
+	while ((curStation = index->byName[i]) != NULL) {
+		if (strcmp (curStation->name, name) == 0) {
+			return curStation;
+		}
+		i = (i + 1) & (index->size - 1);
 	}
 	return NULL;
 }
@@ -1226,6 +1462,10 @@ const char *PianoErrorToStr (PianoReturn_t ret) {
 			return "Last seed cannot be removed.";
 			break;
 
+		case PIANO_RET_TRACE_MISMATCH:
+			return "Request does not match session trace.";
+			break;
+
 		default:
 			return "No error message available.";
 			break;
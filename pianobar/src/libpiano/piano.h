@@ -24,6 +24,8 @@ THE SOFTWARE.
 #ifndef _PIANO_H
 #define _PIANO_H
 
+#include <stddef.h>
+
 /* this is our public API; don't expect this api to be stable as long as
  * pandora does not provide a stable api
  * all strings _must_ be utf-8 encoded. i won't care, but pandora does. so
@@ -32,6 +34,12 @@ THE SOFTWARE.
 #define PIANO_RPC_HOST "www.pandora.com"
 #define PIANO_RPC_PORT "80"
 
+/* owns parsed songs, stations and artists; NULL for objects allocated with
+ * malloc (all strings are malloc'ed then, too) */
+struct PianoArena;
+/* rpc session trace, see trace.h */
+struct PianoTrace;
+
 typedef struct PianoUserInfo {
 	char *webAuthToken;
 	char *listenerId;
@@ -46,6 +54,7 @@ typedef struct PianoStation {
 	char *id;
 	char *seedId;
 	struct PianoStation *next;
+	struct PianoArena *arena;
 } PianoStation_t;
 
 typedef enum {
@@ -80,6 +89,7 @@ typedef struct PianoSong {
 	PianoSongRating_t rating;
 	PianoAudioFormat_t audioFormat;
 	struct PianoSong *next;
+	struct PianoArena *arena;
 } PianoSong_t;
 
 /* currently only used for search results */
@@ -89,6 +99,7 @@ typedef struct PianoArtist {
 	char *seedId;
 	int score;
 	struct PianoArtist *next;
+	struct PianoArena *arena;
 } PianoArtist_t;
 
 typedef struct PianoGenre {
@@ -103,13 +114,27 @@ typedef struct PianoGenreCategory {
 	struct PianoGenreCategory *next;
 } PianoGenreCategory_t;
 
+/* hash tables (open addressing) over the station list, by id and name */
+typedef struct PianoStationIndex {
+	PianoStation_t **byId;
+	PianoStation_t **byName;
+	/* slots, power of two; 0 if not available */
+	size_t size;
+	size_t count;
+} PianoStationIndex_t;
+
 typedef struct PianoHandle {
 	char routeId[9];
 	PianoUserInfo_t user;
 	/* linked lists */
 	PianoStation_t *stations;
 	PianoGenreCategory_t *genreStations;
+	/* kept in sync with stations by libpiano; use
+	 * PianoRebuildStationIndex after modifying the list yourself */
+	PianoStationIndex_t stationIndex;
 	int timeOffset;
+	/* records or replays requests if set (after PianoInit); not owned */
+	struct PianoTrace *trace;
 } PianoHandle_t;
 
 typedef struct PianoSearchResult {
@@ -153,9 +178,12 @@ typedef enum {
 typedef struct PianoRequest {
 	PianoRequestType_t type;
 	void *data;
-	char urlPath[1024];
+	char *urlPath;
 	char *postData;
 	char *responseData;
+	/* set for requests that can be parsed incrementally, see
+	 * PianoResponseFeed */
+	struct PianoXmlStream *responseStream;
 } PianoRequest_t;
 
 /* request data structures */
@@ -250,20 +278,25 @@ typedef enum {
 	PIANO_RET_PLAYLIST_END = 14,
 	PIANO_RET_QUICKMIX_NOT_PLAYABLE = 15,
 	PIANO_RET_REMOVING_TOO_MANY_SEEDS = 16,
+	PIANO_RET_TRACE_MISMATCH = 17,
 } PianoReturn_t;
 
 void PianoInit (PianoHandle_t *);
 void PianoDestroy (PianoHandle_t *);
 void PianoDestroyPlaylist (PianoSong_t *);
+void PianoDestroyStations (PianoStation_t *);
 void PianoDestroySearchResult (PianoSearchResult_t *);
 void PianoDestroyStationInfo (PianoStationInfo_t *);
 
 PianoReturn_t PianoRequest (PianoHandle_t *, PianoRequest_t *,
 		PianoRequestType_t);
 PianoReturn_t PianoResponse (PianoHandle_t *, PianoRequest_t *);
+void PianoResponseFeed (PianoRequest_t *, const char *, size_t);
 void PianoDestroyRequest (PianoRequest_t *);
 
-PianoStation_t *PianoFindStationById (PianoStation_t *, const char *);
+PianoStation_t *PianoFindStationById (const PianoHandle_t *, const char *);
+PianoStation_t *PianoFindStationByName (const PianoHandle_t *, const char *);
+void PianoRebuildStationIndex (PianoHandle_t *);
 const char *PianoErrorToStr (PianoReturn_t);
 
 #endif /* _PIANO_H */
@@ -27,5 +27,7 @@ THE SOFTWARE.
 #include "piano.h"
 
 void PianoDestroyStation (PianoStation_t *station);
+void PianoFreeStation (PianoStation_t *station);
+void PianoStationIndexAdd (PianoHandle_t *, PianoStation_t *);
 
 #endif /* _MAIN_H */
@@ -0,0 +1,212 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "strbuf.h"
+
+/* first allocation, doubled when full */
+#define PIANO_STRBUF_MIN 256
+/* printf output up to this size is formatted on the stack */
+#define PIANO_STRBUF_FORMAT 1024
+
+/*	initialize empty string
+ *	@param string
+ *	@param blowfish-encrypt and hex-encode appended text
+ */
+void PianoStrBufInit (PianoStrBuf_t *sb, bool encrypt) {
+	memset (sb, 0, sizeof (*sb));
+	sb->encrypt = encrypt;
+}
+
+/*	make room for n more bytes and null byte
+ *	@param string
+ *	@param bytes
+ *	@return false if out of memory
+ */
+static bool PianoStrBufReserve (PianoStrBuf_t *sb, size_t n) {
+	size_t size;
+	char *buf;
+
+	if (sb->failed) {
+		return false;
+	}
+	if (sb->len + n + 1 <= sb->size) {
+		return true;
+	}
+
+	size = sb->size < PIANO_STRBUF_MIN ? PIANO_STRBUF_MIN : sb->size;
+	while (size < sb->len + n + 1) {
+		size *= 2;
+	}
+	if ((buf = realloc (sb->buf, size)) == NULL) {
+		sb->failed = true;
+		return false;
+	}
+	sb->buf = buf;
+	sb->size = size;
+	return true;
+}
+
+/*	encrypt complete blocks and append their hex encoding
+ *	@param string
+ *	@param plaintext
+ *	@param number of blocks
+ */
+static void PianoStrBufEncrypt (PianoStrBuf_t *sb, const char *data,
+		size_t blockN) {
+	const size_t hexN = blockN * PIANO_CRYPT_BLOCK * 2;
+
+	if (!PianoStrBufReserve (sb, hexN)) {
+		return;
+	}
+	PianoEncryptBlocks (data, blockN, &sb->buf[sb->len]);
+	sb->len += hexN;
+	sb->buf[sb->len] = '\0';
+}
+
+/*	append bytes
+ *	@param string
+ *	@param data
+ *	@param length
+ */
+void PianoStrBufAppend (PianoStrBuf_t *sb, const char *data, size_t n) {
+	if (!sb->encrypt) {
+		if (PianoStrBufReserve (sb, n)) {
+			memcpy (&sb->buf[sb->len], data, n);
+			sb->len += n;
+			sb->buf[sb->len] = '\0';
+		}
+		return;
+	}
+
+	/* top up pending plaintext first */
+	if (sb->pendingN > 0) {
+		const size_t copyN = n < PIANO_STRBUF_PENDING - sb->pendingN ?
+				n : PIANO_STRBUF_PENDING - sb->pendingN;
+
+		memcpy (&sb->pending[sb->pendingN], data, copyN);
+		sb->pendingN += copyN;
+		data += copyN;
+		n -= copyN;
+		if (sb->pendingN < PIANO_STRBUF_PENDING) {
+			return;
+		}
+		PianoStrBufEncrypt (sb, sb->pending,
+				PIANO_STRBUF_PENDING / PIANO_CRYPT_BLOCK);
+		sb->pendingN = 0;
+	}
+
+	/* large appends are encrypted in place, only the incomplete last block
+	 * is kept */
+	if (n >= PIANO_STRBUF_PENDING) {
+		const size_t blockN = n / PIANO_CRYPT_BLOCK;
+
+		PianoStrBufEncrypt (sb, data, blockN);
+		data += blockN * PIANO_CRYPT_BLOCK;
+		n -= blockN * PIANO_CRYPT_BLOCK;
+	}
+	memcpy (sb->pending, data, n);
+	sb->pendingN = n;
+}
+
+/*	append null-terminated string
+ *	@param string
+ *	@param append this
+ */
+void PianoStrBufPuts (PianoStrBuf_t *sb, const char *s) {
+	PianoStrBufAppend (sb, s, strlen (s));
+}
+
+/*	append formatted string
+ *	@param string
+ *	@param printf format
+ */
+void PianoStrBufPrintf (PianoStrBuf_t *sb, const char *format, ...) {
+	char stackBuf[PIANO_STRBUF_FORMAT], *heapBuf;
+	va_list args;
+	int n;
+
+	va_start (args, format);
+	n = vsnprintf (stackBuf, sizeof (stackBuf), format, args);
+	va_end (args);
+
+	if (n < 0) {
+		sb->failed = true;
+		return;
+	}
+	if ((size_t) n < sizeof (stackBuf)) {
+		PianoStrBufAppend (sb, stackBuf, n);
+		return;
+	}
+
+	if ((heapBuf = malloc (n + 1)) == NULL) {
+		sb->failed = true;
+		return;
+	}
+	va_start (args, format);
+	vsnprintf (heapBuf, n + 1, format, args);
+	va_end (args);
+	PianoStrBufAppend (sb, heapBuf, n);
+	free (heapBuf);
+}
+
+/*	complete string; pending plaintext is zero-padded to the next block (a
+ *	full block of zeros is added if there is none), like
+ *	PianoEncryptString does
+ *	@param string, empty afterwards
+ *	@return string (free it yourself) or NULL if out of memory
+ */
+char *PianoStrBufFinish (PianoStrBuf_t *sb) {
+	char *ret;
+
+	if (sb->encrypt) {
+		const size_t blockN = sb->pendingN / PIANO_CRYPT_BLOCK + 1;
+
+		memset (&sb->pending[sb->pendingN], 0,
+				blockN * PIANO_CRYPT_BLOCK - sb->pendingN);
+		PianoStrBufEncrypt (sb, sb->pending, blockN);
+	} else if (PianoStrBufReserve (sb, 0)) {
+		/* empty string */
+		sb->buf[sb->len] = '\0';
+	}
+
+	if (sb->failed) {
+		PianoStrBufFree (sb);
+		return NULL;
+	}
+	ret = sb->buf;
+	PianoStrBufInit (sb, sb->encrypt);
+	return ret;
+}
+
+/*	free string
+ *	@param string, empty afterwards
+ */
+void PianoStrBufFree (PianoStrBuf_t *sb) {
+	free (sb->buf);
+	PianoStrBufInit (sb, sb->encrypt);
+}
@@ -0,0 +1,55 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _STRBUF_H
+#define _STRBUF_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "crypt.h"
+
+/* plaintext collected before it is encrypted, multiple of PIANO_CRYPT_BLOCK */
+#define PIANO_STRBUF_PENDING (PIANO_CRYPT_BLOCK * 8)
+
+/* append-only string, grows as needed. if encrypting, complete blowfish
+ * blocks are encrypted and hex-encoded as soon as they are appended, buf
+ * only ever holds the hex string. memory is allocated on first append. */
+typedef struct PianoStrBuf {
+	char *buf;
+	size_t len, size;
+	bool encrypt;
+	/* allocation failed, later appends are ignored */
+	bool failed;
+	char pending[PIANO_STRBUF_PENDING];
+	size_t pendingN;
+} PianoStrBuf_t;
+
+void PianoStrBufInit (PianoStrBuf_t *, bool);
+void PianoStrBufAppend (PianoStrBuf_t *, const char *, size_t);
+void PianoStrBufPuts (PianoStrBuf_t *, const char *);
+void PianoStrBufPrintf (PianoStrBuf_t *, const char *, ...);
+char *PianoStrBufFinish (PianoStrBuf_t *);
+void PianoStrBufFree (PianoStrBuf_t *);
+
+#endif /* _STRBUF_H */
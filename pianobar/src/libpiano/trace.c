@@ -0,0 +1,278 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __FreeBSD__
+#define _POSIX_C_SOURCE 200112L /* fdopen() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+#include "crypt.h"
+#include "config.h"
+
+/*	open trace file
+ *	@param path
+ *	@param record (overwrites file) or replay
+ *	@return trace or NULL
+ */
+PianoTrace_t *PianoTraceOpen (const char *path, PianoTraceMode_t mode) {
+	PianoTrace_t *trace;
+
+	if ((trace = calloc (1, sizeof (*trace))) == NULL) {
+		return NULL;
+	}
+	if (mode == PIANO_TRACE_RECORD) {
+		/* contains the decrypted login request, including the password */
+		const int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+		if (fd != -1 && (fchmod (fd, 0600) == -1 ||
+				(trace->fp = fdopen (fd, "wb")) == NULL)) {
+			close (fd);
+		}
+	} else {
+		trace->fp = fopen (path, "rb");
+	}
+	if (trace->fp == NULL) {
+		free (trace);
+		return NULL;
+	}
+	trace->mode = mode;
+	PianoStrBufInit (&trace->response, false);
+
+	return trace;
+}
+
+/*	close trace file; detach it from piano and waitress handles first
+ *	@param trace
+ */
+void PianoTraceClose (PianoTrace_t *trace) {
+	while (trace->pending != NULL) {
+		PianoTracePending_t * const next = trace->pending->next;
+		free (trace->pending);
+		trace->pending = next;
+	}
+	fclose (trace->fp);
+	PianoStrBufFree (&trace->response);
+	free (trace);
+}
+
+/*	read next record
+ *	@param trace
+ *	@param expected record type, "request" or "response"
+ *	@param returns request type or waitress return value
+ *	@param returns body, null-terminated (free it yourself)
+ *	@param returns body length
+ *	@return false at end of file, for malformed records or out of memory
+ */
+static bool PianoTraceRead (PianoTrace_t *trace, const char *tag, int *num,
+		char **body, size_t *len) {
+	char readTag[16];
+	int c;
+
+	if (fscanf (trace->fp, " %15s %d %zu", readTag, num, len) != 3 ||
+			strcmp (readTag, tag) != 0) {
+		return false;
+	}
+	/* skip url path */
+	while ((c = fgetc (trace->fp)) != '\n' && c != EOF);
+	if (c == EOF || (*body = malloc (*len + 1)) == NULL) {
+		return false;
+	}
+	if (fread (*body, 1, *len, trace->fp) != *len) {
+		free (*body);
+		return false;
+	}
+	(*body)[*len] = '\0';
+
+	return true;
+}
+
+/*	remember prepared request; called by PianoRequest if the piano handle
+ *	has a trace. It is recorded or checked when it is sent.
+ *	@param trace
+ *	@param request, ready to be sent
+ *	@return PIANO_RET_OK or PIANO_RET_OUT_OF_MEMORY
+ */
+PianoReturn_t PianoTraceRequest (PianoTrace_t *trace,
+		const PianoRequest_t *req) {
+	PianoTracePending_t *pending;
+
+	if ((pending = malloc (sizeof (*pending))) == NULL) {
+		return PIANO_RET_OUT_OF_MEMORY;
+	}
+	pending->postData = req->postData;
+	pending->type = req->type;
+	pending->next = trace->pending;
+	trace->pending = pending;
+
+	return PIANO_RET_OK;
+}
+
+/*	look up the request that is about to be sent; older pending requests
+ *	were never sent and are dropped
+ *	@param trace
+ *	@param post data of request being sent
+ *	@param returns request type
+ *	@return false if the request was not prepared by PianoRequest
+ */
+static bool PianoTraceTakePending (PianoTrace_t *trace, const char *postData,
+		int *type) {
+	PianoTracePending_t **prev = &trace->pending, *pending;
+
+	/* newest first, in case a dropped request's memory has been reused */
+	while (*prev != NULL && (*prev)->postData != postData) {
+		prev = &(*prev)->next;
+	}
+	if (*prev == NULL) {
+		return false;
+	}
+	*type = (*prev)->type;
+	pending = *prev;
+	*prev = NULL;
+	while (pending != NULL) {
+		PianoTracePending_t * const next = pending->next;
+		free (pending);
+		pending = next;
+	}
+
+	return true;
+}
+
+/*	copy response to trace and pass it on
+ */
+static WaitressCbReturn_t PianoTraceRecordCb (void *data, size_t size,
+		void *extraData) {
+	PianoTrace_t *trace = extraData;
+
+	PianoStrBufAppend (&trace->response, data, size);
+	return trace->callback (data, size, trace->data);
+}
+
+/*	waitress transport: fetch from network and record response
+ *	@param waitress handle
+ *	@param trace
+ */
+static WaitressReturn_t PianoTraceRecordTransport (void *handle,
+		void *data) {
+	WaitressHandle_t *waith = handle;
+	PianoTrace_t *trace = data;
+	WaitressReturn_t wRet;
+	const size_t hexN = strlen (waith->postData);
+	char *plain;
+	int type;
+
+	if (!PianoTraceTakePending (trace, waith->postData, &type)) {
+		return WAITRESS_RET_ERR;
+	}
+	if ((plain = malloc (PIANO_DECRYPT_SIZE (hexN))) == NULL) {
+		return WAITRESS_RET_ERR;
+	}
+	PianoDecryptPostData (waith->postData, hexN, plain);
+	/* zero padding is cut off by strlen */
+	fprintf (trace->fp, "request %d %zu %s\n%s\n", type, strlen (plain),
+			waith->url.path, plain);
+	free (plain);
+
+	trace->callback = waith->callback;
+	trace->data = waith->data;
+	waith->callback = PianoTraceRecordCb;
+	waith->data = trace;
+	waith->transport = NULL;
+
+	wRet = WaitressFetchCall (waith);
+
+	waith->transport = PianoTraceRecordTransport;
+	waith->callback = trace->callback;
+	waith->data = trace->data;
+
+	fprintf (trace->fp, "response %d %zu\n", (int) wRet,
+			trace->response.len);
+	if (trace->response.len > 0) {
+		fwrite (trace->response.buf, 1, trace->response.len, trace->fp);
+	}
+	fputc ('\n', trace->fp);
+	fflush (trace->fp);
+	PianoStrBufFree (&trace->response);
+
+	return wRet;
+}
+
+/*	waitress transport: hand next recorded response to the callback, in
+ *	pieces like the network would
+ *	@param waitress handle
+ *	@param trace
+ */
+static WaitressReturn_t PianoTraceReplayTransport (void *handle,
+		void *data) {
+	WaitressHandle_t *waith = handle;
+	PianoTrace_t *trace = data;
+	char *body;
+	size_t len, pos;
+	int type, recordedType, wRet;
+
+	if (!PianoTraceTakePending (trace, waith->postData, &type)) {
+		return WAITRESS_RET_ERR;
+	}
+	if (!PianoTraceRead (trace, "request", &recordedType, &body, &len)) {
+		printf (PACKAGE ": %s\n", PianoErrorToStr (PIANO_RET_TRACE_MISMATCH));
+		return WAITRESS_RET_ERR;
+	}
+	free (body);
+	if (recordedType != type) {
+		printf (PACKAGE ": %s\n", PianoErrorToStr (PIANO_RET_TRACE_MISMATCH));
+		return WAITRESS_RET_ERR;
+	}
+
+	if (!PianoTraceRead (trace, "response", &wRet, &body, &len)) {
+		return WAITRESS_RET_READ_ERR;
+	}
+	for (pos = 0; pos < len; pos += WAITRESS_BUFFER_SIZE) {
+		const size_t chunk = len - pos < WAITRESS_BUFFER_SIZE ? len - pos :
+				WAITRESS_BUFFER_SIZE;
+
+		if (waith->callback (&body[pos], chunk, waith->data) ==
+				WAITRESS_CB_RET_ERR) {
+			free (body);
+			return WAITRESS_RET_CB_ABORT;
+		}
+	}
+	free (body);
+
+	return (WaitressReturn_t) wRet;
+}
+
+/*	route waitress requests through trace
+ *	@param trace
+ *	@param waitress handle used for rpc
+ */
+void PianoTraceAttach (PianoTrace_t *trace, WaitressHandle_t *waith) {
+	waith->transport = trace->mode == PIANO_TRACE_RECORD ?
+			PianoTraceRecordTransport : PianoTraceReplayTransport;
+	waith->transportData = trace;
+}
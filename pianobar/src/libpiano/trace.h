@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <waitress.h>
+
+#include "piano.h"
+#include "strbuf.h"
+
+typedef enum {
+	PIANO_TRACE_RECORD = 0,
+	PIANO_TRACE_REPLAY,
+} PianoTraceMode_t;
+
+/* request prepared by PianoRequest, but not sent yet */
+typedef struct PianoTracePending {
+	/* identifies the request when waitress sends it */
+	const char *postData;
+	PianoRequestType_t type;
+	struct PianoTracePending *next;
+} PianoTracePending_t;
+
+/* rpc session trace. recording writes every request (type, url path and
+ * decrypted post data) and its raw response to a file. replaying serves
+ * the recorded responses instead of pandora, so login, station and playlist
+ * flows run offline. set PianoHandle_t.trace and attach the trace to every
+ * waitress handle used for rpc; like the piano handle it must not be used
+ * by two threads at the same time.
+ *
+ * one record per request and response:
+ *   request <request type> <length> <url path>\n<post data>\n
+ *   response <waitress return> <length>\n<response body>\n
+ * requests are recorded (or checked, when replaying) as they are sent, so
+ * prepared requests that are never sent leave no trace. replaying checks
+ * request types only, urls and post data contain timestamps. */
+typedef struct PianoTrace {
+	FILE *fp;
+	PianoTraceMode_t mode;
+	/* newest first */
+	PianoTracePending_t *pending;
+	/* recording: response received so far and the real callback */
+	PianoStrBuf_t response;
+	WaitressCbReturn_t (*callback) (void *, size_t, void *);
+	void *data;
+} PianoTrace_t;
+
+PianoTrace_t *PianoTraceOpen (const char *, PianoTraceMode_t);
+void PianoTraceClose (PianoTrace_t *);
+void PianoTraceAttach (PianoTrace_t *, WaitressHandle_t *);
+PianoReturn_t PianoTraceRequest (PianoTrace_t *, const PianoRequest_t *);
+
+#endif /* _TRACE_H */
@@ -36,21 +36,72 @@ THE SOFTWARE.
 #include "crypt.h"
 #include "config.h"
 #include "piano_private.h"
+#include "arena.h"
+#include "xmlstream.h"
 
 static void PianoXmlStructParser (const ezxml_t,
 		void (*callback) (const char *, const ezxml_t, void *), void *);
 static char *PianoXmlGetNodeText (const ezxml_t);
 
+/* struct member name => callback specific id */
+typedef struct {
+	const char *name;
+	size_t len;
+	int id;
+} PianoXmlKey_t;
+
+#define PIANO_XML_KEY(name, id) {name, sizeof (name) - 1, id}
+#define PIANO_XML_KEYS(table) table, sizeof (table) / sizeof (*table)
+
+/*	look up member name; tables are sorted by name length, so only names
+ *	with the right length (usually one or two) are compared
+ *	@param lookup table
+ *	@param table size
+ *	@param member name
+ *	@return id or -1
+ */
+static int PianoXmlFindKey (const PianoXmlKey_t *keys, size_t n,
+		const char *key) {
+	const size_t len = strlen (key);
+	size_t i;
+
+	for (i = 0; i < n && keys[i].len <= len; i++) {
+		assert (i == 0 || keys[i-1].len <= keys[i].len);
+		if (keys[i].len == len && keys[i].name[0] == key[0] &&
+				memcmp (keys[i].name, key, len) == 0) {
+			return keys[i].id;
+		}
+	}
+	return -1;
+}
+
 /*	parse fault and get fault type
  *	@param xml <name> content
- *	@param xml <value> node
- *	@param return error string
+ *	@param <value> text, modified
+ *	@param return error code
  *	@return nothing
  */
-static void PianoXmlIsFaultCb (const char *key, const ezxml_t value,
-		void *data) {
-	PianoReturn_t *ret = data;
-	char *valueStr = PianoXmlGetNodeText (value);
+static void PianoXmlParseFault (const char *key, char *valueStr,
+		PianoReturn_t *ret) {
+	static const PianoXmlKey_t faults[] = {
+		PIANO_XML_KEY ("OUT_OF_SYNC", PIANO_RET_OUT_OF_SYNC),
+		PIANO_XML_KEY ("PLAYLIST_END", PIANO_RET_PLAYLIST_END),
+		PIANO_XML_KEY ("READONLY_MODE", PIANO_RET_READONLY_MODE),
+		PIANO_XML_KEY ("AUTH_INVALID_TOKEN", PIANO_RET_AUTH_TOKEN_INVALID),
+		PIANO_XML_KEY ("INCOMPATIBLE_VERSION",
+				PIANO_RET_PROTOCOL_INCOMPATIBLE),
+		PIANO_XML_KEY ("STATION_CODE_INVALID",
+				PIANO_RET_STATION_CODE_INVALID),
+		PIANO_XML_KEY ("QUICKMIX_NOT_PLAYABLE",
+				PIANO_RET_QUICKMIX_NOT_PLAYABLE),
+		PIANO_XML_KEY ("STATION_DOES_NOT_EXIST",
+				PIANO_RET_STATION_NONEXISTENT),
+		PIANO_XML_KEY ("LISTENER_NOT_AUTHORIZED", PIANO_RET_NOT_AUTHORIZED),
+		PIANO_XML_KEY ("REMOVING_TOO_MANY_SEEDS",
+				PIANO_RET_REMOVING_TOO_MANY_SEEDS),
+		PIANO_XML_KEY ("AUTH_INVALID_USERNAME_PASSWORD",
+				PIANO_RET_AUTH_USER_PASSWORD_INVALID),
+	};
 	char *matchStart, *matchEnd;
 
 	if (strcmp ("faultString", key) == 0) {
@@ -66,33 +117,10 @@ static void PianoXmlIsFaultCb (const char *key, const ezxml_t value,
 					*matchEnd = '\0';
 					++matchStart;
 					/* translate to our error message system */
-					if (strcmp ("AUTH_INVALID_TOKEN", matchStart) == 0) {
-						*ret = PIANO_RET_AUTH_TOKEN_INVALID;
-					} else if (strcmp ("AUTH_INVALID_USERNAME_PASSWORD",
-							matchStart) == 0) {
-						*ret = PIANO_RET_AUTH_USER_PASSWORD_INVALID;
-					} else if (strcmp ("LISTENER_NOT_AUTHORIZED",
-							matchStart) == 0) {
-						*ret = PIANO_RET_NOT_AUTHORIZED;
-					} else if (strcmp ("INCOMPATIBLE_VERSION",
-							matchStart) == 0) {
-						*ret = PIANO_RET_PROTOCOL_INCOMPATIBLE;
-					} else if (strcmp ("READONLY_MODE", matchStart) == 0) {
-						*ret = PIANO_RET_READONLY_MODE;
-					} else if (strcmp ("STATION_CODE_INVALID",
-							matchStart) == 0) {
-						*ret = PIANO_RET_STATION_CODE_INVALID;
-					} else if (strcmp ("STATION_DOES_NOT_EXIST",
-							matchStart) == 0) {
-						*ret = PIANO_RET_STATION_NONEXISTENT;
-					} else if (strcmp ("OUT_OF_SYNC", matchStart) == 0) {
-						*ret = PIANO_RET_OUT_OF_SYNC;
-					} else if (strcmp ("PLAYLIST_END", matchStart) == 0) {
-						*ret = PIANO_RET_PLAYLIST_END;
-					} else if (strcmp ("QUICKMIX_NOT_PLAYABLE", matchStart) == 0) {
-						*ret = PIANO_RET_QUICKMIX_NOT_PLAYABLE;
-					} else if (strcmp ("REMOVING_TOO_MANY_SEEDS", matchStart) == 0) {
-						*ret = PIANO_RET_REMOVING_TOO_MANY_SEEDS;
+					const int fault = PianoXmlFindKey (
+							PIANO_XML_KEYS (faults), matchStart);
+					if (fault != -1) {
+						*ret = fault;
 					} else {
 						*ret = PIANO_RET_ERR;
 						printf (PACKAGE ": Unknown error %s in %s\n",
@@ -110,6 +138,11 @@ static void PianoXmlIsFaultCb (const char *key, const ezxml_t value,
 	}
 }
 
+static void PianoXmlIsFaultCb (const char *key, const ezxml_t value,
+		void *data) {
+	PianoXmlParseFault (key, PianoXmlGetNodeText (value), data);
+}
+
 /*	check whether pandora returned an error or not
  *	@param document root of xml doc
  *	@return _RET_OK or fault code (_RET_*)
@@ -174,7 +207,8 @@ static void PianoXmlStructParser (const ezxml_t structRoot,
 static PianoReturn_t PianoXmlInitDoc (char *xmlStr, ezxml_t *xmlDoc) {
 	PianoReturn_t ret;
 
-	if ((*xmlDoc = ezxml_parse_str (xmlStr, strlen (xmlStr))) == NULL) {
+	/* the document is freed as a whole, nodes are never removed */
+	if ((*xmlDoc = ezxml_parse_str_arena (xmlStr, strlen (xmlStr))) == NULL) {
 		return PIANO_RET_XML_INVALID;
 	}
 
@@ -209,109 +243,205 @@ static char *PianoXmlGetNodeText (const ezxml_t node) {
  */
 static void PianoXmlParseUserinfoCb (const char *key, const ezxml_t value,
 		void *data) {
+	enum {USER_AUTHTOKEN, USER_LISTENERID, USER_WEBAUTHTOKEN};
+	static const PianoXmlKey_t keys[] = {
+		PIANO_XML_KEY ("authToken", USER_AUTHTOKEN),
+		PIANO_XML_KEY ("listenerId", USER_LISTENERID),
+		PIANO_XML_KEY ("webAuthToken", USER_WEBAUTHTOKEN),
+	};
 	PianoUserInfo_t *user = data;
 	char *valueStr = PianoXmlGetNodeText (value);
 
-	if (strcmp ("webAuthToken", key) == 0) {
-		user->webAuthToken = strdup (valueStr);
-	} else if (strcmp ("authToken", key) == 0) {
-		user->authToken = strdup (valueStr);
-	} else if (strcmp ("listenerId", key) == 0) {
-		user->listenerId = strdup (valueStr);
+	switch (PianoXmlFindKey (PIANO_XML_KEYS (keys), key)) {
+		case USER_WEBAUTHTOKEN:
+			user->webAuthToken = strdup (valueStr);
+			break;
+
+		case USER_AUTHTOKEN:
+			user->authToken = strdup (valueStr);
+			break;
+
+		case USER_LISTENERID:
+			user->listenerId = strdup (valueStr);
+			break;
 	}
 }
 
-static void PianoXmlParseStationsCb (const char *key, const ezxml_t value,
-		void *data) {
-	PianoStation_t *station = data;
-	char *valueStr = PianoXmlGetNodeText (value);
+/*	store station member
+ *	@param member name
+ *	@param <value> text
+ *	@param station
+ */
+static void PianoXmlParseStationsValue (const char *key, const char *valueStr,
+		PianoStation_t *station) {
+	enum {STATION_ID, STATION_ISCREATOR, STATION_ISQUICKMIX, STATION_NAME};
+	static const PianoXmlKey_t keys[] = {
+		PIANO_XML_KEY ("stationId", STATION_ID),
+		PIANO_XML_KEY ("isCreator", STATION_ISCREATOR),
+		PIANO_XML_KEY ("isQuickMix", STATION_ISQUICKMIX),
+		PIANO_XML_KEY ("stationName", STATION_NAME),
+	};
+	switch (PianoXmlFindKey (PIANO_XML_KEYS (keys), key)) {
+		case STATION_NAME:
+			station->name = PianoArenaStrdup (station->arena, valueStr);
+			break;
 
-	if (strcmp ("stationName", key) == 0) {
-		station->name = strdup (valueStr);
-	} else if (strcmp ("stationId", key) == 0) {
-		station->id = strdup (valueStr);
-	} else if (strcmp ("isQuickMix", key) == 0) {
-		station->isQuickMix = (strcmp (valueStr, "1") == 0);
-	} else if (strcmp ("isCreator", key) == 0) {
-		station->isCreator = (strcmp (valueStr, "1") == 0);
+		case STATION_ID:
+			station->id = PianoArenaStrdup (station->arena, valueStr);
+			break;
+
+		case STATION_ISQUICKMIX:
+			station->isQuickMix = (strcmp (valueStr, "1") == 0);
+			break;
+
+		case STATION_ISCREATOR:
+			station->isCreator = (strcmp (valueStr, "1") == 0);
+			break;
 	}
 }
 
-static void PianoXmlParsePlaylistCb (const char *key, const ezxml_t value,
+static void PianoXmlParseStationsCb (const char *key, const ezxml_t value,
 		void *data) {
-	PianoSong_t *song = data;
-	char *valueStr = PianoXmlGetNodeText (value);
+	PianoXmlParseStationsValue (key, PianoXmlGetNodeText (value), data);
+}
 
-	if (strcmp ("audioURL", key) == 0) {
-		/* last 48 chars of audioUrl are encrypted, but they put the key
-		 * into the door's lock... */
-		const char urlTailN = 48;
-		const size_t valueStrN = strlen (valueStr);
-		char *urlTail = NULL,
-				*urlTailCrypted = &valueStr[valueStrN - urlTailN];
-
-		/* don't try to decrypt if string is too short (=> invalid memory
-		 * reads/writes) */
-		if (valueStrN > urlTailN &&
-				(urlTail = PianoDecryptString (urlTailCrypted)) != NULL) {
-			if ((song->audioUrl = calloc (valueStrN + 1,
-					sizeof (*song->audioUrl))) != NULL) {
-				memcpy (song->audioUrl, valueStr, valueStrN - urlTailN);
-				/* FIXME: the key seems to be broken... so ignore 8 x 0x08
-				 * postfix; urlTailN/2 because the encrypted hex string is now
-				 * decoded */
-				memcpy (&song->audioUrl[valueStrN - urlTailN], urlTail,
-						urlTailN/2 - 8);
+/*	store song member
+ *	@param member name
+ *	@param <value> text
+ *	@param song
+ */
+static void PianoXmlParsePlaylistValue (const char *key, const char *valueStr,
+		PianoSong_t *song) {
+	enum {SONG_RATING, SONG_MUSICID, SONG_AUDIOURL, SONG_ARTRADIO,
+			SONG_USERSEED, SONG_FILEGAIN, SONG_SONGTITLE, SONG_STATIONID,
+			SONG_ISPOSITIVE, SONG_ALBUMTITLE, SONG_FEEDBACKID, SONG_TRACKTOKEN,
+			SONG_ARTISTSUMMARY, SONG_AUDIOENCODING, SONG_ARTISTMUSICID,
+			SONG_SONGDETAILURL};
+	static const PianoXmlKey_t keys[] = {
+		PIANO_XML_KEY ("rating", SONG_RATING),
+		PIANO_XML_KEY ("musicId", SONG_MUSICID),
+		PIANO_XML_KEY ("audioURL", SONG_AUDIOURL),
+		PIANO_XML_KEY ("artRadio", SONG_ARTRADIO),
+		PIANO_XML_KEY ("userSeed", SONG_USERSEED),
+		PIANO_XML_KEY ("fileGain", SONG_FILEGAIN),
+		PIANO_XML_KEY ("songTitle", SONG_SONGTITLE),
+		PIANO_XML_KEY ("stationId", SONG_STATIONID),
+		PIANO_XML_KEY ("isPositive", SONG_ISPOSITIVE),
+		PIANO_XML_KEY ("albumTitle", SONG_ALBUMTITLE),
+		PIANO_XML_KEY ("feedbackId", SONG_FEEDBACKID),
+		PIANO_XML_KEY ("trackToken", SONG_TRACKTOKEN),
+		PIANO_XML_KEY ("artistSummary", SONG_ARTISTSUMMARY),
+		PIANO_XML_KEY ("audioEncoding", SONG_AUDIOENCODING),
+		PIANO_XML_KEY ("artistMusicId", SONG_ARTISTMUSICID),
+		PIANO_XML_KEY ("songDetailURL", SONG_SONGDETAILURL),
+	};
+	switch (PianoXmlFindKey (PIANO_XML_KEYS (keys), key)) {
+		case SONG_AUDIOURL: {
+			/* last 48 chars of audioUrl are encrypted, but they put the key
+			 * into the door's lock... */
+			const char urlTailN = 48;
+			const size_t valueStrN = strlen (valueStr);
+			char urlTail[PIANO_DECRYPT_SIZE (48)];
+
+			/* don't try to decrypt if string is too short (=> invalid memory
+			 * reads/writes) */
+			if (valueStrN > urlTailN) {
+				PianoDecryptBuffer (&valueStr[valueStrN - urlTailN], urlTailN,
+						urlTail);
+				if ((song->audioUrl = PianoArenaAlloc (song->arena,
+						valueStrN + 1)) != NULL) {
+					memcpy (song->audioUrl, valueStr, valueStrN - urlTailN);
+					/* FIXME: the key seems to be broken... so ignore 8 x 0x08
+					 * postfix; urlTailN/2 because the encrypted hex string is
+					 * now decoded */
+					memcpy (&song->audioUrl[valueStrN - urlTailN], urlTail,
+							urlTailN/2 - 8);
+				}
 			}
-			free (urlTail);
-		}
-	} else if (strcmp ("artRadio", key) == 0) {
-		song->coverArt = strdup (valueStr);
-	} else if (strcmp ("artistSummary", key) == 0) {
-		song->artist = strdup (valueStr);
-	} else if (strcmp ("musicId", key) == 0) {
-		song->musicId = strdup (valueStr);
-	} else if (strcmp ("userSeed", key) == 0) {
-		song->userSeed = strdup (valueStr);
-	} else if (strcmp ("songTitle", key) == 0) {
-		song->title = strdup (valueStr);
-	} else if (strcmp ("rating", key) == 0) {
-		if (strcmp (valueStr, "1") == 0) {
-			song->rating = PIANO_RATE_LOVE;
-		} else {
-			song->rating = PIANO_RATE_NONE;
-		}
-	} else if (strcmp ("isPositive", key) == 0) {
-		if (strcmp (valueStr, "1") == 0) {
-			song->rating = PIANO_RATE_LOVE;
-		} else {
-			song->rating = PIANO_RATE_BAN;
-		}
-	} else if (strcmp ("stationId", key) == 0) {
-		song->stationId = strdup (valueStr);
-	} else if (strcmp ("albumTitle", key) == 0) {
-		song->album = strdup (valueStr);
-	} else if (strcmp ("fileGain", key) == 0) {
-		song->fileGain = atof (valueStr);
-	} else if (strcmp ("audioEncoding", key) == 0) {
-		if (strcmp (valueStr, "aacplus") == 0) {
-			song->audioFormat = PIANO_AF_AACPLUS;
-		} else if (strcmp (valueStr, "mp3") == 0) {
-			song->audioFormat = PIANO_AF_MP3;
-		} else if (strcmp (valueStr, "mp3-hifi") == 0) {
-			song->audioFormat = PIANO_AF_MP3_HI;
+			break;
 		}
-	} else if (strcmp ("artistMusicId", key) == 0) {
-		song->artistMusicId = strdup (valueStr);
-	} else if (strcmp ("feedbackId", key) == 0) {
-		song->feedbackId = strdup (valueStr);
-	} else if (strcmp ("songDetailURL", key) == 0) {
-		song->detailUrl = strdup (valueStr);
-	} else if (strcmp ("trackToken", key) == 0) {
-		song->trackToken = strdup (valueStr);
+
+		case SONG_ARTRADIO:
+			song->coverArt = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_ARTISTSUMMARY:
+			song->artist = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_MUSICID:
+			song->musicId = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_USERSEED:
+			song->userSeed = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_SONGTITLE:
+			song->title = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_RATING:
+			if (strcmp (valueStr, "1") == 0) {
+				song->rating = PIANO_RATE_LOVE;
+			} else {
+				song->rating = PIANO_RATE_NONE;
+			}
+			break;
+
+		case SONG_ISPOSITIVE:
+			if (strcmp (valueStr, "1") == 0) {
+				song->rating = PIANO_RATE_LOVE;
+			} else {
+				song->rating = PIANO_RATE_BAN;
+			}
+			break;
+
+		case SONG_STATIONID:
+			song->stationId = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_ALBUMTITLE:
+			song->album = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_FILEGAIN:
+			song->fileGain = atof (valueStr);
+			break;
+
+		case SONG_AUDIOENCODING:
+			if (strcmp (valueStr, "aacplus") == 0) {
+				song->audioFormat = PIANO_AF_AACPLUS;
+			} else if (strcmp (valueStr, "mp3") == 0) {
+				song->audioFormat = PIANO_AF_MP3;
+			} else if (strcmp (valueStr, "mp3-hifi") == 0) {
+				song->audioFormat = PIANO_AF_MP3_HI;
+			}
+			break;
+
+		case SONG_ARTISTMUSICID:
+			song->artistMusicId = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_FEEDBACKID:
+			song->feedbackId = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_SONGDETAILURL:
+			song->detailUrl = PianoArenaStrdup (song->arena, valueStr);
+			break;
+
+		case SONG_TRACKTOKEN:
+			song->trackToken = PianoArenaStrdup (song->arena, valueStr);
+			break;
 	}
 }
 
+static void PianoXmlParsePlaylistCb (const char *key, const ezxml_t value,
+		void *data) {
+	PianoXmlParsePlaylistValue (key, PianoXmlGetNodeText (value), data);
+}
+
 /*	parses userinfos sent by pandora as login response
  *	@param piano handle
  *	@param utf-8 string
@@ -388,11 +518,23 @@ PianoReturn_t PianoXmlParseStations (PianoHandle_t *ph, char *xml) {
 	ezxml_t xmlDoc, dataNode;
 	PianoReturn_t ret;
 	char **quickMixIds = NULL, **curQuickMixId = NULL;
+	PianoStation_t **tail = &ph->stations;
+	PianoArena_t *arena;
 
 	if ((ret = PianoXmlInitDoc (xml, &xmlDoc)) != PIANO_RET_OK) {
 		return ret;
 	}
 
+	if ((arena = PianoArenaNew ()) == NULL) {
+		ezxml_free (xmlDoc);
+		return PIANO_RET_OUT_OF_MEMORY;
+	}
+
+	/* append to existing list */
+	while (*tail != NULL) {
+		tail = &(*tail)->next;
+	}
+
 	dataNode = ezxml_get (xmlDoc, "params", 0, "param", 0, "value", 0, "array",
 			0, "data", -1);
 
@@ -400,10 +542,14 @@ PianoReturn_t PianoXmlParseStations (PianoHandle_t *ph, char *xml) {
 			dataNode = dataNode->next) {
 		PianoStation_t *tmpStation;
 
-		if ((tmpStation = calloc (1, sizeof (*tmpStation))) == NULL) {
+		if ((tmpStation = PianoArenaNewObject (arena,
+				sizeof (*tmpStation))) == NULL) {
+			PianoRebuildStationIndex (ph);
+			PianoArenaUnref (arena);
 			ezxml_free (xmlDoc);
 			return PIANO_RET_OUT_OF_MEMORY;
 		}
+		tmpStation->arena = arena;
 
 		PianoXmlStructParser (ezxml_child (dataNode, "struct"),
 				PianoXmlParseStationsCb, tmpStation);
@@ -413,22 +559,15 @@ PianoReturn_t PianoXmlParseStations (PianoHandle_t *ph, char *xml) {
 			PianoXmlStructParser (ezxml_child (dataNode, "struct"),
 					PianoXmlParseQuickMixStationsCb, &quickMixIds);
 		}
-		/* start new linked list or append */
-		if (ph->stations == NULL) {
-			ph->stations = tmpStation;
-		} else {
-			PianoStation_t *curStation = ph->stations;
-			while (curStation->next != NULL) {
-				curStation = curStation->next;
-			}
-			curStation->next = tmpStation;
-		}
+		*tail = tmpStation;
+		tail = &tmpStation->next;
 	}
+	PianoRebuildStationIndex (ph);
 	/* set quickmix flags after all stations are read */
 	if (quickMixIds != NULL) {
 		curQuickMixId = quickMixIds;
 		while (*curQuickMixId != NULL) {
-			PianoStation_t *curStation = PianoFindStationById (ph->stations,
+			PianoStation_t *curStation = PianoFindStationById (ph,
 					*curQuickMixId);
 			if (curStation != NULL) {
 				curStation->useQuickMix = 1;
@@ -439,6 +578,8 @@ PianoReturn_t PianoXmlParseStations (PianoHandle_t *ph, char *xml) {
 		free (quickMixIds);
 	}
 
+	/* stations keep it alive */
+	PianoArenaUnref (arena);
 	ezxml_free (xmlDoc);
 
 	return PIANO_RET_OK;
@@ -476,6 +617,7 @@ PianoReturn_t PianoXmlParseCreateStation (PianoHandle_t *ph, char *xml) {
 		}
 		curStation->next = tmpStation;
 	}
+	PianoStationIndexAdd (ph, tmpStation);
 	
 	ezxml_free (xmlDoc);
 
@@ -506,12 +648,13 @@ PianoReturn_t PianoXmlParseAddSeed (PianoHandle_t *ph, char *xml,
 }
 
 static PianoReturn_t PianoXmlParsePlaylistStruct (ezxml_t xml,
-		PianoSong_t **retSong) {
+		PianoSong_t **retSong, PianoArena_t *arena) {
 	PianoSong_t *playlist = *retSong, *tmpSong;
 	
-	if ((tmpSong = calloc (1, sizeof (*tmpSong))) == NULL) {
+	if ((tmpSong = PianoArenaNewObject (arena, sizeof (*tmpSong))) == NULL) {
 		return PIANO_RET_OUT_OF_MEMORY;
 	}
+	tmpSong->arena = arena;
 
 	PianoXmlStructParser (ezxml_child (xml, "struct"), PianoXmlParsePlaylistCb,
 			tmpSong);
@@ -540,22 +683,30 @@ PianoReturn_t PianoXmlParsePlaylist (PianoHandle_t *ph, char *xml,
 		PianoSong_t **retPlaylist) {
 	ezxml_t xmlDoc, dataNode;
 	PianoReturn_t ret = PIANO_RET_OK;
+	PianoArena_t *arena;
 
 	if ((ret = PianoXmlInitDoc (xml, &xmlDoc)) != PIANO_RET_OK) {
 		return ret;
 	}
 
+	if ((arena = PianoArenaNew ()) == NULL) {
+		ezxml_free (xmlDoc);
+		return PIANO_RET_OUT_OF_MEMORY;
+	}
+
 	dataNode = ezxml_get (xmlDoc, "params", 0, "param", 0, "value", 0, "array",
 			0, "data", -1);
 
 	for (dataNode = ezxml_child (dataNode, "value"); dataNode;
 			dataNode = dataNode->next) {
-		if ((ret = PianoXmlParsePlaylistStruct (dataNode, retPlaylist)) !=
-				PIANO_RET_OK) {
+		if ((ret = PianoXmlParsePlaylistStruct (dataNode, retPlaylist,
+				arena)) != PIANO_RET_OK) {
 			break;
 		}
 	}
 
+	/* songs keep it alive */
+	PianoArenaUnref (arena);
 	ezxml_free (xmlDoc);
 
 	return ret;
@@ -582,36 +733,59 @@ PianoReturn_t PianoXmlParseSimple (char *xml) {
  */
 static void PianoXmlParseSearchArtistCb (const char *key, const ezxml_t value,
 		void *data) {
+	enum {ARTIST_NAME, ARTIST_MUSICID};
+	static const PianoXmlKey_t keys[] = {
+		PIANO_XML_KEY ("musicId", ARTIST_MUSICID),
+		PIANO_XML_KEY ("artistName", ARTIST_NAME),
+	};
 	PianoArtist_t *artist = data;
 	char *valueStr = PianoXmlGetNodeText (value);
 
-	if (strcmp ("artistName", key) == 0) {
-		artist->name = strdup (valueStr);
-	} else if (strcmp ("musicId", key) == 0) {
-		artist->musicId = strdup (valueStr);
+	switch (PianoXmlFindKey (PIANO_XML_KEYS (keys), key)) {
+		case ARTIST_NAME:
+			artist->name = PianoArenaStrdup (artist->arena, valueStr);
+			break;
+
+		case ARTIST_MUSICID:
+			artist->musicId = PianoArenaStrdup (artist->arena, valueStr);
+			break;
 	}
 }
 
+/*	search bag, songs and artists are allocated from the response's arena
+ */
+struct PianoXmlParseSearchBag {
+	PianoSearchResult_t *searchResult;
+	PianoArena_t *arena;
+};
+
 /*	callback for xml struct parser used in PianoXmlParseSearch, "switch" for
  *	PianoXmlParseSearchArtistCb and PianoXmlParsePlaylistCb
  */
 static void PianoXmlParseSearchCb (const char *key, const ezxml_t value,
 		void *data) {
-	PianoSearchResult_t *searchResult = data;
+	enum {SEARCH_SONGS, SEARCH_ARTISTS};
+	static const PianoXmlKey_t keys[] = {
+		PIANO_XML_KEY ("songs", SEARCH_SONGS),
+		PIANO_XML_KEY ("artists", SEARCH_ARTISTS),
+	};
+	struct PianoXmlParseSearchBag *bag = data;
+	PianoSearchResult_t *searchResult = bag->searchResult;
+	const int id = PianoXmlFindKey (PIANO_XML_KEYS (keys), key);
 	ezxml_t curNode;
 
-	if (strcmp ("artists", key) == 0) {
+	if (id == SEARCH_ARTISTS) {
 		/* skip <value><array><data> */
 		for (curNode = ezxml_child (ezxml_get (value, "array", 0, "data", -1), "value");
 				curNode; curNode = curNode->next) {
 			PianoArtist_t *artist;
 			
-			if ((artist = calloc (1, sizeof (*artist))) == NULL) {
+			if ((artist = PianoArenaNewObject (bag->arena,
+					sizeof (*artist))) == NULL) {
 				/* fail silently */
 				break;
 			}
-
-			memset (artist, 0, sizeof (*artist));
+			artist->arena = bag->arena;
 
 			PianoXmlStructParser (ezxml_child (curNode, "struct"),
 					PianoXmlParseSearchArtistCb, artist);
@@ -627,11 +801,11 @@ static void PianoXmlParseSearchCb (const char *key, const ezxml_t value,
 				curArtist->next = artist;
 			}
 		}
-	} else if (strcmp ("songs", key) == 0) {
+	} else if (id == SEARCH_SONGS) {
 		for (curNode = ezxml_child (ezxml_get (value, "array", 0, "data", -1), "value");
 				curNode; curNode = curNode->next) {
-			if (PianoXmlParsePlaylistStruct (curNode, &searchResult->songs) !=
-					PIANO_RET_OK) {
+			if (PianoXmlParsePlaylistStruct (curNode, &searchResult->songs,
+					bag->arena) != PIANO_RET_OK) {
 				break;
 			}
 		}
@@ -647,16 +821,23 @@ PianoReturn_t PianoXmlParseSearch (char *xml,
 		PianoSearchResult_t *searchResult) {
 	ezxml_t xmlDoc, dataNode;
 	PianoReturn_t ret;
+	struct PianoXmlParseSearchBag bag = {searchResult, NULL};
 
 	if ((ret = PianoXmlInitDoc (xml, &xmlDoc)) != PIANO_RET_OK) {
 		return ret;
 	}
+
+	if ((bag.arena = PianoArenaNew ()) == NULL) {
+		ezxml_free (xmlDoc);
+		return PIANO_RET_OUT_OF_MEMORY;
+	}
 	
 	dataNode = ezxml_get (xmlDoc, "params", 0, "param", 0, "value", 0, "struct", -1);
 	/* we need a "clean" search result (with null pointers) */
 	memset (searchResult, 0, sizeof (*searchResult));
-	PianoXmlStructParser (dataNode, PianoXmlParseSearchCb, searchResult);
+	PianoXmlStructParser (dataNode, PianoXmlParseSearchCb, &bag);
 
+	PianoArenaUnref (bag.arena);
 	ezxml_free (xmlDoc);
 
 	return PIANO_RET_OK;
@@ -668,17 +849,24 @@ PianoReturn_t PianoXmlParseSeedSuggestions (char *xml,
 		PianoSearchResult_t *searchResult) {
 	ezxml_t xmlDoc, dataNode;
 	PianoReturn_t ret;
+	struct PianoXmlParseSearchBag bag = {searchResult, NULL};
 
 	if ((ret = PianoXmlInitDoc (xml, &xmlDoc)) != PIANO_RET_OK) {
 		return ret;
 	}
+
+	if ((bag.arena = PianoArenaNew ()) == NULL) {
+		ezxml_free (xmlDoc);
+		return PIANO_RET_OUT_OF_MEMORY;
+	}
 	
 	dataNode = ezxml_get (xmlDoc, "params", 0, "param", 0, "value", -1);
 	/* we need a "clean" search result (with null pointers) */
 	memset (searchResult, 0, sizeof (*searchResult));
 	/* reuse seach result parser; structure is nearly the same */
-	PianoXmlParseSearchCb ("artists", dataNode, searchResult);
+	PianoXmlParseSearchCb ("artists", dataNode, &bag);
 
+	PianoArenaUnref (bag.arena);
 	ezxml_free (xmlDoc);
 
 	return PIANO_RET_OK;
@@ -838,11 +1026,19 @@ struct PianoXmlParseSeedBag {
  */
 static void PianoXmlParseSeedCb (const char *key, const ezxml_t value,
 		void *data) {
+	enum {SEED_SONG, SEED_ARTIST, SEED_SEEDID, SEED_NONGENOMESTATION};
+	static const PianoXmlKey_t keys[] = {
+		PIANO_XML_KEY ("song", SEED_SONG),
+		PIANO_XML_KEY ("artist", SEED_ARTIST),
+		PIANO_XML_KEY ("seedId", SEED_SEEDID),
+		PIANO_XML_KEY ("nonGenomeStation", SEED_NONGENOMESTATION),
+	};
 	struct PianoXmlParseSeedBag *bag = data;
+	const int id = PianoXmlFindKey (PIANO_XML_KEYS (keys), key);
 
 	assert (bag != NULL);
 
-	if (strcmp ("song", key) == 0) {
+	if (id == SEED_SONG) {
 		assert (bag->song == NULL);
 
 		if ((bag->song = calloc (1, sizeof (*bag->song))) == NULL) {
@@ -851,7 +1047,7 @@ static void PianoXmlParseSeedCb (const char *key, const ezxml_t value,
 
 		PianoXmlStructParser (ezxml_child (value, "struct"),
 				PianoXmlParsePlaylistCb, bag->song);
-	} else if (strcmp ("artist", key) == 0) {
+	} else if (id == SEED_ARTIST) {
 		assert (bag->artist == NULL);
 
 		if ((bag->artist = calloc (1, sizeof (*bag->artist))) == NULL) {
@@ -860,7 +1056,7 @@ static void PianoXmlParseSeedCb (const char *key, const ezxml_t value,
 
 		PianoXmlStructParser (ezxml_child (value, "struct"),
 				PianoXmlParseSearchArtistCb, bag->artist);
-	} else if (strcmp ("nonGenomeStation", key) == 0) {
+	} else if (id == SEED_NONGENOMESTATION) {
 		/* genre stations are "non genome" station seeds */
 		assert (bag->station == NULL);
 
@@ -870,7 +1066,7 @@ static void PianoXmlParseSeedCb (const char *key, const ezxml_t value,
 
 		PianoXmlStructParser (ezxml_child (value, "struct"),
 				PianoXmlParseStationsCb, bag->station);
-	} else if (strcmp ("seedId", key) == 0) {
+	} else if (id == SEED_SEEDID) {
 		char *valueStr = PianoXmlGetNodeText (value);
 		bag->seedId = strdup (valueStr);
 	}
@@ -880,9 +1076,15 @@ static void PianoXmlParseSeedCb (const char *key, const ezxml_t value,
  */
 static void PianoXmlParseGetStationInfoCb (const char *key, const ezxml_t value,
 		void *data) {
+	enum {INFO_SEEDS, INFO_FEEDBACK};
+	static const PianoXmlKey_t keys[] = {
+		PIANO_XML_KEY ("seeds", INFO_SEEDS),
+		PIANO_XML_KEY ("feedback", INFO_FEEDBACK),
+	};
 	PianoStationInfo_t *info = data;
+	const int id = PianoXmlFindKey (PIANO_XML_KEYS (keys), key);
 
-	if (strcmp ("seeds", key) == 0) {
+	if (id == INFO_SEEDS) {
 		const ezxml_t dataNode = ezxml_get (value, "array", 0, "data", -1);
 		for (ezxml_t seedNode = ezxml_child (dataNode, "value"); seedNode;
 					seedNode = seedNode->next) {
@@ -941,12 +1143,12 @@ static void PianoXmlParseGetStationInfoCb (const char *key, const ezxml_t value,
 				free (bag.seedId);
 			}
 		}
-	} else if (strcmp ("feedback", key) == 0) {
+	} else if (id == INFO_FEEDBACK) {
 		const ezxml_t dataNode = ezxml_get (value, "array", 0, "data", -1);
 		for (ezxml_t feedbackNode = ezxml_child (dataNode, "value"); feedbackNode;
 					feedbackNode = feedbackNode->next) {
-			if (PianoXmlParsePlaylistStruct (feedbackNode, &info->feedback) !=
-					PIANO_RET_OK) {
+			if (PianoXmlParsePlaylistStruct (feedbackNode, &info->feedback,
+					NULL) != PIANO_RET_OK) {
 				break;
 			}
 		}
@@ -972,3 +1174,211 @@ PianoReturn_t PianoXmlParseGetStationInfo (char *xml,
 	return PIANO_RET_OK;
 }
 
+
+/* incremental playlist/station list parser state */
+struct PianoXmlStreamBag {
+	PianoXmlStream_t stream;
+	PianoArena_t *arena;
+	/* song or station being parsed */
+	PianoSong_t *songs, **songsTail, *song;
+	PianoStation_t *stations, **stationsTail, *station;
+	/* quickmix station ids, strings owned by arena */
+	char **quickMixIds;
+	size_t quickMixIdsN, quickMixIdsSize;
+};
+
+/*	stream callback, every struct on the first level is a song
+ */
+static void PianoXmlStreamPlaylistBegin (PianoXmlStream_t *s,
+		unsigned int depth, const char *key) {
+	struct PianoXmlStreamBag *bag = s->data;
+	PianoSong_t *song;
+
+	(void) key;
+
+	if (depth != 1 || s->fault) {
+		return;
+	}
+	if ((song = PianoArenaNewObject (bag->arena, sizeof (*song))) == NULL) {
+		s->ret = PIANO_RET_OUT_OF_MEMORY;
+		bag->song = NULL;
+		return;
+	}
+	song->arena = bag->arena;
+	*bag->songsTail = song;
+	bag->songsTail = &song->next;
+	bag->song = song;
+}
+
+static void PianoXmlStreamPlaylistValue (PianoXmlStream_t *s,
+		unsigned int depth, const char *key, char *value) {
+	struct PianoXmlStreamBag *bag = s->data;
+
+	if (depth != 1 || key == NULL) {
+		/* nested or outside of any member (malformed) */
+		return;
+	}
+	if (s->fault) {
+		PianoXmlParseFault (key, value, &s->ret);
+	} else if (bag->song != NULL) {
+		PianoXmlParsePlaylistValue (key, value, bag->song);
+	}
+}
+
+/*	stream callback, every struct on the first level is a station
+ */
+static void PianoXmlStreamStationsBegin (PianoXmlStream_t *s,
+		unsigned int depth, const char *key) {
+	struct PianoXmlStreamBag *bag = s->data;
+	PianoStation_t *station;
+
+	(void) key;
+
+	if (depth != 1 || s->fault) {
+		return;
+	}
+	if ((station = PianoArenaNewObject (bag->arena,
+			sizeof (*station))) == NULL) {
+		s->ret = PIANO_RET_OUT_OF_MEMORY;
+		bag->station = NULL;
+		return;
+	}
+	station->arena = bag->arena;
+	*bag->stationsTail = station;
+	bag->stationsTail = &station->next;
+	bag->station = station;
+}
+
+static void PianoXmlStreamStationsValue (PianoXmlStream_t *s,
+		unsigned int depth, const char *key, char *value) {
+	struct PianoXmlStreamBag *bag = s->data;
+
+	if (depth != 1 || key == NULL) {
+		/* nested or outside of any member (malformed) */
+		return;
+	}
+	if (s->fault) {
+		PianoXmlParseFault (key, value, &s->ret);
+	} else if (bag->station != NULL) {
+		if (strcmp (key, "quickMixStationIds") == 0) {
+			/* resolved when all stations are known */
+			if (bag->quickMixIdsN == bag->quickMixIdsSize) {
+				const size_t newSize = bag->quickMixIdsSize == 0 ? 16 :
+						bag->quickMixIdsSize * 2;
+				char **newIds;
+				if ((newIds = realloc (bag->quickMixIds,
+						newSize * sizeof (*newIds))) == NULL) {
+					s->ret = PIANO_RET_OUT_OF_MEMORY;
+					return;
+				}
+				bag->quickMixIds = newIds;
+				bag->quickMixIdsSize = newSize;
+			}
+			if ((bag->quickMixIds[bag->quickMixIdsN] = PianoArenaStrdup (
+					bag->arena, value)) != NULL) {
+				++bag->quickMixIdsN;
+			}
+		} else {
+			PianoXmlParseStationsValue (key, value, bag->station);
+		}
+	}
+}
+
+/*	create incremental parser for getFragment/getStations responses
+ *	@param PIANO_REQUEST_GET_PLAYLIST or _GET_STATIONS
+ *	@return parser or NULL
+ */
+PianoXmlStream_t *PianoXmlStreamNew (PianoRequestType_t type) {
+	struct PianoXmlStreamBag *bag;
+
+	assert (type == PIANO_REQUEST_GET_PLAYLIST ||
+			type == PIANO_REQUEST_GET_STATIONS);
+
+	if ((bag = calloc (1, sizeof (*bag))) == NULL) {
+		return NULL;
+	}
+	if ((bag->arena = PianoArenaNew ()) == NULL) {
+		free (bag);
+		return NULL;
+	}
+	bag->songsTail = &bag->songs;
+	bag->stationsTail = &bag->stations;
+
+	if (type == PIANO_REQUEST_GET_PLAYLIST) {
+		bag->stream.structBegin = PianoXmlStreamPlaylistBegin;
+		bag->stream.value = PianoXmlStreamPlaylistValue;
+	} else {
+		bag->stream.structBegin = PianoXmlStreamStationsBegin;
+		bag->stream.value = PianoXmlStreamStationsValue;
+	}
+	bag->stream.data = bag;
+	PianoXmlStreamInit (&bag->stream);
+
+	return &bag->stream;
+}
+
+/*	finish incremental getFragment parser
+ *	@param parser
+ *	@param return: playlist
+ *	@return _RET_OK or error
+ */
+PianoReturn_t PianoXmlStreamFinishPlaylist (PianoXmlStream_t *s,
+		PianoSong_t **retPlaylist) {
+	struct PianoXmlStreamBag *bag = s->data;
+	PianoReturn_t ret;
+
+	if ((ret = PianoXmlStreamFinish (s)) == PIANO_RET_OK) {
+		*retPlaylist = bag->songs;
+		bag->songs = NULL;
+	}
+	return ret;
+}
+
+/*	finish incremental getStations parser, appends stations to ph
+ *	@param piano handle
+ *	@param parser
+ *	@return _RET_OK or error
+ */
+PianoReturn_t PianoXmlStreamFinishStations (PianoHandle_t *ph,
+		PianoXmlStream_t *s) {
+	struct PianoXmlStreamBag *bag = s->data;
+	PianoStation_t **tail = &ph->stations;
+	PianoReturn_t ret;
+	size_t i;
+
+	if ((ret = PianoXmlStreamFinish (s)) != PIANO_RET_OK) {
+		return ret;
+	}
+
+	while (*tail != NULL) {
+		tail = &(*tail)->next;
+	}
+	*tail = bag->stations;
+	bag->stations = NULL;
+	PianoRebuildStationIndex (ph);
+
+	for (i = 0; i < bag->quickMixIdsN; i++) {
+		PianoStation_t *curStation = PianoFindStationById (ph,
+				bag->quickMixIds[i]);
+		if (curStation != NULL) {
+			curStation->useQuickMix = 1;
+		}
+	}
+
+	return PIANO_RET_OK;
+}
+
+/*	free incremental parser and everything not taken by _Finish*
+ *	@param parser
+ */
+void PianoXmlStreamFree (PianoXmlStream_t *s) {
+	struct PianoXmlStreamBag *bag = s->data;
+
+	PianoDestroyPlaylist (bag->songs);
+	PianoDestroyStations (bag->stations);
+	free (bag->quickMixIds);
+	/* songs and stations keep it alive */
+	PianoArenaUnref (bag->arena);
+	PianoXmlStreamDestroy (s);
+	free (bag);
+}
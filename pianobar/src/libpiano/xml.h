@@ -25,6 +25,7 @@ THE SOFTWARE.
 #define _XML_H
 
 #include "piano.h"
+#include "xmlstream.h"
 
 PianoReturn_t PianoXmlParseUserinfo (PianoHandle_t *ph, const char *xml);
 PianoReturn_t PianoXmlParseStations (PianoHandle_t *ph, const char *xml);
@@ -44,6 +45,13 @@ PianoReturn_t PianoXmlParseNarrative (const char *xml, char **retNarrative);
 PianoReturn_t PianoXmlParseSeedSuggestions (char *, PianoSearchResult_t *);
 PianoReturn_t PianoXmlParseGetStationInfo (char *, PianoStationInfo_t *);
 
+PianoXmlStream_t *PianoXmlStreamNew (PianoRequestType_t);
+PianoReturn_t PianoXmlStreamFinishPlaylist (PianoXmlStream_t *,
+		PianoSong_t **);
+PianoReturn_t PianoXmlStreamFinishStations (PianoHandle_t *,
+		PianoXmlStream_t *);
+void PianoXmlStreamFree (PianoXmlStream_t *);
+
 char *PianoXmlEncodeString (const char *s);
 
 #endif /* _XML_H */
@@ -0,0 +1,561 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "xmlstream.h"
+
+/* tokenizer states */
+enum {
+	STREAM_TEXT = 0,
+	STREAM_TAG_START,
+	STREAM_TAG_NAME,
+	STREAM_TAG_ATTRS,
+	STREAM_MARKUP,
+	STREAM_COMMENT,
+	STREAM_CDATA,
+	STREAM_SKIP,
+	STREAM_ERROR,
+};
+
+/* element kinds; everything inside <value> that is neither <struct> nor
+ * <array> is a scalar type (<string>, <int>, <boolean>, ...) */
+enum {
+	ELEMENT_OTHER = 0,
+	ELEMENT_METHODRESPONSE,
+	ELEMENT_PARAMS,
+	ELEMENT_PARAM,
+	ELEMENT_FAULT,
+	ELEMENT_VALUE,
+	ELEMENT_STRUCT,
+	ELEMENT_MEMBER,
+	ELEMENT_NAME,
+	ELEMENT_ARRAY,
+	ELEMENT_DATA,
+};
+
+#define TEXT_SIZE_MIN 256
+
+/*	tokenizer failed, ignore the rest of the document
+ *	@param stream
+ *	@param error code
+ */
+static void PianoXmlStreamError (PianoXmlStream_t *s, PianoReturn_t ret) {
+	s->state = STREAM_ERROR;
+	s->ret = ret;
+	s->scalar = s->capture = false;
+}
+
+/*	append to text buffer
+ *	@param stream
+ *	@param text
+ *	@param length
+ */
+static void PianoXmlStreamAppend (PianoXmlStream_t *s, const char *text,
+		size_t len) {
+	if (s->textN + len + 1 > s->textSize) {
+		size_t newSize = s->textSize == 0 ? TEXT_SIZE_MIN : s->textSize;
+		char *newText;
+
+		while (s->textN + len + 1 > newSize) {
+			newSize *= 2;
+		}
+		if ((newText = realloc (s->text, newSize)) == NULL) {
+			PianoXmlStreamError (s, PIANO_RET_OUT_OF_MEMORY);
+			return;
+		}
+		s->text = newText;
+		s->textSize = newSize;
+	}
+	memcpy (&s->text[s->textN], text, len);
+	s->textN += len;
+}
+
+/*	write unicode code point as utf-8
+ *	@param destination, at least four bytes
+ *	@param code point
+ *	@return bytes written
+ */
+static size_t PianoXmlStreamUtf8 (char *dest, unsigned long c) {
+	if (c < 0x80) {
+		dest[0] = c;
+		return 1;
+	} else if (c < 0x800) {
+		dest[0] = 0xc0 | (c >> 6);
+		dest[1] = 0x80 | (c & 0x3f);
+		return 2;
+	} else if (c < 0x10000) {
+		dest[0] = 0xe0 | (c >> 12);
+		dest[1] = 0x80 | ((c >> 6) & 0x3f);
+		dest[2] = 0x80 | (c & 0x3f);
+		return 3;
+	} else {
+		dest[0] = 0xf0 | ((c >> 18) & 0x07);
+		dest[1] = 0x80 | ((c >> 12) & 0x3f);
+		dest[2] = 0x80 | ((c >> 6) & 0x3f);
+		dest[3] = 0x80 | (c & 0x3f);
+		return 4;
+	}
+}
+
+/*	decode entities of collected text in place, unknown entities are kept
+ *	@param stream
+ *	@return \0-terminated text
+ */
+static char *PianoXmlStreamText (PianoXmlStream_t *s) {
+	static const struct {
+		const char *name;
+		size_t len;
+		char c;
+	} entities[] = {
+		{"lt;", 3, '<'},
+		{"gt;", 3, '>'},
+		{"amp;", 4, '&'},
+		{"quot;", 5, '"'},
+		{"apos;", 5, '\''},
+	};
+	char *in, *out, *end;
+
+	/* <value/> never appended anything */
+	if (s->text == NULL) {
+		return "";
+	}
+	s->text[s->textN] = '\0';
+
+	if ((in = memchr (s->text, '&', s->textN)) == NULL) {
+		return s->text;
+	}
+	out = in;
+	end = &s->text[s->textN];
+	while (in < end) {
+		if (*in != '&') {
+			*out++ = *in++;
+			continue;
+		}
+
+		if (in[1] == '#') {
+			char *numEnd;
+			const unsigned long c = (in[2] == 'x') ?
+					strtoul (&in[3], &numEnd, 16) :
+					strtoul (&in[2], &numEnd, 10);
+			if (*numEnd == ';' && c > 0 && c <= 0x10ffff) {
+				out += PianoXmlStreamUtf8 (out, c);
+				in = numEnd + 1;
+				continue;
+			}
+		} else {
+			size_t i;
+			for (i = 0; i < sizeof (entities) / sizeof (*entities); i++) {
+				if (strncmp (&in[1], entities[i].name, entities[i].len) == 0) {
+					break;
+				}
+			}
+			if (i < sizeof (entities) / sizeof (*entities)) {
+				*out++ = entities[i].c;
+				in += entities[i].len + 1;
+				continue;
+			}
+		}
+		*out++ = *in++;
+	}
+	*out = '\0';
+	s->textN = out - s->text;
+
+	return s->text;
+}
+
+/*	map tag name to element kind
+ *	@param stream
+ *	@return ELEMENT_*
+ */
+static unsigned char PianoXmlStreamElement (const PianoXmlStream_t *s) {
+	static const struct {
+		const char *name;
+		unsigned char element;
+	} elements[] = {
+		{"value", ELEMENT_VALUE},
+		{"member", ELEMENT_MEMBER},
+		{"name", ELEMENT_NAME},
+		{"struct", ELEMENT_STRUCT},
+		{"array", ELEMENT_ARRAY},
+		{"data", ELEMENT_DATA},
+		{"param", ELEMENT_PARAM},
+		{"params", ELEMENT_PARAMS},
+		{"fault", ELEMENT_FAULT},
+		{"methodResponse", ELEMENT_METHODRESPONSE},
+	};
+	size_t i;
+
+	if (s->tagTruncated) {
+		return ELEMENT_OTHER;
+	}
+	for (i = 0; i < sizeof (elements) / sizeof (*elements); i++) {
+		if (strcmp (s->tag, elements[i].name) == 0) {
+			return elements[i].element;
+		}
+	}
+	return ELEMENT_OTHER;
+}
+
+/*	element was opened
+ *	@param stream
+ *	@param element kind
+ */
+static void PianoXmlStreamOpen (PianoXmlStream_t *s, unsigned char element) {
+	const unsigned char parent = s->elementsN > 0 ?
+			s->elements[s->elementsN-1] : ELEMENT_OTHER;
+
+	if (s->elementsN >= PIANO_XML_STREAM_DEPTH) {
+		PianoXmlStreamError (s, PIANO_RET_XML_INVALID);
+		return;
+	}
+	if (s->elementsN == 0) {
+		if (element != ELEMENT_METHODRESPONSE || s->seenRoot) {
+			PianoXmlStreamError (s, PIANO_RET_XML_INVALID);
+			return;
+		}
+		s->seenRoot = true;
+	}
+	s->elements[s->elementsN++] = element;
+
+	switch (element) {
+		case ELEMENT_FAULT:
+			s->fault = true;
+			break;
+
+		case ELEMENT_VALUE:
+			/* scalar until proven otherwise */
+			s->scalar = s->capture = true;
+			s->textN = 0;
+			break;
+
+		case ELEMENT_STRUCT:
+			s->scalar = s->capture = false;
+			if (s->structDepth >= PIANO_XML_STREAM_STRUCTS) {
+				PianoXmlStreamError (s, PIANO_RET_XML_INVALID);
+				return;
+			}
+			++s->structDepth;
+			if (s->structBegin != NULL) {
+				s->structBegin (s, s->structDepth, s->structDepth > 1 ?
+						s->keys[s->structDepth-1] : NULL);
+			}
+			break;
+
+		case ELEMENT_ARRAY:
+			s->scalar = s->capture = false;
+			break;
+
+		case ELEMENT_MEMBER:
+			s->keys[s->structDepth][0] = '\0';
+			break;
+
+		case ELEMENT_NAME:
+			s->capture = true;
+			s->textN = 0;
+			break;
+
+		default:
+			if (parent == ELEMENT_VALUE && s->scalar) {
+				/* <value> <string>: drop whitespace in front of the type */
+				s->textN = 0;
+			}
+			break;
+	}
+}
+
+/*	element was closed
+ *	@param stream
+ *	@param element kind
+ */
+static void PianoXmlStreamClose (PianoXmlStream_t *s, unsigned char element) {
+	if (s->elementsN == 0 || s->elements[s->elementsN-1] != element) {
+		PianoXmlStreamError (s, PIANO_RET_XML_INVALID);
+		return;
+	}
+	--s->elementsN;
+
+	switch (element) {
+		case ELEMENT_VALUE:
+			if (s->scalar) {
+				const char *key = s->structDepth > 0 ?
+						s->keys[s->structDepth] : NULL;
+				char *text = PianoXmlStreamText (s);
+
+				s->scalar = s->capture = false;
+				/* same as the dom parser: members without name are ignored */
+				if (key == NULL || *key != '\0') {
+					s->value (s, s->structDepth, key, text);
+				}
+			}
+			break;
+
+		case ELEMENT_STRUCT:
+			if (s->structEnd != NULL) {
+				s->structEnd (s, s->structDepth);
+			}
+			--s->structDepth;
+			break;
+
+		case ELEMENT_NAME: {
+			const char *text = PianoXmlStreamText (s);
+			char *key = s->keys[s->structDepth];
+			size_t len = strlen (text);
+
+			if (len >= PIANO_XML_STREAM_KEY) {
+				len = PIANO_XML_STREAM_KEY - 1;
+			}
+			memcpy (key, text, len);
+			key[len] = '\0';
+			s->capture = false;
+			break;
+		}
+
+		default:
+			/* </string>: whitespace up to </value> is not part of it */
+			if (s->elementsN > 0 && s->elements[s->elementsN-1] ==
+					ELEMENT_VALUE) {
+				s->capture = false;
+			}
+			break;
+	}
+}
+
+/*	complete tag read
+ *	@param stream
+ */
+static void PianoXmlStreamTag (PianoXmlStream_t *s) {
+	unsigned char element;
+
+	s->tag[s->tagN] = '\0';
+	element = PianoXmlStreamElement (s);
+	if (s->tagClose) {
+		PianoXmlStreamClose (s, element);
+	} else {
+		PianoXmlStreamOpen (s, element);
+		if (s->tagEmpty && s->state != STREAM_ERROR) {
+			PianoXmlStreamClose (s, element);
+		}
+	}
+}
+
+/*	reset stream
+ *	@param stream, callbacks and data are kept
+ */
+void PianoXmlStreamInit (PianoXmlStream_t *s) {
+	void (*value) (struct PianoXmlStream *, unsigned int, const char *,
+			char *) = s->value;
+	void (*structBegin) (struct PianoXmlStream *, unsigned int,
+			const char *) = s->structBegin;
+	void (*structEnd) (struct PianoXmlStream *, unsigned int) = s->structEnd;
+	void *data = s->data;
+
+	assert (value != NULL);
+
+	memset (s, 0, sizeof (*s));
+	s->value = value;
+	s->structBegin = structBegin;
+	s->structEnd = structEnd;
+	s->data = data;
+	s->ret = PIANO_RET_OK;
+	s->state = STREAM_TEXT;
+}
+
+/*	parse next part of document, data may be split anywhere
+ *	@param stream
+ *	@param data
+ *	@param data size
+ *	@return _RET_OK or error (everything after an error is ignored)
+ */
+PianoReturn_t PianoXmlStreamFeed (PianoXmlStream_t *s, const char *data,
+		size_t size) {
+	const char *end = data + size;
+
+	while (data < end && s->state != STREAM_ERROR) {
+		const char c = *data;
+
+		switch (s->state) {
+			case STREAM_TEXT: {
+				/* copy everything up to the next tag at once */
+				const char *lt = memchr (data, '<', end - data);
+				const char *textEnd = lt != NULL ? lt : end;
+
+				if (s->capture) {
+					PianoXmlStreamAppend (s, data, textEnd - data);
+				}
+				data = textEnd;
+				if (lt != NULL) {
+					s->state = STREAM_TAG_START;
+					++data;
+				}
+				continue;
+			}
+
+			case STREAM_TAG_START:
+				s->tagN = 0;
+				s->tagClose = s->tagEmpty = s->tagTruncated = false;
+				if (c == '/') {
+					s->tagClose = true;
+					s->state = STREAM_TAG_NAME;
+				} else if (c == '!') {
+					/* comment, cdata section or declaration */
+					s->markup = NULL;
+					s->matchN = 0;
+					s->state = STREAM_MARKUP;
+				} else if (c == '?') {
+					/* processing instruction */
+					s->state = STREAM_SKIP;
+				} else {
+					s->state = STREAM_TAG_NAME;
+					continue;
+				}
+				break;
+
+			case STREAM_TAG_NAME:
+				if (c == '>') {
+					s->state = STREAM_TEXT;
+					PianoXmlStreamTag (s);
+				} else if (c == '/') {
+					s->tagEmpty = true;
+					s->state = STREAM_TAG_ATTRS;
+				} else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+					s->state = STREAM_TAG_ATTRS;
+				} else if (s->tagN < sizeof (s->tag) - 1) {
+					s->tag[s->tagN++] = c;
+				} else {
+					s->tagTruncated = true;
+				}
+				break;
+
+			case STREAM_TAG_ATTRS:
+				/* xml-rpc has no attributes, just look for /> */
+				if (c == '>') {
+					s->state = STREAM_TEXT;
+					PianoXmlStreamTag (s);
+				} else if (c == '/') {
+					s->tagEmpty = true;
+				} else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+					s->tagEmpty = false;
+				}
+				break;
+
+			case STREAM_MARKUP: {
+				static const char comment[] = "--", cdata[] = "[CDATA[";
+
+				if (s->matchN == 0) {
+					s->markup = (c == '-') ? comment :
+							((c == '[') ? cdata : NULL);
+				}
+				if (s->markup == NULL || s->markup[s->matchN] != c) {
+					/* declaration, e.g. <!DOCTYPE ...> */
+					s->state = (c == '>') ? STREAM_TEXT : STREAM_SKIP;
+				} else if (s->markup[++s->matchN] == '\0') {
+					s->state = (s->markup == comment) ? STREAM_COMMENT :
+							STREAM_CDATA;
+					s->matchN = 0;
+				}
+				break;
+			}
+
+			case STREAM_COMMENT:
+				/* may contain >, ends with --> */
+				if (c == '>' && s->matchN >= 2) {
+					s->state = STREAM_TEXT;
+				} else if (c == '-') {
+					++s->matchN;
+				} else {
+					s->matchN = 0;
+				}
+				break;
+
+			case STREAM_CDATA:
+				/* literal text, ends with ]]> */
+				if (c == ']') {
+					++s->matchN;
+					break;
+				}
+				if (c == '>' && s->matchN >= 2) {
+					s->matchN -= 2;
+					s->state = STREAM_TEXT;
+				}
+				if (s->capture) {
+					/* ] that did not end the section */
+					for (; s->matchN > 0; --s->matchN) {
+						PianoXmlStreamAppend (s, "]", 1);
+					}
+					if (s->state == STREAM_CDATA) {
+						/* entities are decoded later, keep & as it is */
+						if (c == '&') {
+							PianoXmlStreamAppend (s, "&amp;", 5);
+						} else {
+							PianoXmlStreamAppend (s, &c, 1);
+						}
+					}
+				}
+				s->matchN = 0;
+				break;
+
+			case STREAM_SKIP:
+				if (c == '>') {
+					s->state = STREAM_TEXT;
+				}
+				break;
+
+			default:
+				assert (0);
+				break;
+		}
+		++data;
+	}
+
+	return s->state == STREAM_ERROR ? s->ret : PIANO_RET_OK;
+}
+
+/*	document is complete
+ *	@param stream
+ *	@return _RET_OK, fault code stored by a callback or error
+ */
+PianoReturn_t PianoXmlStreamFinish (PianoXmlStream_t *s) {
+	if (s->state == STREAM_ERROR) {
+		return s->ret;
+	}
+	if (!s->seenRoot || s->elementsN != 0 || s->state != STREAM_TEXT) {
+		return PIANO_RET_XML_INVALID;
+	}
+	if (s->fault && s->ret == PIANO_RET_OK) {
+		/* no faultString */
+		return PIANO_RET_ERR;
+	}
+	return s->ret;
+}
+
+/*	free stream buffers
+ *	@param stream
+ */
+void PianoXmlStreamDestroy (PianoXmlStream_t *s) {
+	free (s->text);
+	s->text = NULL;
+	s->textN = s->textSize = 0;
+}
@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _XMLSTREAM_H
+#define _XMLSTREAM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "piano.h"
+
+/* open elements */
+#define PIANO_XML_STREAM_DEPTH 32
+/* open <struct>s */
+#define PIANO_XML_STREAM_STRUCTS 8
+/* longer member names are truncated, none of them is known to libpiano */
+#define PIANO_XML_STREAM_KEY 64
+
+/* event driven xml-rpc reader; turns <struct>/<member>/<value> into
+ * callbacks while the response is still coming in, no dom is built.
+ * struct depth counts open <struct>s, key is the name of the innermost
+ * <member> (elements of arrays get the name of the member holding the
+ * array) or NULL outside of any struct. */
+typedef struct PianoXmlStream {
+	/* scalar value, may be modified by the callback */
+	void (*value) (struct PianoXmlStream *, unsigned int, const char *,
+			char *);
+	/* optional, <struct> opened/closed */
+	void (*structBegin) (struct PianoXmlStream *, unsigned int,
+			const char *);
+	void (*structEnd) (struct PianoXmlStream *, unsigned int);
+	/* extra data for callbacks */
+	void *data;
+
+	/* document is a <fault> response */
+	bool fault;
+	/* result; callbacks store fault codes here */
+	PianoReturn_t ret;
+
+	/* tokenizer state */
+	unsigned char state;
+	bool tagClose, tagEmpty, tagTruncated;
+	char tag[16];
+	size_t tagN;
+	/* <!-- or <![CDATA[ being recognized, progress of a terminator */
+	const char *markup;
+	size_t matchN;
+	unsigned char elements[PIANO_XML_STREAM_DEPTH];
+	size_t elementsN;
+	bool seenRoot;
+	unsigned int structDepth;
+	char keys[PIANO_XML_STREAM_STRUCTS+1][PIANO_XML_STREAM_KEY];
+	/* current <value> has no <struct> or <array>, text is collected */
+	bool scalar, capture;
+	/* collected text of current <name> or scalar <value> */
+	char *text;
+	size_t textN, textSize;
+} PianoXmlStream_t;
+
+void PianoXmlStreamInit (PianoXmlStream_t *);
+PianoReturn_t PianoXmlStreamFeed (PianoXmlStream_t *, const char *, size_t);
+PianoReturn_t PianoXmlStreamFinish (PianoXmlStream_t *);
+void PianoXmlStreamDestroy (PianoXmlStream_t *);
+
+#endif /* _XMLSTREAM_H */
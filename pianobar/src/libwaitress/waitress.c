@@ -48,6 +48,12 @@ THE SOFTWARE.
 #define strcaseeq(a,b) (strcasecmp(a,b) == 0)
 #define WAITRESS_HTTP_VERSION "1.1"
 
+/* pipelined requests may be written after the server closed the connection,
+ * that's an error, not a reason to die */
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 typedef struct {
 	char *data;
 	size_t pos;
@@ -461,7 +467,8 @@ static ssize_t WaitressPollWrite (void *data, const void *buf, size_t count) {
 		waith->request.readWriteRet = WAITRESS_RET_ERR;
 		return -1;
 	}
-	if ((retSize = write (waith->request.sockfd, buf, count)) == -1) {
+	if ((retSize = send (waith->request.sockfd, buf, count,
+			MSG_NOSIGNAL)) == -1) {
 		waith->request.readWriteRet = WAITRESS_RET_ERR;
 		return -1;
 	}
@@ -472,8 +479,17 @@ static ssize_t WaitressPollWrite (void *data, const void *buf, size_t count) {
 static WaitressReturn_t WaitressOrdinaryWrite (void *data, const char *buf,
 		const size_t size) {
 	WaitressHandle_t *waith = data;
+	size_t written = 0;
 
-	WaitressPollWrite (waith, buf, size);
+	/* non-blocking socket, writes may be partial */
+	while (written < size) {
+		const ssize_t ret = WaitressPollWrite (waith, &buf[written],
+				size - written);
+		if (ret == -1) {
+			break;
+		}
+		written += ret;
+	}
 	return waith->request.readWriteRet;
 }
 
@@ -623,8 +639,8 @@ static WaitressHandlerReturn_t WaitressHandleIdentity (void *data, char *buf,
 	}
 }
 
-/*	chunked encoding handler. buf must be \0-terminated, size does not include
- *	trailing \0.
+/*	chunked encoding handler. lines may be split across reads, an incomplete
+ *	chunk size line is kept until it is complete
  */
 static WaitressHandlerReturn_t WaitressHandleChunked (void *data, char *buf,
 		const size_t size) {
@@ -632,55 +648,57 @@ static WaitressHandlerReturn_t WaitressHandleChunked (void *data, char *buf,
 	assert (buf != NULL);
 
 	WaitressHandle_t *waith = data;
-	char *content = buf, *nextContent;
-
-	assert (waith != NULL);
-	assert (buf != NULL);
+	char *content = buf;
+	const char * const end = buf + size;
 
-	while (1) {
+	while (content < end) {
 		if (waith->request.chunkSize > 0) {
-			const size_t remaining = size-(content-buf);
+			const size_t remaining = end - content;
+			const size_t handle = remaining < waith->request.chunkSize ?
+					remaining : waith->request.chunkSize;
 
-			if (remaining >= waith->request.chunkSize) {
-				if (WaitressHandleIdentity (waith, content,
-						waith->request.chunkSize) == WAITRESS_HANDLER_ABORTED) {
-					return WAITRESS_HANDLER_ABORTED;
-				}
-
-				content += waith->request.chunkSize;
-				if (content[0] == '\r' && content[1] == '\n') {
-					content += 2;
-				} else {
-					return WAITRESS_HANDLER_ERR;
-				}
-				waith->request.chunkSize = 0;
-			} else {
-				if (WaitressHandleIdentity (waith, content, remaining) ==
-						WAITRESS_HANDLER_ABORTED) {
-					return WAITRESS_HANDLER_ABORTED;
-				}
-				waith->request.chunkSize -= remaining;
+			if (WaitressHandleIdentity (waith, content, handle) ==
+					WAITRESS_HANDLER_ABORTED) {
+				return WAITRESS_HANDLER_ABORTED;
+			}
+			content += handle;
+			waith->request.chunkSize -= handle;
+		} else {
+			/* chunk size line, or the empty line following chunk data */
+			const char *eol = memchr (content, '\n', end - content);
+			const size_t lineSize = (eol == NULL ? end : eol + 1) - content;
+			char *line = waith->request.chunkLine, *sizeEnd;
+			long int chunkSize;
+
+			if (waith->request.chunkLineLen + lineSize >=
+					sizeof (waith->request.chunkLine)) {
+				return WAITRESS_HANDLER_ERR;
+			}
+			memcpy (&line[waith->request.chunkLineLen], content, lineSize);
+			waith->request.chunkLineLen += lineSize;
+			line[waith->request.chunkLineLen] = '\0';
+			content += lineSize;
+			if (eol == NULL) {
 				return WAITRESS_HANDLER_CONTINUE;
 			}
-		}
+			waith->request.chunkLineLen = 0;
 
-		if ((nextContent = WaitressGetline (content)) != NULL) {
-			const long int chunkSize = strtol (content, NULL, 16);
-			if (chunkSize == 0) {
-				return WAITRESS_HANDLER_DONE;
-			} else if (chunkSize < 0) {
+			if (WaitressGetline (line) != NULL && *line == '\0') {
+				continue;
+			}
+			chunkSize = strtol (line, &sizeEnd, 16);
+			if (sizeEnd == line || chunkSize < 0) {
 				return WAITRESS_HANDLER_ERR;
-			} else {
-				waith->request.chunkSize = chunkSize;
-				content = nextContent;
+			} else if (chunkSize == 0) {
+				/* a pipelined response may follow */
+				waith->request.bufNext = content;
+				return WAITRESS_HANDLER_DONE;
 			}
-		} else {
-			return WAITRESS_HANDLER_ERR;
+			waith->request.chunkSize = chunkSize;
 		}
 	}
 
-	assert (0);
-	return WAITRESS_HANDLER_ERR;
+	return WAITRESS_HANDLER_CONTINUE;
 }
 
 /*	handle http header
@@ -693,10 +711,15 @@ static void WaitressHandleHeader (WaitressHandle_t *waith, const char * const ke
 
 	if (strcaseeq (key, "Content-Length")) {
 		waith->request.contentLength = atol (value);
+		waith->request.contentLengthKnown = true;
 	} else if (strcaseeq (key, "Transfer-Encoding")) {
 		if (strcaseeq (value, "chunked")) {
 			waith->request.dataHandler = WaitressHandleChunked;
 		}
+	} else if (strcaseeq (key, "Connection")) {
+		if (strcaseeq (value, "close")) {
+			waith->request.serverClose = true;
+		}
 	}
 }
 
@@ -858,10 +881,10 @@ static WaitressReturn_t WaitressConnect (WaitressHandle_t *waith) {
  */
 static WaitressReturn_t WaitressSendRequest (WaitressHandle_t *waith) {
 	assert (waith != NULL);
-	assert (waith->request.buf != NULL);
 
 	const char *path = waith->url.path;
-	char * const buf = waith->request.buf;
+	/* request.buf may hold pipelined responses already */
+	char buf[WAITRESS_BUFFER_SIZE];
 	WaitressReturn_t wRet = WAITRESS_RET_OK;
 
 	if (waith->url.path == NULL) {
@@ -888,8 +911,8 @@ static WaitressReturn_t WaitressSendRequest (WaitressHandle_t *waith) {
 	WRITE_RET (buf, strlen (buf));
 
 	snprintf (buf, WAITRESS_BUFFER_SIZE,
-			"Host: %s\r\nUser-Agent: " PACKAGE "\r\nConnection: Close\r\n",
-			waith->url.host);
+			"Host: %s\r\nUser-Agent: " PACKAGE "\r\nConnection: %s\r\n",
+			waith->url.host, waith->request.keepAlive ? "keep-alive" : "Close");
 	WRITE_RET (buf, strlen (buf));
 
 	if (waith->method == WAITRESS_METHOD_POST && waith->postData != NULL) {
@@ -930,20 +953,28 @@ static WaitressReturn_t WaitressSendRequest (WaitressHandle_t *waith) {
 static WaitressReturn_t WaitressReceiveHeaders (WaitressHandle_t *waith,
 		size_t *retRemaining) {
 	char * const buf = waith->request.buf;
-	size_t bufFilled = 0, recvSize = 0;
+	/* left over from the previous pipelined response */
+	size_t bufFilled = waith->request.bufFilled, recvSize = 0;
+	bool haveData = bufFilled > 0;
 	char *nextLine = NULL, *thisLine = NULL;
 	enum {HDRM_HEAD, HDRM_LINES, HDRM_FINISHED} hdrParseMode = HDRM_HEAD;
 	WaitressReturn_t wRet = WAITRESS_RET_OK;
 
+	waith->request.bufFilled = 0;
+
 	/* receive answer */
 	nextLine = buf;
 	while (hdrParseMode != HDRM_FINISHED) {
-		READ_RET (buf+bufFilled, WAITRESS_BUFFER_SIZE-1 - bufFilled, &recvSize);
-		if (recvSize == 0) {
-			/* connection closed too early */
-			return WAITRESS_RET_CONNECTION_CLOSED;
+		if (!haveData) {
+			READ_RET (buf+bufFilled, WAITRESS_BUFFER_SIZE-1 - bufFilled,
+					&recvSize);
+			if (recvSize == 0) {
+				/* connection closed too early */
+				return WAITRESS_RET_CONNECTION_CLOSED;
+			}
+			bufFilled += recvSize;
 		}
-		bufFilled += recvSize;
+		haveData = false;
 		buf[bufFilled] = '\0';
 		thisLine = buf;
 
@@ -1011,7 +1042,21 @@ static WaitressReturn_t WaitressReceiveHeaders (WaitressHandle_t *waith,
 	return wRet;
 }
 
-/*	read response header and data
+/*	keep bytes following the response in buf for the next one
+ *	@param waitress handle
+ *	@param start of next response
+ *	@param end of received data
+ */
+static void WaitressKeepPipelined (WaitressHandle_t *waith,
+		const char *next, const char *end) {
+	assert (next <= end);
+
+	waith->request.bufFilled = end - next;
+	memmove (waith->request.buf, next, waith->request.bufFilled);
+}
+
+/*	read response header and data; stops at the end of the body, if it is
+ *	known, so responses can be pipelined
  */
 static WaitressReturn_t WaitressReceiveResponse (WaitressHandle_t *waith) {
 	assert (waith != NULL);
@@ -1026,10 +1071,22 @@ static WaitressReturn_t WaitressReceiveResponse (WaitressHandle_t *waith) {
 	}
 
 	do {
+		const bool delimited = waith->request.dataHandler ==
+				WaitressHandleIdentity && waith->request.contentLengthKnown;
+		size_t handleSize = recvSize;
+
+		if (delimited && handleSize > waith->request.contentLength -
+				waith->request.contentReceived) {
+			handleSize = waith->request.contentLength -
+					waith->request.contentReceived;
+		}
+
 		/* data must be \0-terminated for chunked handler */
 		buf[recvSize] = '\0';
-		switch (waith->request.dataHandler (waith, buf, recvSize)) {
+		switch (waith->request.dataHandler (waith, buf, handleSize)) {
 			case WAITRESS_HANDLER_DONE:
+				WaitressKeepPipelined (waith, waith->request.bufNext,
+						&buf[recvSize]);
 				return WAITRESS_RET_OK;
 				break;
 
@@ -1045,21 +1102,25 @@ static WaitressReturn_t WaitressReceiveResponse (WaitressHandle_t *waith) {
 				/* go on */
 				break;
 		}
+		if (delimited && waith->request.contentReceived >=
+				waith->request.contentLength) {
+			WaitressKeepPipelined (waith, &buf[handleSize], &buf[recvSize]);
+			return WAITRESS_RET_OK;
+		}
 		READ_RET (buf, WAITRESS_BUFFER_SIZE-1, &recvSize);
 	} while (recvSize > 0);
 
 	return WAITRESS_RET_OK;
 }
 
-/*	Receive data from host and call *callback ()
+/*	set up connection to host
  *	@param waitress handle
- *	@return WaitressReturn_t
+ *	@return WaitressReturn_t; call WaitressClose in any case
  */
-WaitressReturn_t WaitressFetchCall (WaitressHandle_t *waith) {
-	WaitressReturn_t wRet = WAITRESS_RET_OK;
-
+static WaitressReturn_t WaitressOpen (WaitressHandle_t *waith) {
 	/* initialize */
 	memset (&waith->request, 0, sizeof (waith->request));
+	waith->request.sockfd = -1;
 	waith->request.dataHandler = WaitressHandleIdentity;
 	waith->request.read = WaitressOrdinaryRead;
 	waith->request.write = WaitressOrdinaryWrite;
@@ -1088,22 +1149,83 @@ WaitressReturn_t WaitressFetchCall (WaitressHandle_t *waith) {
 	waith->request.buf = malloc (WAITRESS_BUFFER_SIZE *
 			sizeof (*waith->request.buf));
 
+	return WaitressConnect (waith);
+}
+
+/*	tear down connection set up by WaitressOpen
+ *	@param waitress handle
+ */
+static void WaitressClose (WaitressHandle_t *waith) {
+	if (waith->url.tls && waith->request.tlsSession != NULL) {
+		gnutls_bye (waith->request.tlsSession, GNUTLS_SHUT_RDWR);
+		gnutls_deinit (waith->request.tlsSession);
+		gnutls_certificate_free_credentials (waith->tlsCred);
+	}
+	if (waith->request.sockfd != -1) {
+		close (waith->request.sockfd);
+	}
+	free (waith->request.buf);
+	waith->request.buf = NULL;
+}
+
+/*	Receive data from host and call *callback ()
+ *	@param waitress handle
+ *	@return WaitressReturn_t
+ */
+WaitressReturn_t WaitressFetchCall (WaitressHandle_t *waith) {
+	WaitressReturn_t wRet = WAITRESS_RET_OK;
+
+	if (waith->transport != NULL) {
+		return waith->transport (waith, waith->transportData);
+	}
+
 	/* request */
-	if ((wRet = WaitressConnect (waith)) == WAITRESS_RET_OK) {
+	if ((wRet = WaitressOpen (waith)) == WAITRESS_RET_OK) {
 		if ((wRet = WaitressSendRequest (waith)) == WAITRESS_RET_OK) {
 			wRet = WaitressReceiveResponse (waith);
 		}
 	}
+	WaitressClose (waith);
 
-	/* cleanup */
-	if (waith->url.tls) {
-		gnutls_bye (waith->request.tlsSession, GNUTLS_SHUT_RDWR);
-		gnutls_deinit (waith->request.tlsSession);
-		gnutls_certificate_free_credentials (waith->tlsCred);
+	if (wRet == WAITRESS_RET_OK &&
+			waith->request.contentReceived < waith->request.contentLength) {
+		return WAITRESS_RET_PARTIAL_FILE;
 	}
-	close (waith->request.sockfd);
-	free (waith->request.buf);
+	return wRet;
+}
 
+/*	receive next pipelined response of WaitressFetchBatch
+ *	@param waitress handle, connected
+ *	@param batch item
+ *	@return WaitressReturn_t
+ */
+static WaitressReturn_t WaitressReceiveBatchItem (WaitressHandle_t *waith,
+		WaitressBatchItem_t *item) {
+	WaitressFetchBufCbBuffer_t buffer;
+	WaitressReturn_t wRet;
+
+	/* reset response state, keeping the connection */
+	waith->request.contentLength = 0;
+	waith->request.contentReceived = 0;
+	waith->request.chunkSize = 0;
+	waith->request.chunkLineLen = 0;
+	waith->request.contentLengthKnown = false;
+	waith->request.bufNext = NULL;
+	waith->request.dataHandler = WaitressHandleIdentity;
+
+	memset (&buffer, 0, sizeof (buffer));
+	if (item->callback != NULL) {
+		waith->callback = item->callback;
+		waith->data = item->data;
+	} else {
+		waith->callback = WaitressFetchBufCb;
+		waith->data = &buffer;
+	}
+
+	wRet = WaitressReceiveResponse (waith);
+	if (item->callback == NULL) {
+		item->buf = buffer.data;
+	}
 	if (wRet == WAITRESS_RET_OK &&
 			waith->request.contentReceived < waith->request.contentLength) {
 		return WAITRESS_RET_PARTIAL_FILE;
@@ -1111,6 +1233,127 @@ WaitressReturn_t WaitressFetchCall (WaitressHandle_t *waith) {
 	return wRet;
 }
 
+/*	do many requests over one connection: up to WAITRESS_PIPELINE_DEPTH
+ *	requests are sent before their responses are read (http pipelining).
+ *	responses are handed to the items in order. requests may not be
+ *	idempotent, so they are never sent twice: the first request on a
+ *	connection goes out alone, the pipeline is filled only after the server
+ *	kept the connection open once. requests that were sent, but not
+ *	answered before the connection went away fail, unless the server
+ *	announced the close (it must not process them then, rfc 7230 6.6).
+ *	the others use a new connection.
+ *	the handle's url path, post data and callback are not used
+ *	@param waitress handle
+ *	@param requests, their ret is set
+ *	@param number of requests
+ *	@return WAITRESS_RET_OK or first error
+ */
+WaitressReturn_t WaitressFetchBatch (WaitressHandle_t *waith,
+		WaitressBatchItem_t *items, size_t n) {
+	const char * const path = waith->url.path, * const postData =
+			waith->postData;
+	WaitressCbReturn_t (* const callback) (void *, size_t, void *) =
+			waith->callback;
+	void * const data = waith->data;
+	size_t received = 0, i;
+	WaitressReturn_t wRet = WAITRESS_RET_OK;
+
+	for (i = 0; i < n; i++) {
+		items[i].buf = NULL;
+		items[i].ret = WAITRESS_RET_ERR;
+	}
+
+	if (waith->transport != NULL) {
+		/* one by one, the transport replaces WaitressFetchCall only */
+		for (i = 0; i < n; i++) {
+			waith->url.path = items[i].path;
+			waith->postData = items[i].postData;
+			if (items[i].callback != NULL) {
+				waith->callback = items[i].callback;
+				waith->data = items[i].data;
+				items[i].ret = WaitressFetchCall (waith);
+			} else {
+				items[i].ret = WaitressFetchBuf (waith, &items[i].buf);
+			}
+		}
+	} else {
+		while (received < n) {
+			/* responses received over this connection */
+			size_t answered = 0, sent = received;
+			WaitressReturn_t sendRet = WAITRESS_RET_OK;
+			bool closeAnnounced = false;
+
+			wRet = WaitressOpen (waith);
+			while (wRet == WAITRESS_RET_OK && received < n) {
+				/* don't pipeline until the connection is known to be
+				 * persistent */
+				const size_t depth = answered == 0 ? 1 :
+						WAITRESS_PIPELINE_DEPTH;
+				WaitressReturn_t itemRet;
+
+				/* keep the pipeline filled; stop sending if the server closed
+				 * the connection, it may have answered some requests already */
+				while (sendRet == WAITRESS_RET_OK && sent < n &&
+						sent - received < depth) {
+					waith->url.path = items[sent].path;
+					waith->postData = items[sent].postData;
+					waith->request.keepAlive = sent + 1 < n;
+					if ((sendRet = WaitressSendRequest (waith)) ==
+							WAITRESS_RET_OK) {
+						++sent;
+					}
+				}
+				if (sent == received) {
+					wRet = sendRet;
+					break;
+				}
+
+				itemRet = WaitressReceiveBatchItem (waith, &items[received]);
+				items[received].ret = itemRet;
+				++received;
+				++answered;
+
+				/* connection is not usable any more after errors or if the
+				 * body was not delimited */
+				closeAnnounced = itemRet == WAITRESS_RET_OK &&
+						waith->request.serverClose;
+				if (itemRet != WAITRESS_RET_OK || waith->request.serverClose ||
+						(!waith->request.contentLengthKnown &&
+						waith->request.dataHandler != WaitressHandleChunked)) {
+					break;
+				}
+			}
+			WaitressClose (waith);
+
+			/* unless the server told us it ignores them, it may have acted
+			 * on these already */
+			for (; !closeAnnounced && received < sent; received++) {
+				items[received].ret = WAITRESS_RET_CONNECTION_CLOSED;
+			}
+
+			if (answered == 0 && wRet != WAITRESS_RET_OK) {
+				/* cannot connect or send at all */
+				for (i = received; i < n; i++) {
+					items[i].ret = wRet;
+				}
+				break;
+			}
+		}
+	}
+
+	waith->url.path = path;
+	waith->postData = postData;
+	waith->callback = callback;
+	waith->data = data;
+
+	for (i = 0; i < n; i++) {
+		if (items[i].ret != WAITRESS_RET_OK) {
+			return items[i].ret;
+		}
+	}
+	return WAITRESS_RET_OK;
+}
+
 const char *WaitressErrorToStr (WaitressReturn_t wRet) {
 	switch (wRet) {
 		case WAITRESS_RET_OK:
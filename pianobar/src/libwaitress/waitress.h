@@ -30,6 +30,8 @@ THE SOFTWARE.
 #include <gnutls/gnutls.h>
 
 #define WAITRESS_BUFFER_SIZE 10*1024
+/* max requests in flight on one connection, see WaitressFetchBatch */
+#define WAITRESS_PIPELINE_DEPTH 8
 
 typedef enum {
 	WAITRESS_METHOD_GET = 0,
@@ -94,12 +96,28 @@ typedef struct {
 	int timeout;
 	const char *tlsFingerprint;
 	gnutls_certificate_credentials_t tlsCred;
+	/* replaces the network if set, called by WaitressFetchCall with this
+	 * handle and transportData; used to replay recorded sessions */
+	WaitressReturn_t (*transport) (void *, void *);
+	void *transportData;
 
 	/* per-request data */
 	struct {
 		size_t contentLength, contentReceived, chunkSize;
+		/* body is delimited by content-length, not by closing the
+		 * connection */
+		bool contentLengthKnown;
+		/* ask server to keep the connection open; it may refuse */
+		bool keepAlive, serverClose;
 		int sockfd;
 		char *buf;
+		/* bytes in buf that belong to the next (pipelined) response */
+		size_t bufFilled;
+		/* end of chunked body in buf */
+		char *bufNext;
+		/* incomplete chunk size line */
+		char chunkLine[64];
+		size_t chunkLineLen;
 		gnutls_session_t tlsSession;
 		/* first argument is WaitressHandle_t, but that's not defined yet */
 		WaitressHandlerReturn_t (*dataHandler) (void *, char *, const size_t);
@@ -110,6 +128,20 @@ typedef struct {
 	} request;
 } WaitressHandle_t;
 
+/*	one request of WaitressFetchBatch; host, method, headers and proxy are
+ *	the handle's
+ */
+typedef struct {
+	const char *path;
+	const char *postData;
+	/* response body is passed to callback, or stored in malloc'ed buf if
+	 * there is none (free it yourself) */
+	WaitressCbReturn_t (*callback) (void *, size_t, void *);
+	void *data;
+	char *buf;
+	WaitressReturn_t ret;
+} WaitressBatchItem_t;
+
 void WaitressInit (WaitressHandle_t *);
 void WaitressFree (WaitressHandle_t *);
 bool WaitressSetProxy (WaitressHandle_t *, const char *);
@@ -117,6 +149,8 @@ char *WaitressUrlEncode (const char *);
 bool WaitressSetUrl (WaitressHandle_t *, const char *);
 WaitressReturn_t WaitressFetchBuf (WaitressHandle_t *, char **);
 WaitressReturn_t WaitressFetchCall (WaitressHandle_t *);
+WaitressReturn_t WaitressFetchBatch (WaitressHandle_t *,
+		WaitressBatchItem_t *, size_t);
 const char *WaitressErrorToStr (WaitressReturn_t);
 
 #endif /* _WAITRESS_H */
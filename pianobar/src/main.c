@@ -48,6 +48,7 @@ THE SOFTWARE.
 
 /* pandora.com library */
 #include <piano.h>
+#include <trace.h>
 
 #include "main.h"
 #include "terminal.h"
@@ -84,8 +85,7 @@ static bool BarMainLoginUser (BarApp_t *app) {
 
 	BarUiMsg (&app->settings, MSG_INFO, "Login... ");
 	ret = BarUiPianoCall (app, PIANO_REQUEST_LOGIN, &reqData, &pRet, &wRet);
-	BarUiStartEventCmd (&app->settings, "userlogin", NULL, NULL, &app->player,
-			NULL, pRet, wRet);
+	BarUiStartEventCmd (app, "userlogin", NULL, NULL, NULL, pRet, wRet);
 	return ret;
 }
 
@@ -117,8 +117,8 @@ static bool BarMainGetStations (BarApp_t *app) {
 
 	BarUiMsg (&app->settings, MSG_INFO, "Get stations... ");
 	ret = BarUiPianoCall (app, PIANO_REQUEST_GET_STATIONS, NULL, &pRet, &wRet);
-	BarUiStartEventCmd (&app->settings, "usergetstations", NULL, NULL, &app->player,
-			app->ph.stations, pRet, wRet);
+	BarUiStartEventCmd (app, "usergetstations", NULL, NULL, &app->ph, pRet,
+			wRet);
 	return ret;
 }
 
@@ -127,7 +127,7 @@ static bool BarMainGetStations (BarApp_t *app) {
 static void BarMainGetInitialStation (BarApp_t *app) {
 	/* try to get autostart station */
 	if (app->settings.autostartStation != NULL) {
-		app->curStation = PianoFindStationById (app->ph.stations,
+		app->curStation = PianoFindStationById (&app->ph,
 				app->settings.autostartStation);
 		if (app->curStation == NULL) {
 			BarUiMsg (&app->settings, MSG_ERR,
@@ -143,15 +143,104 @@ static void BarMainGetInitialStation (BarApp_t *app) {
 	}
 }
 
+/*	run one control socket command
+ *	@param app handle
+ *	@param client
+ *	@param command line
+ */
+static void BarMainControlCommand (void *data, BarControlClient_t *client,
+		char *line) {
+	BarApp_t * const app = data;
+	char *arg;
+
+	if ((arg = strchr (line, ' ')) != NULL) {
+		*arg++ = '\0';
+	}
+
+	if (strcmp (line, "keys") == 0 && arg != NULL) {
+		/* keystrokes, also answers prompts; \n is return */
+		char script[BAR_CONTROL_LINE];
+		size_t scriptLen = 0;
+
+		for (const char *c = arg; *c != '\0'; c++) {
+			if (c[0] == '\\' && c[1] == 'n') {
+				script[scriptLen++] = '\n';
+				++c;
+			} else {
+				script[scriptLen++] = *c;
+			}
+		}
+
+		app->input.script = script;
+		app->input.scriptLen = scriptLen;
+		while (app->input.scriptLen > 0 && !app->doQuit) {
+			char buf[2];
+			if (BarReadline (buf, sizeof (buf), NULL, &app->input,
+					BAR_RL_FULLRETURN | BAR_RL_NOECHO, -1) > 0) {
+				BarUiDispatch (app, buf[0], app->curStation, app->playlist,
+						true, BAR_DC_GLOBAL);
+			}
+		}
+		app->input.script = NULL;
+		app->input.scriptLen = 0;
+		BarControlReply (client, "ok\n", 3);
+	} else if (strcmp (line, "station") == 0 && arg != NULL) {
+		PianoStation_t *station;
+
+		if ((station = PianoFindStationById (&app->ph, arg)) == NULL) {
+			station = PianoFindStationByName (&app->ph, arg);
+		}
+		if (station == NULL) {
+			static const char msg[] = "error no such station\n";
+			BarControlReply (client, msg, sizeof (msg) - 1);
+		} else {
+			BarUiSwitchStation (app, station);
+			BarControlReply (client, "ok\n", 3);
+		}
+	} else if (strcmp (line, "status") == 0) {
+		BarEventRecord_t rec;
+
+		memset (&rec, 0, sizeof (rec));
+		if (BarUiEventRecord (app, &rec, "status", app->curStation,
+				app->playlist, &app->ph, PIANO_RET_OK, WAITRESS_RET_OK)) {
+			BarControlReply (client, rec.data, rec.len);
+		} else {
+			static const char msg[] = "error out of memory\n";
+			BarControlReply (client, msg, sizeof (msg) - 1);
+		}
+		free (rec.data);
+	} else if (strcmp (line, "subscribe") == 0) {
+		client->subscribed = true;
+		BarControlReply (client, "ok\n", 3);
+	} else if (strcmp (line, "unsubscribe") == 0) {
+		client->subscribed = false;
+		BarControlReply (client, "ok\n", 3);
+	} else {
+		static const char msg[] = "error unknown command\n";
+		BarControlReply (client, msg, sizeof (msg) - 1);
+	}
+}
+
 /*	wait for user input
  */
 static void BarMainHandleUserInput (BarApp_t *app) {
 	char buf[2];
+	BarPlayerStatus_t status;
+	int timeout;
+
+	BarPlayerGetStatus (&app->player, &status);
+	/* the player wakes us up when it's done, so time display is the only
+	 * reason to poll */
+	timeout = (app->curStation == NULL && status.mode == PLAYER_FREED) ?
+			-1 : 1;
+
+	BarControlWatch (&app->control, &app->input);
 	if (BarReadline (buf, sizeof (buf), NULL, &app->input,
-			BAR_RL_FULLRETURN | BAR_RL_NOECHO, 1) > 0) {
+			BAR_RL_FULLRETURN | BAR_RL_NOECHO | BAR_RL_WAKEUP, timeout) > 0) {
 		BarUiDispatch (app, buf[0], app->curStation, app->playlist, true,
 				BAR_DC_GLOBAL);
 	}
+	BarControlProcess (&app->control, BarMainControlCommand, app);
 }
 
 /*	fetch new playlist
@@ -174,24 +263,35 @@ static void BarMainGetPlaylist (BarApp_t *app) {
 			app->curStation = NULL;
 		}
 	}
-	BarUiStartEventCmd (&app->settings, "stationfetchplaylist",
-			app->curStation, app->playlist, &app->player, app->ph.stations,
-			pRet, wRet);
+	BarUiStartEventCmd (app, "stationfetchplaylist",
+			app->curStation, app->playlist, &app->ph, pRet, wRet);
+}
+
+/*	append prefetched playlist fragment, waits if it's not there yet
+ */
+static void BarMainTakePrefetched (BarApp_t *app) {
+	PianoSong_t *fragment = BarPrefetchTake (&app->prefetch,
+			app->curStation);
+
+	if (fragment != NULL) {
+		BarPlaylistAppend (&app->playlist, fragment);
+		BarUiStartEventCmd (app, "stationfetchplaylist",
+				app->curStation, fragment, &app->ph, app->prefetch.pRet,
+				app->prefetch.wRet);
+	}
 }
 
 /*	start new player thread
  */
 static void BarMainStartPlayback (BarApp_t *app, pthread_t *playerThread) {
 	BarUiPrintSong (&app->settings, app->playlist, app->curStation->isQuickMix ?
-			PianoFindStationById (app->ph.stations,
+			PianoFindStationById (&app->ph,
 			app->playlist->stationId) : NULL);
 
 	if (app->playlist->audioUrl == NULL) {
 		BarUiMsg (&app->settings, MSG_ERR, "Invalid song url.\n");
 	} else {
-		/* setup player */
-		memset (&app->player, 0, sizeof (app->player));
-
+		/* setup player; structure has been reset by BarPlayerReset () */
 		WaitressInit (&app->player.waith);
 		WaitressSetUrl (&app->player.waith, app->playlist->audioUrl);
 
@@ -203,19 +303,35 @@ static void BarMainStartPlayback (BarApp_t *app, pthread_t *playerThread) {
 		app->player.gain = app->playlist->fileGain;
 		app->player.scale = BarPlayerCalcScale (app->player.gain + app->settings.volume);
 		app->player.audioFormat = app->playlist->audioFormat;
+		app->player.decoderName = app->settings.audioDecoder;
 		app->player.settings = &app->settings;
+		app->player.wakeupFd = app->wakeupFd;
+		if (app->cache.dir != NULL) {
+			app->player.cache = &app->cache;
+			BarCacheKey (app->playlist, app->player.cacheKey,
+					sizeof (app->player.cacheKey));
+		}
 
 		/* throw event */
-		BarUiStartEventCmd (&app->settings, "songstart",
-				app->curStation, app->playlist, &app->player, app->ph.stations,
-				PIANO_RET_OK, WAITRESS_RET_OK);
+		BarUiStartEventCmd (app, "songstart",
+				app->curStation, app->playlist, &app->ph, PIANO_RET_OK,
+				WAITRESS_RET_OK);
 
 		/* prevent race condition, mode must _not_ be FREED if
 		 * thread has been started */
-		app->player.mode = PLAYER_STARTING;
+		BarPlayerSetStarting (&app->player);
 		/* start player */
 		pthread_create (playerThread, NULL, BarPlayerThread,
 				&app->player);
+
+		/* download next song while this one is playing */
+		if (app->player.cache != NULL && app->playlist->next != NULL) {
+			char key[BAR_CACHE_KEY_LEN];
+
+			BarCacheKey (app->playlist->next, key, sizeof (key));
+			BarCachePrefetch (&app->cache, key, app->playlist->next->audioUrl,
+					app->settings.proxy);
+		}
 	}
 }
 
@@ -224,9 +340,8 @@ static void BarMainStartPlayback (BarApp_t *app, pthread_t *playerThread) {
 static void BarMainPlayerCleanup (BarApp_t *app, pthread_t *playerThread) {
 	void *threadRet;
 
-	BarUiStartEventCmd (&app->settings, "songfinish", app->curStation,
-			app->playlist, &app->player, app->ph.stations, PIANO_RET_OK,
-			WAITRESS_RET_OK);
+	BarUiStartEventCmd (app, "songfinish", app->curStation,
+			app->playlist, &app->ph, PIANO_RET_OK, WAITRESS_RET_OK);
 
 	/* FIXME: pthread_join blocks everything if network connection
 	 * is hung up e.g. */
@@ -237,17 +352,21 @@ static void BarMainPlayerCleanup (BarApp_t *app, pthread_t *playerThread) {
 		app->curStation = NULL;
 	}
 
-	memset (&app->player, 0, sizeof (app->player));
+	BarPlayerReset (&app->player);
 }
 
 /*	print song duration
  */
 static void BarMainPrintTime (BarApp_t *app) {
+	BarPlayerStatus_t status;
+	int songRemaining;
+	enum {POSITIVE, NEGATIVE} sign = NEGATIVE;
+
+	BarPlayerGetStatus (&app->player, &status);
 	/* Ugly: songDuration is unsigned _long_ int! Lets hope this won't
 	 * overflow */
-	int songRemaining = (signed long int) (app->player.songDuration -
-			app->player.songPlayed) / BAR_PLAYER_MS_TO_S_FACTOR;
-	enum {POSITIVE, NEGATIVE} sign = NEGATIVE;
+	songRemaining = (signed long int) (status.songDuration -
+			status.songPlayed) / BAR_PLAYER_MS_TO_S_FACTOR;
 	if (songRemaining < 0) {
 		/* song is longer than expected */
 		sign = POSITIVE;
@@ -256,18 +375,20 @@ static void BarMainPrintTime (BarApp_t *app) {
 	BarUiMsg (&app->settings, MSG_TIME, "%c%02i:%02i/%02i:%02i\r",
 			(sign == POSITIVE ? '+' : '-'),
 			songRemaining / 60, songRemaining % 60,
-			app->player.songDuration / BAR_PLAYER_MS_TO_S_FACTOR / 60,
-			app->player.songDuration / BAR_PLAYER_MS_TO_S_FACTOR % 60);
+			status.songDuration / BAR_PLAYER_MS_TO_S_FACTOR / 60,
+			status.songDuration / BAR_PLAYER_MS_TO_S_FACTOR % 60);
 }
 
 /*	main loop
  */
 static void BarMainLoop (BarApp_t *app) {
 	pthread_t playerThread;
+	BarPlayerStatus_t status;
 
 	BarMainGetLoginCredentials (&app->settings, &app->input);
 
 	BarMainLoadProxy (&app->settings, &app->waith);
+	BarMainLoadProxy (&app->settings, &app->prefetch.waith);
 
 	if (!BarMainLoginUser (app)) {
 		return;
@@ -281,24 +402,29 @@ static void BarMainLoop (BarApp_t *app) {
 
 	/* little hack, needed to signal: hey! we need a playlist, but don't
 	 * free anything (there is nothing to be freed yet) */
-	memset (&app->player, 0, sizeof (app->player));
+	BarPlayerInit (&app->player);
 
 	while (!app->doQuit) {
+		BarPlayerGetStatus (&app->player, &status);
 		/* song finished playing, clean up things/scrobble song */
-		if (app->player.mode == PLAYER_FINISHED_PLAYBACK) {
+		if (status.mode == PLAYER_FINISHED_PLAYBACK) {
 			BarMainPlayerCleanup (app, &playerThread);
+			BarPlayerGetStatus (&app->player, &status);
 		}
 
 		/* check whether player finished playing and start playing new
 		 * song */
-		if (app->player.mode >= PLAYER_FINISHED_PLAYBACK ||
-				app->player.mode == PLAYER_FREED) {
+		if (status.mode >= PLAYER_FINISHED_PLAYBACK ||
+				status.mode == PLAYER_FREED) {
 			if (app->curStation != NULL) {
 				/* what's next? */
 				if (app->playlist != NULL) {
 					PianoSong_t *histsong = app->playlist;
 					app->playlist = app->playlist->next;
-					BarUiHistoryPrepend (app, histsong);
+					BarHistoryPrepend (&app->history, histsong);
+				}
+				if (app->playlist == NULL) {
+					BarMainTakePrefetched (app);
 				}
 				if (app->playlist == NULL) {
 					BarMainGetPlaylist (app);
@@ -306,28 +432,42 @@ static void BarMainLoop (BarApp_t *app) {
 				/* song ready to play */
 				if (app->playlist != NULL) {
 					BarMainStartPlayback (app, &playerThread);
+					/* last song of this fragment, get the next one while
+					 * it's playing */
+					if (app->playlist->next == NULL) {
+						BarPrefetchStart (&app->prefetch, &app->ph,
+								app->curStation, app->settings.audioFormat);
+					}
 				}
 			}
 		}
 
+		if (BarPrefetchDone (&app->prefetch)) {
+			BarMainTakePrefetched (app);
+		}
+
 		BarMainHandleUserInput (app);
 
 		/* show time */
-		if (app->player.mode >= PLAYER_SAMPLESIZE_INITIALIZED &&
-				app->player.mode < PLAYER_FINISHED_PLAYBACK) {
+		BarPlayerGetStatus (&app->player, &status);
+		if (status.mode >= PLAYER_SAMPLESIZE_INITIALIZED &&
+				status.mode < PLAYER_FINISHED_PLAYBACK) {
 			BarMainPrintTime (app);
 		}
 	}
 
-	if (app->player.mode != PLAYER_FREED) {
+	BarPlayerGetStatus (&app->player, &status);
+	if (status.mode != PLAYER_FREED) {
 		pthread_join (playerThread, NULL);
 	}
+	BarPlayerDestroy (&app->player);
 }
 
 int main (int argc, char **argv) {
 	static BarApp_t app;
 	/* terminal attributes _before_ we started messing around with ~ECHO */
 	struct termios termOrig;
+	int wakeupPipe[2];
 
 	memset (&app, 0, sizeof (app));
 
@@ -354,10 +494,45 @@ int main (int argc, char **argv) {
 				app.settings.keys[BAR_KS_HELP]);
 	}
 
+	if (app.settings.audioCacheDir != NULL && app.settings.audioCacheSize > 0) {
+		BarCacheInit (&app.cache, app.settings.audioCacheDir,
+				(size_t) app.settings.audioCacheSize * 1024 * 1024);
+		if (app.cache.dir == NULL) {
+			BarUiMsg (&app.settings, MSG_ERR, "Cannot use audio cache %s\n",
+					app.settings.audioCacheDir);
+		}
+	}
+
+	BarHistoryInit (&app.history, app.settings.history);
+	BarHistoryLoad (&app.history, app.settings.historyFile);
+
 	WaitressInit (&app.waith);
 	app.waith.url.host = strdup (PIANO_RPC_HOST);
 	app.waith.url.tls = true;
 	app.waith.tlsFingerprint = app.settings.tlsFingerprint;
+	BarPrefetchInit (&app.prefetch, app.settings.tlsFingerprint);
+
+	if (app.settings.eventCmd != NULL && app.settings.eventCmdStream) {
+		BarEventCmdInit (&app.eventCmd, app.settings.eventCmd);
+	}
+
+	if (app.settings.rpcReplay != NULL || app.settings.rpcRecord != NULL) {
+		const bool replay = app.settings.rpcReplay != NULL;
+		const char * const path = replay ? app.settings.rpcReplay :
+				app.settings.rpcRecord;
+
+		app.ph.trace = PianoTraceOpen (path, replay ? PIANO_TRACE_REPLAY :
+				PIANO_TRACE_RECORD);
+		if (app.ph.trace == NULL) {
+			BarUiMsg (&app.settings, MSG_ERR, "Cannot open rpc trace %s\n",
+					path);
+		} else {
+			PianoTraceAttach (app.ph.trace, &app.waith);
+			PianoTraceAttach (app.ph.trace, &app.prefetch.waith);
+			BarUiMsg (&app.settings, MSG_INFO, "%s rpc trace %s\n",
+					replay ? "Replaying" : "Recording", path);
+		}
+	}
 
 	/* init fds */
 	FD_ZERO(&app.input.set);
@@ -374,6 +549,29 @@ int main (int argc, char **argv) {
 	}
 	app.input.maxfd = app.input.fds[0] > app.input.fds[1] ? app.input.fds[0] :
 			app.input.fds[1];
+
+	BarControlInit (&app.control);
+	if (app.settings.controlSocket != NULL) {
+		if (BarControlOpen (&app.control, app.settings.controlSocket)) {
+			BarUiMsg (&app.settings, MSG_INFO, "Control socket at %s opened\n",
+					app.settings.controlSocket);
+		} else {
+			BarUiMsg (&app.settings, MSG_ERR, "Cannot open control socket %s\n",
+					app.settings.controlSocket);
+		}
+	}
+
+	/* player thread wakes up main loop */
+	app.input.wakeup = app.wakeupFd = -1;
+	if (pipe (wakeupPipe) == 0) {
+		fcntl (wakeupPipe[0], F_SETFL, O_NONBLOCK);
+		fcntl (wakeupPipe[1], F_SETFL, O_NONBLOCK);
+		app.input.wakeup = wakeupPipe[0];
+		app.wakeupFd = wakeupPipe[1];
+		if (app.input.wakeup > app.input.maxfd) {
+			app.input.maxfd = app.input.wakeup;
+		}
+	}
 	++app.input.maxfd;
 
 	BarMainLoop (&app);
@@ -381,9 +579,24 @@ int main (int argc, char **argv) {
 	if (app.input.fds[1] != -1) {
 		close (app.input.fds[1]);
 	}
+	if (app.input.wakeup != -1) {
+		close (app.input.wakeup);
+		close (app.wakeupFd);
+	}
+	BarControlDestroy (&app.control);
 
+	BarCacheDestroy (&app.cache);
+	BarPrefetchDestroy (&app.prefetch);
+	if (app.settings.eventCmd != NULL && app.settings.eventCmdStream) {
+		BarEventCmdDestroy (&app.eventCmd);
+	}
+	if (app.ph.trace != NULL) {
+		PianoTraceClose (app.ph.trace);
+	}
+	BarUiInvalidateStations (&app);
 	PianoDestroy (&app.ph);
-	PianoDestroyPlaylist (app.songHistory);
+	BarHistorySave (&app.history, app.settings.historyFile);
+	BarHistoryDestroy (&app.history);
 	PianoDestroyPlaylist (app.playlist);
 	WaitressFree (&app.waith);
 	ao_shutdown();
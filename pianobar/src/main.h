@@ -27,21 +27,41 @@ THE SOFTWARE.
 #include <piano.h>
 #include <waitress.h>
 
+#include "cache.h"
+#include "control.h"
+#include "eventcmd.h"
+#include "history.h"
 #include "player.h"
+#include "prefetch.h"
 #include "settings.h"
 #include "ui_readline.h"
 
+/* ph.stations sorted by BarStationSorting_t, built on demand; see
+ * BarUiInvalidateStations */
+typedef struct {
+	PianoStation_t **sorted[BAR_SORT_COUNT];
+	size_t count[BAR_SORT_COUNT];
+} BarStationCache_t;
+
 typedef struct {
 	PianoHandle_t ph;
 	WaitressHandle_t waith;
 	struct audioPlayer player;
+	BarCache_t cache;
+	BarPrefetch_t prefetch;
+	/* only used if settings.eventCmdStream is set */
+	BarEventCmd_t eventCmd;
 	BarSettings_t settings;
 	/* first item is current song */
 	PianoSong_t *playlist;
-	PianoSong_t *songHistory;
+	BarHistory_t history;
 	PianoStation_t *curStation;
+	BarStationCache_t stationCache;
 	char doQuit;
 	BarReadlineFds_t input;
+	/* write end of input.wakeup */
+	int wakeupFd;
+	BarControl_t control;
 } BarApp_t;
 
 #endif /* _MAIN_H */
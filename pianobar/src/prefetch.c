@@ -0,0 +1,190 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* background playlist fetch, keeps the next fragment's rpc out of the gap
+ * between two songs */
+
+#ifndef __FreeBSD__
+#define _POSIX_C_SOURCE 1
+#define _BSD_SOURCE /* strdup() */
+#define _DARWIN_C_SOURCE /* strdup() on OS X */
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "prefetch.h"
+#include "ui.h"
+
+/*	set up prefetcher
+ *	@param prefetcher
+ *	@param tls fingerprint of rpc host
+ */
+void BarPrefetchInit (BarPrefetch_t *pf, const char *tlsFingerprint) {
+	memset (pf, 0, sizeof (*pf));
+	WaitressInit (&pf->waith);
+	pf->waith.url.host = PIANO_RPC_HOST;
+	pf->waith.url.tls = true;
+	pf->waith.tlsFingerprint = tlsFingerprint;
+}
+
+/*	playlist.getFragment, like BarUiPianoCall but quiet and without
+ *	reauthentication; errors are handled by the regular fetch later on
+ */
+static void *BarPrefetchThread (void *data) {
+	BarPrefetch_t *pf = data;
+
+	pf->wRet = BarUiPianoHttpRequest (&pf->waith, &pf->req);
+	if (pf->wRet == WAITRESS_RET_OK) {
+		pf->pRet = PianoResponse (pf->ph, &pf->req);
+	} else {
+		pf->pRet = PIANO_RET_ERR;
+	}
+	free (pf->req.responseData);
+	PianoDestroyRequest (&pf->req);
+
+	if (pf->pRet == PIANO_RET_OK) {
+		pf->playlist = pf->reqData.retPlaylist;
+	} else {
+		PianoDestroyPlaylist (pf->reqData.retPlaylist);
+	}
+
+	pf->running = 0;
+
+	return NULL;
+}
+
+/*	request next fragment of station's playlist; does nothing if there is
+ *	a pending request or result. The request is prepared right away, so
+ *	the piano handle can be used by others while it's running.
+ *	@param prefetcher
+ *	@param piano handle, see BarPrefetch_t
+ *	@param station
+ *	@param audio format
+ *	@return true if the request was started
+ */
+bool BarPrefetchStart (BarPrefetch_t *pf, PianoHandle_t *ph,
+		const PianoStation_t *station, PianoAudioFormat_t format) {
+	if (pf->started || station == NULL || station->id == NULL) {
+		return false;
+	}
+
+	pf->ph = ph;
+	memset (&pf->station, 0, sizeof (pf->station));
+	if ((pf->station.id = strdup (station->id)) == NULL) {
+		return false;
+	}
+	pf->playlist = NULL;
+
+	memset (&pf->req, 0, sizeof (pf->req));
+	memset (&pf->reqData, 0, sizeof (pf->reqData));
+	pf->reqData.station = &pf->station;
+	pf->reqData.format = format;
+	pf->req.data = &pf->reqData;
+	pf->wRet = WAITRESS_RET_OK;
+	if ((pf->pRet = PianoRequest (ph, &pf->req,
+			PIANO_REQUEST_GET_PLAYLIST)) != PIANO_RET_OK) {
+		PianoDestroyRequest (&pf->req);
+		free (pf->station.id);
+		pf->station.id = NULL;
+		return false;
+	}
+
+	pf->running = 1;
+	if (pthread_create (&pf->thread, NULL, BarPrefetchThread, pf) != 0) {
+		pf->running = 0;
+		PianoDestroyRequest (&pf->req);
+		free (pf->station.id);
+		pf->station.id = NULL;
+		return false;
+	}
+	pf->started = true;
+
+	return true;
+}
+
+/*	finished request waiting to be picked up?
+ *	@param prefetcher
+ */
+bool BarPrefetchDone (const BarPrefetch_t *pf) {
+	return pf->started && !pf->running;
+}
+
+/*	wait for running request
+ *	@param prefetcher
+ */
+void BarPrefetchWait (BarPrefetch_t *pf) {
+	if (pf->started && pf->ph != NULL) {
+		pthread_join (pf->thread, NULL);
+		pf->ph = NULL;
+	}
+}
+
+/*	pick up result, waits if the request is still running
+ *	@param prefetcher
+ *	@param current station; the result is dropped if it was fetched for
+ *			another one
+ *	@return playlist fragment or NULL
+ */
+PianoSong_t *BarPrefetchTake (BarPrefetch_t *pf,
+		const PianoStation_t *station) {
+	PianoSong_t *playlist;
+
+	if (!pf->started) {
+		return NULL;
+	}
+	BarPrefetchWait (pf);
+	pf->started = false;
+
+	playlist = pf->playlist;
+	pf->playlist = NULL;
+	if (station == NULL || station->id == NULL ||
+			strcmp (station->id, pf->station.id) != 0) {
+		PianoDestroyPlaylist (playlist);
+		playlist = NULL;
+	}
+	free (pf->station.id);
+	pf->station.id = NULL;
+
+	return playlist;
+}
+
+/*	free prefetcher, waits for running request
+ *	@param prefetcher
+ */
+void BarPrefetchDestroy (BarPrefetch_t *pf) {
+	BarPrefetchTake (pf, NULL);
+	WaitressFree (&pf->waith);
+}
+
+/*	append fragment to playlist; songs are played in the order pandora sent
+ *	them, a new fragment always follows the previous one
+ *	@param playlist
+ *	@param fragment
+ */
+void BarPlaylistAppend (PianoSong_t **playlist, PianoSong_t *fragment) {
+	while (*playlist != NULL) {
+		playlist = &(*playlist)->next;
+	}
+	*playlist = fragment;
+}
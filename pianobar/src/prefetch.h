@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2008-2011
+	Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _PREFETCH_H
+#define _PREFETCH_H
+
+#include <stdbool.h>
+#include <signal.h>
+/* required for freebsd */
+#include <sys/types.h>
+#include <pthread.h>
+
+#include <piano.h>
+#include <waitress.h>
+
+/* fetches the next playlist fragment in the background */
+typedef struct {
+	/* own connection; set up proxy after BarPrefetchInit () */
+	WaitressHandle_t waith;
+
+	pthread_t thread;
+	/* thread created, but not joined yet; owner only */
+	bool started;
+	/* cleared by prefetch thread when it's done */
+	volatile sig_atomic_t running;
+
+	/* the request is prepared by BarPrefetchStart, the thread only uses
+	 * the handle to parse the response, which does not touch its state.
+	 * NULL after the thread has been joined */
+	PianoHandle_t *ph;
+	PianoRequest_t req;
+	PianoRequestDataGetPlaylist_t reqData;
+	/* private copy, only id is set */
+	PianoStation_t station;
+
+	/* result */
+	PianoSong_t *playlist;
+	PianoReturn_t pRet;
+	WaitressReturn_t wRet;
+} BarPrefetch_t;
+
+void BarPrefetchInit (BarPrefetch_t *, const char *);
+void BarPrefetchDestroy (BarPrefetch_t *);
+bool BarPrefetchStart (BarPrefetch_t *, PianoHandle_t *,
+		const PianoStation_t *, PianoAudioFormat_t);
+bool BarPrefetchDone (const BarPrefetch_t *);
+void BarPrefetchWait (BarPrefetch_t *);
+PianoSong_t *BarPrefetchTake (BarPrefetch_t *, const PianoStation_t *);
+void BarPlaylistAppend (PianoSong_t **, PianoSong_t *);
+
+#endif /* _PREFETCH_H */
@@ -41,6 +41,77 @@ THE SOFTWARE.
 
 #define streq(a, b) (strcmp (a, b) == 0)
 
+/*	split format string into literals and %x fields, so it does not have to
+ *	be parsed again for every song. Unknown format characters are literals
+ *	@param compiled format, replaced
+ *	@param format string, must stay around as long as format is used
+ *	@param format characters
+ */
+static void BarSettingsCompileFormat (BarFormat_t *format, const char *str,
+		const char *formatChars) {
+	const char *pos = str;
+	BarFormatOp_t *op = NULL;
+
+	free (format->ops);
+	format->count = 0;
+	/* at most one op per character */
+	if ((format->ops = calloc (strlen (str) + 1,
+			sizeof (*format->ops))) == NULL) {
+		return;
+	}
+
+	while (*pos != '\0') {
+		const char *field;
+
+		if (pos[0] == '%' && pos[1] == '\0') {
+			/* dangling % is dropped */
+			break;
+		}
+		if (pos[0] == '%' &&
+				(field = strchr (formatChars, pos[1])) != NULL) {
+			op = &format->ops[format->count++];
+			op->text = pos;
+			op->len = 2;
+			op->field = field - formatChars;
+			op = NULL;
+			pos += 2;
+			continue;
+		}
+
+		if (pos[0] == '%' && pos[1] == '%') {
+			/* escaped %, like printf */
+			op = &format->ops[format->count++];
+			op->text = pos + 1;
+			op->len = 1;
+			op->field = -1;
+			pos += 2;
+			continue;
+		}
+
+		/* literal, including invalid %x */
+		const size_t len = (pos[0] == '%') ? 2 : 1;
+		if (op == NULL) {
+			op = &format->ops[format->count++];
+			op->text = pos;
+			op->field = -1;
+		}
+		op->len += len;
+		pos += len;
+	}
+}
+
+/*	compile all format strings
+ *	@param settings
+ */
+static void BarSettingsCompileFormats (BarSettings_t *settings) {
+	BarSettingsCompileFormat (&settings->npSongOps, settings->npSongFormat,
+			BAR_FORMAT_NP_SONG);
+	BarSettingsCompileFormat (&settings->npStationOps,
+			settings->npStationFormat, BAR_FORMAT_NP_STATION);
+	BarSettingsCompileFormat (&settings->listSongOps,
+			settings->listSongFormat, BAR_FORMAT_LIST_SONG);
+}
+
 /*	tries to guess your config dir; somehow conforming to
  *	http://standards.freedesktop.org/basedir-spec/basedir-spec-0.6.html
  *	@param name of the config file (can contain subdirs too)
@@ -92,7 +163,16 @@ void BarSettingsDestroy (BarSettings_t *settings) {
 	free (settings->npSongFormat);
 	free (settings->npStationFormat);
 	free (settings->listSongFormat);
+	free (settings->npSongOps.ops);
+	free (settings->npStationOps.ops);
+	free (settings->listSongOps.ops);
 	free (settings->fifo);
+	free (settings->historyFile);
+	free (settings->controlSocket);
+	free (settings->audioCacheDir);
+	free (settings->audioDecoder);
+	free (settings->rpcRecord);
+	free (settings->rpcReplay);
 	for (size_t i = 0; i < MSG_COUNT; i++) {
 		free (settings->msgFormat[i].prefix);
 		free (settings->msgFormat[i].postfix);
@@ -113,7 +193,7 @@ void BarSettingsRead (BarSettings_t *settings) {
 			sizeof (dispatchActions) / sizeof (*dispatchActions));
 
 	/* apply defaults */
-	#ifdef ENABLE_FAAD
+	#if defined (ENABLE_FAAD) || defined (ENABLE_AVCODEC)
 	settings->audioFormat = PIANO_AF_AACPLUS;
 	#else
 		#ifdef ENABLE_MAD
@@ -131,6 +211,9 @@ void BarSettingsRead (BarSettings_t *settings) {
 	settings->listSongFormat = strdup ("%i) %a - %t%r");
 	settings->fifo = malloc (PATH_MAX * sizeof (*settings->fifo));
 	BarGetXdgConfigDir (PACKAGE "/ctl", settings->fifo, PATH_MAX);
+	settings->historyFile = malloc (PATH_MAX * sizeof (*settings->historyFile));
+	BarGetXdgConfigDir (PACKAGE "/history", settings->historyFile, PATH_MAX);
+	settings->audioCacheSize = 100;
 	memcpy (settings->tlsFingerprint, "\xD9\x98\x0B\xA2\xCC\x0F\x97\xBB"
 			"\x03\x82\x2C\x62\x11\xEA\xEA\x4A\x06\xEE\xF4\x27",
 			sizeof (settings->tlsFingerprint));
@@ -156,6 +239,7 @@ void BarSettingsRead (BarSettings_t *settings) {
 
 	BarGetXdgConfigDir (PACKAGE "/config", configfile, sizeof (configfile));
 	if ((configfd = fopen (configfile, "r")) == NULL) {
+		BarSettingsCompileFormats (settings);
 		return;
 	}
 
@@ -198,10 +282,15 @@ void BarSettingsRead (BarSettings_t *settings) {
 			} else if (streq (val, "mp3-hifi")) {
 				settings->audioFormat = PIANO_AF_MP3_HI;
 			}
+		} else if (streq ("audio_decoder", key)) {
+			free (settings->audioDecoder);
+			settings->audioDecoder = strdup (val);
 		} else if (streq ("autostart_station", key)) {
 			settings->autostartStation = strdup (val);
 		} else if (streq ("event_command", key)) {
 			settings->eventCmd = strdup (val);
+		} else if (streq ("event_command_stream", key)) {
+			settings->eventCmdStream = atoi (val) != 0;
 		} else if (streq ("history", key)) {
 			settings->history = atoi (val);
 		} else if (streq ("sort", key)) {
@@ -239,9 +328,26 @@ void BarSettingsRead (BarSettings_t *settings) {
 		} else if (streq ("format_list_song", key)) {
 			free (settings->listSongFormat);
 			settings->listSongFormat = strdup (val);
+		} else if (streq ("control_socket", key)) {
+			free (settings->controlSocket);
+			settings->controlSocket = strdup (val);
 		} else if (streq ("fifo", key)) {
 			free (settings->fifo);
 			settings->fifo = strdup (val);
+		} else if (streq ("history_file", key)) {
+			free (settings->historyFile);
+			settings->historyFile = strdup (val);
+		} else if (streq ("audio_cache", key)) {
+			free (settings->audioCacheDir);
+			settings->audioCacheDir = strdup (val);
+		} else if (streq ("audio_cache_size", key)) {
+			settings->audioCacheSize = atoi (val);
+		} else if (streq ("rpc_record", key)) {
+			free (settings->rpcRecord);
+			settings->rpcRecord = strdup (val);
+		} else if (streq ("rpc_replay", key)) {
+			free (settings->rpcReplay);
+			settings->rpcReplay = strdup (val);
 		} else if (streq ("tls_fingerprint", key)) {
 			/* expects 40 byte hex-encoded sha1 */
 			if (strlen (val) == 40) {
@@ -294,4 +400,6 @@ void BarSettingsRead (BarSettings_t *settings) {
 	}
 
 	fclose (configfd);
+
+	BarSettingsCompileFormats (settings);
 }
@@ -77,6 +77,27 @@ typedef struct {
 	char *postfix;
 } BarMsgFormatStr_t;
 
+/* format characters of npSongFormat, npStationFormat and listSongFormat */
+#define BAR_FORMAT_NP_SONG "talr@su"
+#define BAR_FORMAT_NP_STATION "ni"
+#define BAR_FORMAT_LIST_SONG "iatr"
+
+/* part of a compiled format string */
+typedef struct {
+	/* points into the format string; for fields this is %x, which is
+	 * printed if there is no value */
+	const char *text;
+	size_t len;
+	/* position in format characters, -1 for literal text */
+	int field;
+} BarFormatOp_t;
+
+/* format string, split up by BarSettingsRead */
+typedef struct {
+	BarFormatOp_t *ops;
+	size_t count;
+} BarFormat_t;
+
 typedef struct {
 	unsigned int history;
 	int volume;
@@ -89,14 +110,25 @@ typedef struct {
 	char keys[BAR_KS_COUNT];
 	char *autostartStation;
 	char *eventCmd;
+	/* keep eventCmd running, see BarEventCmd_t */
+	bool eventCmdStream;
 	char *loveIcon;
 	char *banIcon;
 	char *atIcon;
 	char *npSongFormat;
 	char *npStationFormat;
 	char *listSongFormat;
+	BarFormat_t npSongOps, npStationOps, listSongOps;
 	char *fifo;
+	char *historyFile;
+	char *controlSocket;
+	char *audioCacheDir;
+	unsigned int audioCacheSize; /* MiB */
+	char *audioDecoder; /* preferred decoder backend */
 	char tlsFingerprint[20];
+	/* rpc session trace files, replay takes precedence */
+	char *rpcRecord;
+	char *rpcReplay;
 	BarMsgFormatStr_t msgFormat[MSG_COUNT];
 } BarSettings_t;
 
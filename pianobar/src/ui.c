@@ -131,20 +131,54 @@ void BarUiMsg (const BarSettings_t *settings, const BarUiMsg_t type,
 	fflush (stdout);
 }
 
-/*	fetch http resource (post request)
+/*	waitress callback, passes response body to libpiano's parser
+ */
+static WaitressCbReturn_t BarPianoHttpResponseCb (void *data, size_t size,
+		void *extraData) {
+	/* parser errors are reported by PianoResponse */
+	PianoResponseFeed (extraData, data, size);
+	return WAITRESS_CB_RET_OK;
+}
+
+/*	fetch http resource (post request); parsed while it is received if
+ *	libpiano supports this for the request
  *	@param waitress handle
  *	@param piano request (initialized by PianoRequest())
  */
-static WaitressReturn_t BarPianoHttpRequest (WaitressHandle_t *waith,
+WaitressReturn_t BarUiPianoHttpRequest (WaitressHandle_t *waith,
 		PianoRequest_t *req) {
 	waith->extraHeaders = "Content-Type: text/xml\r\n";
 	waith->postData = req->postData;
 	waith->method = WAITRESS_METHOD_POST;
 	waith->url.path = req->urlPath;
 
+	if (req->responseStream != NULL) {
+		waith->data = req;
+		waith->callback = BarPianoHttpResponseCb;
+		return WaitressFetchCall (waith);
+	}
 	return WaitressFetchBuf (waith, &req->responseData);
 }
 
+/*	does the response to this request modify the station list?
+ *	@param request type
+ */
+static bool BarUiChangesStations (PianoRequestType_t type) {
+	switch (type) {
+		case PIANO_REQUEST_GET_STATIONS:
+		case PIANO_REQUEST_CREATE_STATION:
+		case PIANO_REQUEST_DELETE_STATION:
+		case PIANO_REQUEST_RENAME_STATION:
+		case PIANO_REQUEST_ADD_SEED:
+		case PIANO_REQUEST_SET_QUICKMIX:
+		case PIANO_REQUEST_TRANSFORM_STATION:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
 /*	piano wrapper: prepare/execute http request and pass result back to
  *	libpiano (updates data structures)
  *	@param app handle
@@ -160,6 +194,12 @@ int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 
 	memset (&req, 0, sizeof (req));
 
+	/* the prefetcher runs on its own connection, but a trace must see
+	 * requests and responses in order */
+	if (app->ph.trace != NULL) {
+		BarPrefetchWait (&app->prefetch);
+	}
+
 	/* repeat as long as there are http requests to do */
 	do {
 		req.data = data;
@@ -171,7 +211,7 @@ int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 			return 0;
 		}
 
-		*wRet = BarPianoHttpRequest (&app->waith, &req);
+		*wRet = BarUiPianoHttpRequest (&app->waith, &req);
 		if (*wRet != WAITRESS_RET_OK) {
 			BarUiMsg (&app->settings, MSG_NONE, "Network error: %s\n", WaitressErrorToStr (*wRet));
 			if (req.responseData != NULL) {
@@ -182,6 +222,9 @@ int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 		}
 
 		*pRet = PianoResponse (&app->ph, &req);
+		if (BarUiChangesStations (type)) {
+			BarUiInvalidateStations (app);
+		}
 		if (*pRet != PIANO_RET_CONTINUE_REQUEST) {
 			/* checking for request type avoids infinite loops */
 			if (*pRet == PIANO_RET_AUTH_TOKEN_INVALID &&
@@ -232,6 +275,144 @@ int BarUiPianoCall (BarApp_t * const app, PianoRequestType_t type,
 	return 1;
 }
 
+/*	send a batch of independent requests over one connection
+ *	@param app handle
+ *	@param request type
+ *	@param request data, one per request
+ *	@param number of requests
+ *	@param stores piano return code of first failed request
+ *	@param stores waitress return code of first failed request
+ *	@param reauthenticate once if the auth token expired
+ *	@return number of successful requests
+ */
+static size_t BarUiPianoCallBatchTry (BarApp_t * const app,
+		PianoRequestType_t type, void * const *data, size_t n,
+		PianoReturn_t *pRet, WaitressReturn_t *wRet, bool reauth) {
+	PianoRequest_t req[BAR_UI_BATCH_MAX];
+	WaitressBatchItem_t items[BAR_UI_BATCH_MAX];
+	size_t prepared, i, done = 0;
+
+	assert (n <= BAR_UI_BATCH_MAX);
+
+	memset (req, 0, sizeof (req));
+	memset (items, 0, sizeof (items));
+
+	for (prepared = 0; prepared < n; prepared++) {
+		req[prepared].data = data[prepared];
+		if ((*pRet = PianoRequest (&app->ph, &req[prepared], type)) !=
+				PIANO_RET_OK) {
+			BarUiMsg (&app->settings, MSG_NONE, "Error: %s\n",
+					PianoErrorToStr (*pRet));
+			break;
+		}
+		items[prepared].path = req[prepared].urlPath;
+		items[prepared].postData = req[prepared].postData;
+		if (req[prepared].responseStream != NULL) {
+			items[prepared].callback = BarPianoHttpResponseCb;
+			items[prepared].data = &req[prepared];
+		}
+	}
+
+	if (prepared == n) {
+		app->waith.extraHeaders = "Content-Type: text/xml\r\n";
+		app->waith.method = WAITRESS_METHOD_POST;
+		WaitressFetchBatch (&app->waith, items, n);
+
+		for (i = 0; i < n; i++) {
+			PianoReturn_t itemPRet;
+
+			if (items[i].ret != WAITRESS_RET_OK) {
+				BarUiMsg (&app->settings, MSG_NONE, "Network error: %s\n",
+						WaitressErrorToStr (items[i].ret));
+				if (*wRet == WAITRESS_RET_OK) {
+					*wRet = items[i].ret;
+				}
+				continue;
+			}
+
+			req[i].responseData = items[i].buf;
+			items[i].buf = NULL;
+			itemPRet = PianoResponse (&app->ph, &req[i]);
+			if (BarUiChangesStations (type)) {
+				BarUiInvalidateStations (app);
+			}
+			if (itemPRet == PIANO_RET_AUTH_TOKEN_INVALID && reauth) {
+				/* all remaining requests used the same token */
+				PianoReturn_t authpRet;
+				WaitressReturn_t authwRet;
+				PianoRequestDataLogin_t reqData;
+				reqData.user = app->settings.username;
+				reqData.password = app->settings.password;
+				reqData.step = 0;
+
+				BarUiMsg (&app->settings, MSG_NONE, "Reauthentication required... ");
+				if (!BarUiPianoCall (app, PIANO_REQUEST_LOGIN, &reqData, &authpRet,
+						&authwRet)) {
+					*pRet = authpRet;
+					*wRet = authwRet;
+				} else {
+					BarUiMsg (&app->settings, MSG_INFO, "Trying again... ");
+					done += BarUiPianoCallBatchTry (app, type, &data[i], n - i,
+							pRet, wRet, false);
+				}
+				break;
+			} else if (itemPRet != PIANO_RET_OK) {
+				BarUiMsg (&app->settings, MSG_NONE, "Error: %s\n",
+						PianoErrorToStr (itemPRet));
+				if (*pRet == PIANO_RET_OK) {
+					*pRet = itemPRet;
+				}
+			} else {
+				++done;
+			}
+		}
+	}
+
+	for (i = 0; i < prepared; i++) {
+		free (items[i].buf);
+		free (req[i].responseData);
+		PianoDestroyRequest (&req[i]);
+	}
+
+	return done;
+}
+
+/*	piano wrapper for many requests of the same type, like BarUiPianoCall.
+ *	requests are pipelined over one connection, so they must not depend on
+ *	each other and need a single http request each (no login, move song)
+ *	@param app handle
+ *	@param request type
+ *	@param request data, one per request
+ *	@param number of requests, at most BAR_UI_BATCH_MAX
+ *	@param stores piano return code of first failed request
+ *	@param stores waitress return code of first failed request
+ *	@return number of successful requests
+ */
+size_t BarUiPianoCallBatch (BarApp_t * const app, PianoRequestType_t type,
+		void * const *data, size_t n, PianoReturn_t *pRet,
+		WaitressReturn_t *wRet) {
+	size_t done;
+
+	*pRet = PIANO_RET_OK;
+	*wRet = WAITRESS_RET_OK;
+
+	if (n == 0) {
+		return 0;
+	}
+
+	/* the prefetcher runs on its own connection, but a trace must see
+	 * requests and responses in order */
+	if (app->ph.trace != NULL) {
+		BarPrefetchWait (&app->prefetch);
+	}
+
+	done = BarUiPianoCallBatchTry (app, type, data, n, pRet, wRet, true);
+	if (done == n) {
+		BarUiMsg (&app->settings, MSG_NONE, "Ok.\n");
+	}
+	return done;
+}
+
 /*	Station sorting functions */
 
 static inline int BarStationQuickmix01Cmp (const void *a, const void *b) {
@@ -327,6 +508,40 @@ static PianoStation_t **BarSortedStations (PianoStation_t *unsortedStations,
 	return stationArray;
 }
 
+/*	sorted station list of piano handle, cached until the list changes
+ *	@param app handle
+ *	@param returns number of stations
+ *	@param sort order
+ *	@return array owned by app, do not free
+ */
+static PianoStation_t **BarCachedSortedStations (BarApp_t *app,
+		size_t *retStationCount, BarStationSorting_t order) {
+	BarStationCache_t * const cache = &app->stationCache;
+
+	assert (order < BAR_SORT_COUNT);
+
+	if (cache->sorted[order] == NULL) {
+		cache->sorted[order] = BarSortedStations (app->ph.stations,
+				&cache->count[order], order);
+	}
+	*retStationCount = cache->count[order];
+	return cache->sorted[order];
+}
+
+/*	drop sorted station lists, must be called whenever stations are added,
+ *	removed or renamed
+ *	@param app handle
+ */
+void BarUiInvalidateStations (BarApp_t *app) {
+	BarStationCache_t * const cache = &app->stationCache;
+
+	for (size_t i = 0; i < BAR_SORT_COUNT; i++) {
+		free (cache->sorted[i]);
+		cache->sorted[i] = NULL;
+		cache->count[i] = 0;
+	}
+}
+
 /*	let user pick one station
  *	@param app handle
  *	@param prompt string
@@ -335,7 +550,8 @@ static PianoStation_t **BarSortedStations (PianoStation_t *unsortedStations,
  */
 PianoStation_t *BarUiSelectStation (BarApp_t *app, PianoStation_t *stations,
 		const char *prompt, BarUiSelectStationCallback_t callback) {
-	PianoStation_t **sortedStations = NULL, *retStation = NULL;
+	PianoStation_t **sortedStations = NULL, **ownSortedStations = NULL,
+			*retStation = NULL;
 	size_t stationCount, i;
 	char buf[100];
 
@@ -346,11 +562,19 @@ PianoStation_t *BarUiSelectStation (BarApp_t *app, PianoStation_t *stations,
 
 	memset (buf, 0, sizeof (buf));
 
-	/* sort and print stations */
-	sortedStations = BarSortedStations (stations, &stationCount,
-			app->settings.sortOrder);
+	const bool cached = (stations == app->ph.stations);
+
+	if (!cached) {
+		sortedStations = ownSortedStations = BarSortedStations (stations,
+				&stationCount, app->settings.sortOrder);
+	}
 
 	do {
+		/* sort and print stations; the callback may change the order */
+		if (cached) {
+			sortedStations = BarCachedSortedStations (app, &stationCount,
+					app->settings.sortOrder);
+		}
 		for (i = 0; i < stationCount; i++) {
 			const PianoStation_t *currStation = sortedStations[i];
 			/* filter stations */
@@ -366,7 +590,7 @@ PianoStation_t *BarUiSelectStation (BarApp_t *app, PianoStation_t *stations,
 		BarUiMsg (&app->settings, MSG_QUESTION, prompt);
 		if (BarReadlineStr (buf, sizeof (buf), &app->input,
 				BAR_RL_DEFAULT) == 0) {
-			free (sortedStations);
+			free (ownSortedStations);
 			return NULL;
 		}
 
@@ -383,7 +607,7 @@ PianoStation_t *BarUiSelectStation (BarApp_t *app, PianoStation_t *stations,
 		}
 	} while (retStation == NULL);
 
-	free (sortedStations);
+	free (ownSortedStations);
 	return retStation;
 }
 
@@ -626,77 +850,40 @@ void BarStationFromGenre (BarApp_t *app) {
 	BarUiPianoCall (app, PIANO_REQUEST_CREATE_STATION, &reqData, &pRet, &wRet);
 }
 
-/*	replaces format characters (%x) in format string with custom strings
- *	@param destination buffer
- *	@param dest buffer size
- *	@param format string
- *	@param format characters
- *	@param replacement for each given format character
- */
-void BarUiCustomFormat (char *dest, size_t destSize, const char *format,
-		const char *formatChars, const char **formatVals) {
-	bool haveFormatChar = false;
-
-	while (*format != '\0' && destSize > 1) {
-		if (*format == '%' && !haveFormatChar) {
-			haveFormatChar = true;
-		} else if (haveFormatChar) {
-			const char *testChar = formatChars;
-			const char *val = NULL;
-
-			/* search for format character */
-			while (*testChar != '\0') {
-				if (*testChar == *format) {
-					val = formatVals[(testChar-formatChars)/sizeof (*testChar)];
-					break;
-				}
-				++testChar;
-			}
-
-			if (val != NULL) {
-				/* concat */
-				while (*val != '\0' && destSize > 1) {
-					*dest = *val;
-					++val;
-					++dest;
-					--destSize;
-				}
-			} else {
-				/* invalid format character */
-				*dest = '%';
-				++dest;
-				--destSize;
-				if (destSize > 1) {
-					*dest = *format;
-					++dest;
-					--destSize;
-				}
-			}
-
-			haveFormatChar = false;
-		} else {
-			/* copy */
-			*dest = *format;
-			++dest;
-			--destSize;
+/*	print compiled format string, followed by a newline
+ *	@param pianobar settings
+ *	@param message type
+ *	@param compiled format
+ *	@param replacement for each format character, in the order given to
+ *			BarSettingsCompileFormat
+ */
+static void BarUiPrintFormat (const BarSettings_t *settings,
+		const BarUiMsg_t type, const BarFormat_t *format,
+		const char **formatVals) {
+	char outstr[512];
+	/* leave room for \n\0 */
+	const size_t maxLen = sizeof (outstr) - 2;
+	size_t len = 0;
+
+	for (size_t i = 0; i < format->count && len < maxLen; i++) {
+		const BarFormatOp_t * const op = &format->ops[i];
+		const char *val = op->text;
+		size_t valLen = op->len;
+
+		if (op->field != -1 && formatVals[op->field] != NULL) {
+			val = formatVals[op->field];
+			valLen = strlen (val);
+		}
+		if (valLen > maxLen - len) {
+			valLen = maxLen - len;
 		}
-		++format;
+		memcpy (&outstr[len], val, valLen);
+		len += valLen;
 	}
-	*dest = '\0';
-}
+	outstr[len++] = '\n';
+	outstr[len] = '\0';
 
-/*	append \n to string
- */
-static void BarUiAppendNewline (char *s, size_t maxlen) {
-	size_t len;
-
-	/* append \n */
-	if ((len = strlen (s)) == maxlen-1) {
-		s[maxlen-2] = '\n';
-	} else {
-		s[len] = '\n';
-		s[len+1] = '\0';
-	}
+	BarUiMsg (settings, type, "%s", outstr);
 }
 
 /*	Print customizeable station infos
@@ -705,13 +892,9 @@ static void BarUiAppendNewline (char *s, size_t maxlen) {
  */
 inline void BarUiPrintStation (const BarSettings_t *settings,
 		PianoStation_t *station) {
-	char outstr[512];
 	const char *vals[] = {station->name, station->id};
 
-	BarUiCustomFormat (outstr, sizeof (outstr), settings->npStationFormat,
-			"ni", vals);
-	BarUiAppendNewline (outstr, sizeof (outstr));
-	BarUiMsg (settings, MSG_PLAYING, outstr);
+	BarUiPrintFormat (settings, MSG_PLAYING, &settings->npStationOps, vals);
 }
 
 /*	Print song infos (artist, title, album, loved)
@@ -721,17 +904,36 @@ inline void BarUiPrintStation (const BarSettings_t *settings,
  */
 inline void BarUiPrintSong (const BarSettings_t *settings,
 		const PianoSong_t *song, const PianoStation_t *station) {
-	char outstr[512];
 	const char *vals[] = {song->title, song->artist, song->album,
 			(song->rating == PIANO_RATE_LOVE) ? settings->loveIcon : "",
 			station != NULL ? settings->atIcon : "",
 			station != NULL ? station->name : "",
 			song->detailUrl};
 
-	BarUiCustomFormat (outstr, sizeof (outstr), settings->npSongFormat,
-			"talr@su", vals);
-	BarUiAppendNewline (outstr, sizeof (outstr));
-	BarUiMsg (settings, MSG_PLAYING, outstr);
+	BarUiPrintFormat (settings, MSG_PLAYING, &settings->npSongOps, vals);
+}
+
+/*	print one entry of a song list
+ *	@param pianobar settings
+ *	@param song number
+ *	@param song
+ */
+static void BarUiListSong (const BarSettings_t *settings, size_t i,
+		const PianoSong_t *song) {
+	char digits[4];
+	const char *vals[] = {digits, song->artist, song->title,
+			(song->rating == PIANO_RATE_LOVE) ? settings->loveIcon :
+			((song->rating == PIANO_RATE_BAN) ? settings->banIcon : "")};
+
+	snprintf (digits, sizeof (digits) / sizeof (*digits), "%2zu", i);
+	BarUiPrintFormat (settings, MSG_LIST, &settings->listSongOps, vals);
+}
+
+/*	does song match artist/song filter string?
+ */
+static bool BarUiSongMatches (const PianoSong_t *song, const char *filter) {
+	return filter == NULL || BarStrCaseStr (song->artist, filter) != NULL ||
+			BarStrCaseStr (song->title, filter) != NULL;
 }
 
 /*	Print list of songs
@@ -743,22 +945,10 @@ inline void BarUiPrintSong (const BarSettings_t *settings,
 size_t BarUiListSongs (const BarSettings_t *settings,
 		const PianoSong_t *song, const char *filter) {
 	size_t i = 0;
-	char digits[4];
 
 	while (song != NULL) {
-		if (filter == NULL ||
-				(filter != NULL && (BarStrCaseStr (song->artist, filter) != NULL ||
-				BarStrCaseStr (song->title, filter) != NULL))) {
-			char outstr[512];
-			const char *vals[] = {digits, song->artist, song->title,
-					(song->rating == PIANO_RATE_LOVE) ? settings->loveIcon :
-					((song->rating == PIANO_RATE_BAN) ? settings->banIcon : "")};
-
-			snprintf (digits, sizeof (digits) / sizeof (*digits), "%2zu", i);
-			BarUiCustomFormat (outstr, sizeof (outstr), settings->listSongFormat,
-					"iatr", vals);
-			BarUiAppendNewline (outstr, sizeof (outstr));
-			BarUiMsg (settings, MSG_LIST, outstr);
+		if (BarUiSongMatches (song, filter)) {
+			BarUiListSong (settings, i, song);
 		}
 		i++;
 		song = song->next;
@@ -767,28 +957,182 @@ size_t BarUiListSongs (const BarSettings_t *settings,
 	return i;
 }
 
-/*	Excute external event handler
- *	@param settings containing the cmdline
+/*	let user pick one song from history
+ *	@param pianobar settings
+ *	@param history
+ *	@param input fds
+ *	@return pointer to selected song or NULL
+ */
+PianoSong_t *BarUiSelectHistorySong (const BarSettings_t *settings,
+		const BarHistory_t *history, BarReadlineFds_t *input) {
+	PianoSong_t *tmpSong = NULL;
+	char buf[100];
+
+	memset (buf, 0, sizeof (buf));
+
+	do {
+		for (size_t i = 0; i < history->count; i++) {
+			const PianoSong_t * const song = BarHistoryGet (history, i);
+			if (BarUiSongMatches (song, buf)) {
+				BarUiListSong (settings, i, song);
+			}
+		}
+
+		BarUiMsg (settings, MSG_QUESTION, "Select song: ");
+		if (BarReadlineStr (buf, sizeof (buf), input, BAR_RL_DEFAULT) == 0) {
+			return NULL;
+		}
+
+		if (isnumeric (buf)) {
+			tmpSong = BarHistoryGet (history, strtoul (buf, NULL, 0));
+		}
+	} while (tmpSong == NULL);
+
+	return tmpSong;
+}
+
+/*	describe event, the first line is event=<type>, the record ends with an
+ *	empty line
+ *	@param app handle
+ *	@param record, zeroed
  *	@param event type
  *	@param current station
  *	@param current song
+ *	@param piano handle for the station list, may be NULL
  *	@param piano error-code (PIANO_RET_OK if not applicable)
  *	@param waitress error-code (WAITRESS_RET_OK if not applicable)
+ *	@return false if out of memory
  */
-void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
+bool BarUiEventRecord (BarApp_t *app, BarEventRecord_t *rec,
+		const char *type, const PianoStation_t *curStation,
+		const PianoSong_t *curSong, const PianoHandle_t *ph,
+		PianoReturn_t pRet, WaitressReturn_t wRet) {
+	const BarSettings_t * const settings = &app->settings;
+	PianoStation_t *songStation = NULL, *stations;
+	BarPlayerStatus_t status;
+
+	/* consistent snapshot, the player thread is still running */
+	BarPlayerGetStatus (&app->player, &status);
+
+	stations = ph != NULL ? ph->stations : NULL;
+	if (curSong != NULL && stations != NULL && curStation->isQuickMix) {
+		songStation = PianoFindStationById (ph, curSong->stationId);
+	}
+
+	BarEventRecordPrintf (rec,
+			"event=%s\n"
+			"artist=%s\n"
+			"title=%s\n"
+			"album=%s\n"
+			"coverArt=%s\n"
+			"stationName=%s\n"
+			"songStationName=%s\n"
+			"pRet=%i\n"
+			"pRetStr=%s\n"
+			"wRet=%i\n"
+			"wRetStr=%s\n"
+			"songDuration=%lu\n"
+			"songPlayed=%lu\n"
+			"rating=%i\n"
+			"detailUrl=%s\n",
+			type,
+			curSong == NULL ? "" : curSong->artist,
+			curSong == NULL ? "" : curSong->title,
+			curSong == NULL ? "" : curSong->album,
+			curSong == NULL ? "" : curSong->coverArt,
+			curStation == NULL ? "" : curStation->name,
+			songStation == NULL ? "" : songStation->name,
+			pRet,
+			PianoErrorToStr (pRet),
+			wRet,
+			WaitressErrorToStr (wRet),
+			status.songDuration,
+			status.songPlayed,
+			curSong == NULL ? PIANO_RATE_NONE : curSong->rating,
+			curSong == NULL ? "" : curSong->detailUrl
+			);
+
+	if (stations != NULL) {
+		/* send station list */
+		PianoStation_t **sortedStations = NULL, **ownSortedStations = NULL;
+		size_t stationCount;
+		if (stations == app->ph.stations) {
+			sortedStations = BarCachedSortedStations (app, &stationCount,
+					settings->sortOrder);
+		} else {
+			sortedStations = ownSortedStations = BarSortedStations (stations,
+					&stationCount, settings->sortOrder);
+		}
+		assert (sortedStations != NULL);
+
+		BarEventRecordPrintf (rec, "stationCount=%zd\n", stationCount);
+
+		for (size_t i = 0; i < stationCount; i++) {
+			const PianoStation_t *currStation = sortedStations[i];
+			BarEventRecordPrintf (rec, "station%zd=%s\n", i,
+					currStation->name);
+		}
+		free (ownSortedStations);
+	} else {
+		BarEventRecordPrintf (rec, "stationCount=0\n");
+	}
+	BarEventRecordPrintf (rec, "\n");
+
+	return !rec->failed;
+}
+
+/*	Excute external event handler and notify control socket subscribers
+ *	@param app handle, containing the cmdline
+ *	@param event type
+ *	@param current station
+ *	@param current song
+ *	@param piano handle for the station list, may be NULL
+ *	@param piano error-code (PIANO_RET_OK if not applicable)
+ *	@param waitress error-code (WAITRESS_RET_OK if not applicable)
+ */
+void BarUiStartEventCmd (BarApp_t *app, const char *type,
 		const PianoStation_t *curStation, const PianoSong_t *curSong,
-		const struct audioPlayer *player, PianoStation_t *stations,
-                PianoReturn_t pRet, WaitressReturn_t wRet) {
+		const PianoHandle_t *ph, PianoReturn_t pRet, WaitressReturn_t wRet) {
+	const BarSettings_t * const settings = &app->settings;
+	const bool subscribed = BarControlSubscribed (&app->control);
+	BarEventRecord_t rec;
 	pid_t chld;
 	int pipeFd[2];
 
-	if (settings->eventCmd == NULL) {
+	if (settings->eventCmd == NULL && !subscribed) {
 		/* nothing to do... */
 		return;
 	}
 
+	memset (&rec, 0, sizeof (rec));
+	if (!BarUiEventRecord (app, &rec, type, curStation, curSong, ph, pRet,
+			wRet)) {
+		BarUiMsg (settings, MSG_ERR, "Cannot create %s event.\n", type);
+		free (rec.data);
+		return;
+	}
+
+	if (subscribed) {
+		BarControlPublish (&app->control, rec.data, rec.len);
+	}
+
+	if (settings->eventCmd == NULL) {
+		free (rec.data);
+		return;
+	}
+
+	if (settings->eventCmdStream) {
+		if (!BarEventCmdPush (&app->eventCmd, rec.data)) {
+			BarUiMsg (settings, MSG_ERR, "Event queue full, dropping %s "
+					"event.\n", type);
+			free (rec.data);
+		}
+		return;
+	}
+
 	if (pipe (pipeFd) == -1) {
 		BarUiMsg (settings, MSG_ERR, "Cannot create eventcmd pipe. (%s)\n", strerror (errno));
+		free (rec.data);
 		return;
 	}
 
@@ -803,105 +1147,48 @@ void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
 		exit (1);
 	} else if (chld == -1) {
 		BarUiMsg (settings, MSG_ERR, "Cannot fork eventcmd. (%s)\n", strerror (errno));
+		close (pipeFd[0]);
+		close (pipeFd[1]);
 	} else {
 		/* parent */
 		int status;
-		PianoStation_t *songStation = NULL;
-		FILE *pipeWriteFd;
+		/* the event name is passed as argument, without record separator */
+		const char *pos = strchr (rec.data, '\n') + 1;
+		size_t len = rec.len - (pos - rec.data) - 1;
 
 		close (pipeFd[0]);
 
-		pipeWriteFd = fdopen (pipeFd[1], "w");
-
-		if (curSong != NULL && stations != NULL && curStation->isQuickMix) {
-			songStation = PianoFindStationById (stations, curSong->stationId);
-		}
-
-		fprintf (pipeWriteFd,
-				"artist=%s\n"
-				"title=%s\n"
-				"album=%s\n"
-				"coverArt=%s\n"
-				"stationName=%s\n"
-				"songStationName=%s\n"
-				"pRet=%i\n"
-				"pRetStr=%s\n"
-				"wRet=%i\n"
-				"wRetStr=%s\n"
-				"songDuration=%lu\n"
-				"songPlayed=%lu\n"
-				"rating=%i\n"
-				"detailUrl=%s\n",
-				curSong == NULL ? "" : curSong->artist,
-				curSong == NULL ? "" : curSong->title,
-				curSong == NULL ? "" : curSong->album,
-				curSong == NULL ? "" : curSong->coverArt,
-				curStation == NULL ? "" : curStation->name,
-				songStation == NULL ? "" : songStation->name,
-				pRet,
-				PianoErrorToStr (pRet),
-				wRet,
-				WaitressErrorToStr (wRet),
-				player->songDuration,
-				player->songPlayed,
-				curSong == NULL ? PIANO_RATE_NONE : curSong->rating,
-				curSong == NULL ? "" : curSong->detailUrl
-				);
-
-		if (stations != NULL) {
-			/* send station list */
-			PianoStation_t **sortedStations = NULL;
-			size_t stationCount;
-			sortedStations = BarSortedStations (stations, &stationCount,
-					settings->sortOrder);
-			assert (sortedStations != NULL);
-
-			fprintf (pipeWriteFd, "stationCount=%zd\n", stationCount);
-
-			for (size_t i = 0; i < stationCount; i++) {
-				const PianoStation_t *currStation = sortedStations[i];
-				fprintf (pipeWriteFd, "station%zd=%s\n", i,
-						currStation->name);
+		while (len > 0) {
+			const ssize_t ret = write (pipeFd[1], pos, len);
+			if (ret == -1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				break;
 			}
-			free (sortedStations);
-		} else {
-			const char * const msg = "stationCount=0\n";
-			fwrite (msg, sizeof (*msg), strlen (msg), pipeWriteFd);
+			pos += ret;
+			len -= ret;
 		}
-	
-		/* closes pipeFd[1] as well */
-		fclose (pipeWriteFd);
+		close (pipeFd[1]);
 		/* wait to get rid of the zombie */
 		waitpid (chld, &status, 0);
 	}
+	free (rec.data);
 }
 
-/*	prepend song to history, must not be a list of songs as ->next is modified!
+/*	stop playback and continue with another station
+ *	@param app handle
+ *	@param new station
  */
-void BarUiHistoryPrepend (BarApp_t *app, PianoSong_t *song) {
-	if (app->settings.history != 0) {
-		PianoSong_t *tmpSong;
-
-		song->next = app->songHistory;
-		app->songHistory = song;
-
-		/* limit history's length */
-		/* start with 1, so we're stopping at n-1 and have the
-		 * chance to set ->next = NULL */
-		unsigned int i = 1;
-		tmpSong = app->songHistory;
-		while (i < app->settings.history && tmpSong != NULL) {
-			tmpSong = tmpSong->next;
-			++i;
-		}
-		/* if too many songs in history... */
-		if (tmpSong != NULL) {
-			PianoSong_t *delSong = tmpSong->next;
-			tmpSong->next = NULL;
-			if (delSong != NULL) {
-				PianoDestroyPlaylist (delSong);
-			}
-		}
+void BarUiSwitchStation (BarApp_t *app, PianoStation_t *station) {
+	app->curStation = station;
+	BarUiPrintStation (&app->settings, app->curStation);
+	BarPlayerQuit (&app->player);
+	if (app->playlist != NULL) {
+		PianoDestroyPlaylist (app->playlist->next);
+		BarHistoryPrepend (&app->history, app->playlist);
+		app->playlist = NULL;
 	}
 }
 
+
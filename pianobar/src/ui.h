@@ -33,6 +33,9 @@ THE SOFTWARE.
 #include "ui_readline.h"
 #include "ui_types.h"
 
+/* max requests sent at once by BarUiPianoCallBatch */
+#define BAR_UI_BATCH_MAX 32
+
 typedef void (*BarUiSelectStationCallback_t) (BarApp_t *app, char *buf);
 
 void BarUiMsg (const BarSettings_t *, const BarUiMsg_t, const char *, ...);
@@ -40,6 +43,8 @@ PianoStation_t *BarUiSelectStation (BarApp_t *, PianoStation_t *, const char *,
 		BarUiSelectStationCallback_t);
 PianoSong_t *BarUiSelectSong (const BarSettings_t *, PianoSong_t *,
 		BarReadlineFds_t *);
+PianoSong_t *BarUiSelectHistorySong (const BarSettings_t *,
+		const BarHistory_t *, BarReadlineFds_t *);
 PianoArtist_t *BarUiSelectArtist (BarApp_t *, PianoArtist_t *);
 char *BarUiSelectMusicId (BarApp_t *, PianoStation_t *, PianoSong_t *, const char *);
 void BarStationFromGenre (BarApp_t *);
@@ -47,11 +52,18 @@ void BarUiPrintStation (const BarSettings_t *, PianoStation_t *);
 void BarUiPrintSong (const BarSettings_t *, const PianoSong_t *, 
 		const PianoStation_t *);
 size_t BarUiListSongs (const BarSettings_t *, const PianoSong_t *, const char *);
-void BarUiStartEventCmd (const BarSettings_t *, const char *,
-		const PianoStation_t *, const PianoSong_t *, const struct audioPlayer *,
-		PianoStation_t *, PianoReturn_t, WaitressReturn_t);
+bool BarUiEventRecord (BarApp_t *, BarEventRecord_t *, const char *,
+		const PianoStation_t *, const PianoSong_t *, const PianoHandle_t *,
+		PianoReturn_t, WaitressReturn_t);
+void BarUiStartEventCmd (BarApp_t *, const char *, const PianoStation_t *,
+		const PianoSong_t *, const PianoHandle_t *, PianoReturn_t,
+		WaitressReturn_t);
+WaitressReturn_t BarUiPianoHttpRequest (WaitressHandle_t *, PianoRequest_t *);
 int BarUiPianoCall (BarApp_t * const, PianoRequestType_t,
 		void *, PianoReturn_t *, WaitressReturn_t *);
-void BarUiHistoryPrepend (BarApp_t *app, PianoSong_t *song);
+size_t BarUiPianoCallBatch (BarApp_t * const, PianoRequestType_t,
+		void * const *, size_t, PianoReturn_t *, WaitressReturn_t *);
+void BarUiSwitchStation (BarApp_t *, PianoStation_t *);
+void BarUiInvalidateStations (BarApp_t *);
 
 #endif /* _UI_H */
@@ -34,47 +34,80 @@ THE SOFTWARE.
 
 /*	standard eventcmd call
  */
-#define BarUiActDefaultEventcmd(name) BarUiStartEventCmd (&app->settings, \
-		name, selStation, selSong, &app->player, app->ph.stations, \
-		pRet, wRet)
+#define BarUiActDefaultEventcmd(name) BarUiStartEventCmd (app, name, \
+		selStation, selSong, &app->ph, pRet, wRet)
 
 /*	standard piano call
  */
 #define BarUiActDefaultPianoCall(call, arg) BarUiPianoCall (app, \
 		call, arg, &pRet, &wRet)
 
-/*	helper to _really_ skip a song (unlock mutex, quit player)
+/*	helper to _really_ skip a song (wake up paused player, quit)
  *	@param player handle
  */
 static inline void BarUiDoSkipSong (struct audioPlayer *player) {
 	assert (player != NULL);
 
-	player->doQuit = 1;
-	pthread_mutex_unlock (&player->pauseMutex);
+	BarPlayerQuit (player);
 }
 
-/*	transform station if necessary to allow changes like rename, rate, ...
- *	@param piano handle
- *	@param transform this station
+/*	add item to batch, unless it is already part of it
+ *	@param batch
+ *	@param number of items in batch, incremented
+ *	@param item
+ */
+static void BarUiActBatchAdd (void **batch, size_t *n, void *item) {
+	for (size_t i = 0; i < *n; i++) {
+		if (batch[i] == item) {
+			return;
+		}
+	}
+	batch[(*n)++] = item;
+}
+
+/*	transform stations if necessary to allow changes like rename, rate, ...
+ *	@param app handle
+ *	@param transform these stations (duplicates are allowed)
+ *	@param number of stations, at most BAR_UI_BATCH_MAX
  *	@return 0 = error, 1 = everything went well
  */
-static int BarTransformIfShared (BarApp_t *app, PianoStation_t *station) {
+static int BarTransformAllIfShared (BarApp_t *app,
+		PianoStation_t * const *stations, size_t n) {
 	PianoReturn_t pRet;
 	WaitressReturn_t wRet;
+	void *shared[BAR_UI_BATCH_MAX];
+	size_t sharedCount = 0;
 
-	assert (station != NULL);
+	assert (n <= BAR_UI_BATCH_MAX);
 
 	/* shared stations must be transformed */
-	if (!station->isCreator) {
-		BarUiMsg (&app->settings, MSG_INFO, "Transforming station... ");
-		if (!BarUiPianoCall (app, PIANO_REQUEST_TRANSFORM_STATION, station,
-				&pRet, &wRet)) {
+	for (size_t i = 0; i < n; i++) {
+		assert (stations[i] != NULL);
+
+		if (!stations[i]->isCreator) {
+			BarUiActBatchAdd (shared, &sharedCount, stations[i]);
+		}
+	}
+	if (sharedCount > 0) {
+		BarUiMsg (&app->settings, MSG_INFO, "Transforming station%s... ",
+				sharedCount > 1 ? "s" : "");
+		if (BarUiPianoCallBatch (app, PIANO_REQUEST_TRANSFORM_STATION, shared,
+				sharedCount, &pRet, &wRet) != sharedCount) {
 			return 0;
 		}
 	}
 	return 1;
 }
 
+/*	transform station if necessary to allow changes like rename, rate, ...
+ *	@param piano handle
+ *	@param transform this station
+ *	@return 0 = error, 1 = everything went well
+ */
+static int BarTransformIfShared (BarApp_t *app, PianoStation_t *station) {
+	return BarTransformAllIfShared (app, &station, 1);
+}
+
 /*	print current shortcut configuration
  */
 BarUiActCallback(BarUiActHelp) {
@@ -193,7 +226,7 @@ BarUiActCallback(BarUiActDeleteStation) {
 				selStation) && selStation == app->curStation) {
 			BarUiDoSkipSong (&app->player);
 			PianoDestroyPlaylist (app->playlist->next);
-			BarUiHistoryPrepend (app, app->playlist);
+			BarHistoryPrepend (&app->history, app->playlist);
 			app->playlist = NULL;
 			app->curStation = NULL;
 		}
@@ -237,7 +270,7 @@ BarUiActCallback(BarUiActSongInfo) {
 	/* print real station if quickmix */
 	BarUiPrintSong (&app->settings, selSong,
 			selStation->isQuickMix ?
-			PianoFindStationById (app->ph.stations, selSong->stationId) :
+			PianoFindStationById (&app->ph, selSong->stationId) :
 			NULL);
 }
 
@@ -310,6 +343,7 @@ BarUiActCallback(BarUiActMoveSong) {
 	PianoReturn_t pRet;
 	WaitressReturn_t wRet;
 	PianoRequestDataMoveSong_t reqData;
+	PianoStation_t *transform[2];
 
 	assert (selSong != NULL);
 
@@ -320,15 +354,17 @@ BarUiActCallback(BarUiActMoveSong) {
 	if (reqData.to != NULL) {
 		/* find original station (just is case we're playing a quickmix
 		 * station) */
-		reqData.from = PianoFindStationById (app->ph.stations,
+		reqData.from = PianoFindStationById (&app->ph,
 				selSong->stationId);
 		if (reqData.from == NULL) {
 			BarUiMsg (&app->settings, MSG_ERR, "Station not found\n");
 			return;
 		}
 
-		if (!BarTransformIfShared (app, reqData.from) ||
-				!BarTransformIfShared (app, reqData.to)) {
+		transform[0] = reqData.from;
+		transform[1] = reqData.to;
+		if (!BarTransformAllIfShared (app, transform,
+				sizeof (transform) / sizeof (*transform))) {
 			return;
 		}
 		BarUiMsg (&app->settings, MSG_INFO, "Moving song to \"%s\"... ", reqData.to->name);
@@ -344,10 +380,7 @@ BarUiActCallback(BarUiActMoveSong) {
 /*	pause
  */
 BarUiActCallback(BarUiActPause) {
-	/* already locked => unlock/unpause */
-	if (pthread_mutex_trylock (&app->player.pauseMutex) == EBUSY) {
-		pthread_mutex_unlock (&app->player.pauseMutex);
-	}
+	BarPlayerTogglePause (&app->player);
 }
 
 /*	rename current station
@@ -381,14 +414,7 @@ BarUiActCallback(BarUiActSelectStation) {
 	PianoStation_t *newStation = BarUiSelectStation (app, app->ph.stations,
 			"Select station: ", NULL);
 	if (newStation != NULL) {
-		app->curStation = newStation;
-		BarUiPrintStation (&app->settings, app->curStation);
-		BarUiDoSkipSong (&app->player);
-		if (app->playlist != NULL) {
-			PianoDestroyPlaylist (app->playlist->next);
-			BarUiHistoryPrepend (app, app->playlist);
-			app->playlist = NULL;
-		}
+		BarUiSwitchStation (app, newStation);
 	}
 }
 
@@ -460,6 +486,11 @@ static void BarUiActQuickmixCallback (BarApp_t *app, char *buf) {
 			*buf = '\0';
 			break;
 	}
+
+	if (*buf == '\0') {
+		/* useQuickMix is a sort key */
+		BarUiInvalidateStations (app);
+	}
 }
 
 /*	if current station is a quickmix: select stations that are played in
@@ -477,6 +508,7 @@ BarUiActCallback(BarUiActSelectQuickMix) {
 				"Toggle quickmix for station: ",
 				BarUiActQuickmixCallback)) != NULL) {
 			toggleStation->useQuickMix = !toggleStation->useQuickMix;
+			BarUiInvalidateStations (app);
 		}
 		BarUiMsg (&app->settings, MSG_INFO, "Setting quickmix stations... ");
 		BarUiActDefaultPianoCall (PIANO_REQUEST_SET_QUICKMIX, NULL);
@@ -499,12 +531,12 @@ BarUiActCallback(BarUiActHistory) {
 	char buf[2];
 	PianoSong_t *histSong;
 
-	if (app->songHistory != NULL) {
-		histSong = BarUiSelectSong (&app->settings, app->songHistory,
+	if (app->history.count > 0) {
+		histSong = BarUiSelectHistorySong (&app->settings, &app->history,
 				&app->input);
 		if (histSong != NULL) {
 			BarKeyShortcutId_t action;
-			PianoStation_t *songStation = PianoFindStationById (app->ph.stations,
+			PianoStation_t *songStation = PianoFindStationById (&app->ph,
 					histSong->stationId);
 
 			if (songStation == NULL) {
@@ -632,51 +664,79 @@ BarUiActCallback(BarUiActManageStation) {
 	BarUiMsg (&app->settings, MSG_QUESTION, question);
 	if (BarReadline (selectBuf, sizeof (selectBuf), allowedActions, &app->input,
 					BAR_RL_FULLRETURN, -1)) {
-		if (selectBuf[0] == 'a') {
-			PianoArtist_t *artist = BarUiSelectArtist (app,
-					reqData.info.artistSeeds);
-			if (artist != NULL) {
-				PianoRequestDataDeleteSeed_t reqData;
+		/* selected seeds/feedback, deleted at once */
+		void *selected[BAR_UI_BATCH_MAX], *item;
+		PianoRequestDataDeleteSeed_t seeds[BAR_UI_BATCH_MAX];
+		size_t selectedCount = 0;
+
+		BarUiMsg (&app->settings, MSG_INFO, "Select up to %i entries, empty "
+				"line when done.\n", BAR_UI_BATCH_MAX);
+
+		memset (seeds, 0, sizeof (seeds));
 
-				memset (&reqData, 0, sizeof (reqData));
-				reqData.artist = artist;
+		if (selectBuf[0] == 'a') {
+			while (selectedCount < BAR_UI_BATCH_MAX && (item =
+					BarUiSelectArtist (app, reqData.info.artistSeeds)) != NULL) {
+				BarUiActBatchAdd (selected, &selectedCount, item);
+			}
+			if (selectedCount > 0) {
+				for (size_t i = 0; i < selectedCount; i++) {
+					seeds[i].artist = selected[i];
+					selected[i] = &seeds[i];
+				}
 
-				BarUiMsg (&app->settings, MSG_INFO, "Deleting artist seed... ");
-				BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED, &reqData);
+				BarUiMsg (&app->settings, MSG_INFO, "Deleting artist seed%s... ",
+						selectedCount > 1 ? "s" : "");
+				BarUiPianoCallBatch (app, PIANO_REQUEST_DELETE_SEED, selected,
+						selectedCount, &pRet, &wRet);
 				BarUiActDefaultEventcmd ("stationdeleteartistseed");
 			}
 		} else if (selectBuf[0] == 's') {
-			PianoSong_t *song = BarUiSelectSong (&app->settings,
-					reqData.info.songSeeds, &app->input);
-			if (song != NULL) {
-				PianoRequestDataDeleteSeed_t reqData;
-
-				memset (&reqData, 0, sizeof (reqData));
-				reqData.song = song;
+			while (selectedCount < BAR_UI_BATCH_MAX && (item =
+					BarUiSelectSong (&app->settings, reqData.info.songSeeds,
+					&app->input)) != NULL) {
+				BarUiActBatchAdd (selected, &selectedCount, item);
+			}
+			if (selectedCount > 0) {
+				for (size_t i = 0; i < selectedCount; i++) {
+					seeds[i].song = selected[i];
+					selected[i] = &seeds[i];
+				}
 
-				BarUiMsg (&app->settings, MSG_INFO, "Deleting song seed... ");
-				BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED, &reqData);
+				BarUiMsg (&app->settings, MSG_INFO, "Deleting song seed%s... ",
+						selectedCount > 1 ? "s" : "");
+				BarUiPianoCallBatch (app, PIANO_REQUEST_DELETE_SEED, selected,
+						selectedCount, &pRet, &wRet);
 				BarUiActDefaultEventcmd ("stationdeletesongseed");
 			}
 		} else if (selectBuf[0] == 't') {
-			PianoStation_t *station = BarUiSelectStation (app,
-					reqData.info.stationSeeds, "Delete seed station: ", NULL);
-			if (station != NULL) {
-				PianoRequestDataDeleteSeed_t reqData;
-
-				memset (&reqData, 0, sizeof (reqData));
-				reqData.station = station;
+			while (selectedCount < BAR_UI_BATCH_MAX && (item =
+					BarUiSelectStation (app, reqData.info.stationSeeds,
+					"Delete seed station: ", NULL)) != NULL) {
+				BarUiActBatchAdd (selected, &selectedCount, item);
+			}
+			if (selectedCount > 0) {
+				for (size_t i = 0; i < selectedCount; i++) {
+					seeds[i].station = selected[i];
+					selected[i] = &seeds[i];
+				}
 
-				BarUiMsg (&app->settings, MSG_INFO, "Deleting station seed... ");
-				BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_SEED, &reqData);
+				BarUiMsg (&app->settings, MSG_INFO, "Deleting station seed%s... ",
+						selectedCount > 1 ? "s" : "");
+				BarUiPianoCallBatch (app, PIANO_REQUEST_DELETE_SEED, selected,
+						selectedCount, &pRet, &wRet);
 				BarUiActDefaultEventcmd ("stationdeletestationseed");
 			}
 		} else if (selectBuf[0] == 'f') {
-			PianoSong_t *song = BarUiSelectSong (&app->settings,
-					reqData.info.feedback, &app->input);
-			if (song != NULL) {
+			while (selectedCount < BAR_UI_BATCH_MAX && (item =
+					BarUiSelectSong (&app->settings, reqData.info.feedback,
+					&app->input)) != NULL) {
+				BarUiActBatchAdd (selected, &selectedCount, item);
+			}
+			if (selectedCount > 0) {
 				BarUiMsg (&app->settings, MSG_INFO, "Deleting feedback... ");
-				BarUiActDefaultPianoCall (PIANO_REQUEST_DELETE_FEEDBACK, song);
+				BarUiPianoCallBatch (app, PIANO_REQUEST_DELETE_FEEDBACK, selected,
+						selectedCount, &pRet, &wRet);
 				BarUiActDefaultEventcmd ("stationdeletefeedback");
 			}
 		}
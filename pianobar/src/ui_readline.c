@@ -49,7 +49,8 @@ static size_t BarReadlinePrevUtf8 (char *ptr) {
  *	@param input fds
  *	@param flags
  *	@param timeout (seconds) or -1 (no timeout)
- *	@return number of bytes read from stdin
+ *	@return number of bytes read from stdin, 0 on timeout, wakeup or end of
+ *			script
  */
 size_t BarReadline (char *buf, const size_t bufSize, const char *mask,
 		BarReadlineFds_t *input, const BarReadlineFlags_t flags, int timeout) {
@@ -58,6 +59,8 @@ size_t BarReadline (char *buf, const size_t bufSize, const char *mask,
 	unsigned char escapeState = 0;
 	fd_set set;
 	const bool echo = !(flags & BAR_RL_NOECHO);
+	const bool wakeup = (flags & BAR_RL_WAKEUP) && input->wakeup != -1;
+	const bool watch = (flags & BAR_RL_WAKEUP) && input->watchMaxfd > 0;
 
 	assert (buf != NULL);
 	assert (bufSize > 0);
@@ -68,36 +71,69 @@ size_t BarReadline (char *buf, const size_t bufSize, const char *mask,
 	/* if fd is a fifo fgetc will always return EOF if nobody writes to
 	 * it, stdin will block */
 	while (1) {
-		int curFd = -1;
 		unsigned char chr;
-		struct timeval timeoutstruct;
 
-		/* select modifies set and timeout */
-		memcpy (&set, &input->set, sizeof (set));
-		timeoutstruct.tv_sec = timeout;
-		timeoutstruct.tv_usec = 0;
+		if (input->script != NULL) {
+			/* no fds are read while a script is set */
+			if (input->scriptLen == 0) {
+				break;
+			}
+			chr = *input->script++;
+			--input->scriptLen;
+		} else {
+			int curFd = -1, nfds = input->maxfd;
+			struct timeval timeoutstruct;
 
-		if (select (input->maxfd, &set, NULL, NULL,
-				(timeout == -1) ? NULL : &timeoutstruct) <= 0) {
-			/* fail or timeout */
-			break;
-		}
+			/* select modifies set and timeout */
+			memcpy (&set, &input->set, sizeof (set));
+			if (wakeup) {
+				FD_SET (input->wakeup, &set);
+			}
+			if (watch) {
+				for (int fd = 0; fd < input->watchMaxfd; fd++) {
+					if (FD_ISSET (fd, &input->watchSet)) {
+						FD_SET (fd, &set);
+					}
+				}
+				if (input->watchMaxfd > nfds) {
+					nfds = input->watchMaxfd;
+				}
+			}
+			timeoutstruct.tv_sec = timeout;
+			timeoutstruct.tv_usec = 0;
 
-		assert (sizeof (input->fds) / sizeof (*input->fds) == 2);
-		if (FD_ISSET(input->fds[0], &set)) {
-			curFd = input->fds[0];
-		} else if (input->fds[1] != -1 && FD_ISSET(input->fds[1], &set)) {
-			curFd = input->fds[1];
-		}
-		if (read (curFd, &chr, sizeof (chr)) <= 0) {
-			/* select() is going wild if fdset contains EOFed stdin, only check
-			 * for stdin, fifo is "reopened" as soon as another writer is
-			 * available
-			 * FIXME: ugly */
-			if (curFd == STDIN_FILENO) {
-				FD_CLR (curFd, &input->set);
+			if (select (nfds, &set, NULL, NULL,
+					(timeout == -1) ? NULL : &timeoutstruct) <= 0) {
+				/* fail or timeout */
+				break;
+			}
+
+			if (wakeup && FD_ISSET (input->wakeup, &set)) {
+				/* nonblocking, drain it */
+				char drain[16];
+				while (read (input->wakeup, drain, sizeof (drain)) > 0);
+				break;
+			}
+
+			assert (sizeof (input->fds) / sizeof (*input->fds) == 2);
+			if (FD_ISSET(input->fds[0], &set)) {
+				curFd = input->fds[0];
+			} else if (input->fds[1] != -1 && FD_ISSET(input->fds[1], &set)) {
+				curFd = input->fds[1];
+			} else {
+				/* watched fd, owner takes care of it */
+				break;
+			}
+			if (read (curFd, &chr, sizeof (chr)) <= 0) {
+				/* select() is going wild if fdset contains EOFed stdin, only
+				 * check for stdin, fifo is "reopened" as soon as another
+				 * writer is available
+				 * FIXME: ugly */
+				if (curFd == STDIN_FILENO) {
+					FD_CLR (curFd, &input->set);
+				}
+				continue;
 			}
-			continue;
 		}
 		switch (chr) {
 			/* EOT */
@@ -31,12 +31,24 @@ typedef enum {
 	BAR_RL_DEFAULT = 0,
 	BAR_RL_FULLRETURN = 1, /* return if buffer is full */
 	BAR_RL_NOECHO = 2, /* don't echo to stdout */
+	BAR_RL_WAKEUP = 4, /* return if wakeup or watched fds become readable */
 } BarReadlineFlags_t;
 
 typedef struct {
 	fd_set set;
 	int maxfd;
 	int fds[2];
+	/* read end of a pipe other threads write to when the main loop has
+	 * work to do, -1 if unused; not part of set */
+	int wakeup;
+	/* more fds for BAR_RL_WAKEUP, they are not read; watchMaxfd is 0 if
+	 * there are none */
+	fd_set watchSet;
+	int watchMaxfd;
+	/* if not NULL input is taken from here instead of the fds, readline
+	 * returns like on timeout once it's used up */
+	const char *script;
+	size_t scriptLen;
 } BarReadlineFds_t;
 
 size_t BarReadline (char *, const size_t, const char *,